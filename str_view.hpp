@@ -8,6 +8,51 @@ Documentation: see README.md and comments in the code below.
 
 # Version history
 
+Version: 2.2.0, unreleased
+
+    Major changes:
+    - Added class perfect_hash_dictionary_template - static dictionary based on minimal
+      perfect hashing, which can be saved to a file and attached from memory without rebuilding.
+    - Added class radix_map_template - ordered map based on adaptive radix tree, with
+      longest prefix match and enumeration of keys with given prefix.
+    - Added method is_null_terminated.
+    - Added classes glob_pattern_template, glob_pattern_set_template - compiled wildcard patterns.
+    - Methods find, rfind use SSE2 when available.
+    - Added configuration macro STR_VIEW_SSE2.
+    - Added function edit_distance and method find_approx - bit-parallel approximate matching.
+    - Added methods count, parallel_find, parallel_rfind, parallel_count.
+    - Added configuration macro STR_VIEW_PARALLEL_MIN_LENGTH.
+    - Added configuration macro STR_VIEW_THREADS. The header now includes <atomic>, and <thread> unless
+      STR_VIEW_THREADS is 0.
+    - Added methods count_lines, count_words. Method count(CharT) uses SSE2.
+    - Added class segmented_str_view_template - view of a string made of multiple pieces.
+    - Added class csv_reader_template - parser of CSV/TSV records returning fields as views.
+    - Added functions hex_encode, hex_decode, base64_encode, base64_decode.
+    - Added methods to_lower_into, to_upper_into, hash, and hash function objects like str_view_ci_hash.
+    - Added class string_table_template - table of strings in a flat image that can be saved to a file
+      and attached from memory, with optional sorted index.
+    - Added functions unescape_c, unescape_json, unescape_percent, escape_c, escape_json, escape_percent.
+    - Added traits template parameter to str_view_template and case-insensitive types ci_str_view, wci_str_view.
+    - Added runtime selection of AVX2 and AVX-512 kernels, controlled by STR_VIEW_DISPATCH,
+      get_simd_level(), set_simd_level().
+    - Methods compare, starts_with, ends_with and comparison operators compare all characters including '\0',
+      using vectorized kernels. Added methods compare_until_null, common_prefix_length.
+    - Added class multi_replacer_template - replacement of many patterns in a single pass.
+    - Added functions format_integer, format_float and class format_buffer_template - number formatting
+      without memory allocation.
+    - Methods find, rfind have parameter case_sensitive. Added methods contains, struct simple_ci_traits
+      with Unicode simple case folding for wchar_t, class ci_searcher_template.
+    - Added class trigram_index_template - trigram inverted index for substring queries over many strings.
+    - Added class suffix_array_template - suffix array and LCP array for repeated substring queries over one long text.
+    - Added class line_index_template - mapping between offsets and line/column positions, extensible when text is appended.
+    - Added classes uri_template - parser of URI components returning views, query_param_reader_template.
+    - Added functions path_filename, path_stem, path_extension, path_parent, path_is_absolute, normalize_path, class path_component_reader_template, macro STR_VIEW_WINDOWS_PATHS.
+    - Added class fixed_str_template, with aliases fixed_str, wfixed_str - string with inline storage that converts to null-terminated views.
+    - Added class c_str_array_template - argv-style array of null-terminated strings made from many views with one allocation.
+
+    Minor changes:
+    - Fixed assert in constructor with StillNullTerminated for empty string.
+
 Version: 2.1.1, 2025-07-27
 
     - Fixed compilation errors regarding new functions to_string, to_string_view.
@@ -89,16 +134,107 @@ Define this macro to enable C++17 compatibility.
     #endif
 #endif
 
+/*
+Define this macro to 0 to disable usage of SSE2 intrinsics and use only portable code.
+By default it is enabled when compiling for x86 or x64 with SSE2 available.
+*/
+#ifndef STR_VIEW_SSE2
+    #if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+        #define STR_VIEW_SSE2 1
+    #else
+        #define STR_VIEW_SSE2 0
+    #endif
+#endif
+
+/*
+Define this macro to 0 to disable runtime selection of AVX2 and AVX-512 versions of some kernels,
+depending on the CPU the program runs on. By default it is enabled together with STR_VIEW_SSE2 on x64.
+See get_simd_level().
+*/
+#ifndef STR_VIEW_DISPATCH
+    #if STR_VIEW_SSE2 && (defined(_M_X64) || defined(__x86_64__)) && !defined(_M_ARM64EC)
+        #define STR_VIEW_DISPATCH 1
+    #else
+        #define STR_VIEW_DISPATCH 0
+    #endif
+#endif
+#if STR_VIEW_DISPATCH && !STR_VIEW_SSE2
+    #error STR_VIEW_DISPATCH requires STR_VIEW_SSE2.
+#endif
+
+/*
+Views shorter than this number of characters are searched serially by methods parallel_find,
+parallel_rfind, parallel_count, as starting threads would cost more than it saves.
+*/
+#ifndef STR_VIEW_PARALLEL_MIN_LENGTH
+    #define STR_VIEW_PARALLEL_MIN_LENGTH (4 * 1024 * 1024)
+#endif
+
+/*
+Define this macro to 0 to avoid including <thread> and starting threads. Methods and classes that
+take thread_count, like parallel_find(), then do all the work on the calling thread.
+*/
+#ifndef STR_VIEW_THREADS
+    #define STR_VIEW_THREADS 1
+#endif
+
+/*
+Define this macro to 1 to make path functions, like path_filename(), treat '\\' as a separator in
+addition to '/' and recognize drive letters, like "C:". By default it is enabled on Windows.
+*/
+#ifndef STR_VIEW_WINDOWS_PATHS
+    #ifdef _WIN32
+        #define STR_VIEW_WINDOWS_PATHS 1
+    #else
+        #define STR_VIEW_WINDOWS_PATHS 0
+    #endif
+#endif
+
 #include <string>
 #include <algorithm> // for min, max
 #include <memory> // for memcmp
+#include <new> // for placement new
+#include <vector>
+#if STR_VIEW_THREADS
+    #include <thread>
+#endif
+#include <atomic>
+#include <functional> // for greater
 #if STR_VIEW_CPP17
     #include <string_view>
+    #include <charconv> // for to_chars
 #endif
 
 #include <cassert>
 #include <cstring>
 #include <cstdint>
+#include <type_traits>
+#include <limits>
+#include <cstdio> // for snprintf
+#include <cstdlib> // for strtod
+#include <cstdarg> // for va_list
+#include <cwchar> // for vswprintf
+
+#ifdef _MSC_VER
+    #include <intrin.h> // for _BitScanForward
+#endif
+#if STR_VIEW_SSE2
+    #include <emmintrin.h>
+#endif
+#if STR_VIEW_DISPATCH
+    #include <immintrin.h>
+    #ifndef _MSC_VER
+        #include <cpuid.h>
+    #endif
+    // Kernels for instruction sets above the baseline are compiled only for functions marked with these.
+    #if defined(__GNUC__) || defined(__clang__)
+        #define STR_VIEW_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+        #define STR_VIEW_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,popcnt")))
+    #else
+        #define STR_VIEW_TARGET_AVX2
+        #define STR_VIEW_TARGET_AVX512
+    #endif
+#endif
 
 inline size_t tstrlen(const char* sz) { return strlen(sz); }
 inline size_t tstrlen(const wchar_t* sz) { return wcslen(sz); }
@@ -109,793 +245,3809 @@ inline int tstrncmp(const wchar_t* lhs, const wchar_t* rhs, size_t count) { retu
 inline int tstrnicmp(const char* lhs, const char* rhs, size_t count) { return _strnicmp(lhs, rhs, count); }
 inline int tstrnicmp(const wchar_t* lhs, const wchar_t* rhs, size_t count) { return _wcsnicmp(lhs, rhs, count); }
 
-template<typename CharT>
-class str_view_template
+/*
+Instruction sets that vectorized kernels can use, from the lowest. See get_simd_level().
+*/
+enum STR_VIEW_SIMD_LEVEL
 {
-public:
-    typedef CharT CharT;
-    typedef std::basic_string<CharT, std::char_traits<CharT>, std::allocator<CharT>> StringT;
-#if STR_VIEW_CPP17
-    typedef std::basic_string_view<CharT, std::char_traits<CharT>> StringViewT;
-#endif
+    STR_VIEW_SIMD_LEVEL_SCALAR,
+    STR_VIEW_SIMD_LEVEL_SSE2,
+    STR_VIEW_SIMD_LEVEL_AVX2,
+    STR_VIEW_SIMD_LEVEL_AVX512,
+};
 
-    /*
-    Initializes to empty string.
-    */
-    inline str_view_template();
-    
-    /*
-    Initializes from a null-terminated string.
-    Null is acceptable. It means empty string.
-    */
-    inline str_view_template(const CharT* sz);
-    /*
-    Initializes from not null-terminated string.
-    Null is acceptable if length is 0.
-    */
-    inline str_view_template(const CharT* str, size_t length);
-    /*
-    Initializes from an array of characters with length known at compile time.
-    */
-    template<size_t Length>
-    inline str_view_template(const CharT str[Length]);
-    /*
-    Initializes from string with given length, with explicit statement that it is null-terminated.
-    Null is acceptable if length is 0.
-    */
-    struct StillNullTerminated { };
-    inline str_view_template(const CharT* str, size_t length, StillNullTerminated);
-    
-    /*
-    Initializes from an STL string.
-    length can exceed actual str.length(). It then spans to the end of str.
-    */
-    inline str_view_template(const StringT& str, size_t offset = 0, size_t length = SIZE_MAX);
-#if STR_VIEW_CPP17
-    /*
-    Initializes from an STL string view.
-    length can exceed actual str.length(). It then spans to the end of str.
-    */
-    inline str_view_template(const StringViewT& str, size_t offset = 0, size_t length = SIZE_MAX);
-#endif
+/*
+Internal helpers. Not part of the public interface.
+*/
+namespace str_view_detail
+{
 
-    // Copy constructor.
-    inline str_view_template(const str_view_template<CharT>& src, size_t offset = 0, size_t length = SIZE_MAX);
-    // Move constructor.
-    inline str_view_template(str_view_template<CharT>&& src);
-    
-    inline ~str_view_template();
+// Finalizer of SplitMix64. Scrambles all bits of x.
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
 
-    // Copy assignment operator.
-    inline str_view_template<CharT>& operator=(const str_view_template<CharT>& src);
-    // Move assignment operator.
-    inline str_view_template<CharT>& operator=(str_view_template<CharT>&& src);
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
 
-    /*
-    Exchanges the view with that of rhs.
-    */
-    inline void swap(str_view_template<CharT>& rhs) noexcept;
+// Returns index of the lowest set bit. x must not be 0.
+inline uint32_t ctz32(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(x);
+#endif
+}
 
-    /*
-    Returns the number of characters in the view. 
-    */
-    inline size_t length() const;
-    /*
-    Returns the number of characters in the view. 
-    Usage of this method is not recommended because its name may be misleading -
-    it may suggest size in bytes not in characters.
-    */
-    inline size_t size() const { return length(); }
-    /*
-    Checks if the view has no characters, i.e. whether length() == 0.
-    It may be more efficient than checking length().
-    */
-    inline bool empty() const;
-    /*
-    Returns a pointer to the underlying character array.
-    The pointer is such that the range [data(); data() + length()) is valid and the values in it
-    correspond to the values of the view. 
-    If empty() == true, returned pointer is undefined.
-    */
-    inline const CharT* data() const { return m_Begin; }
-    /*
-    Returns an iterator to the first character of the view.
-    If empty() == true, returned pointer may or may not be null, but always begin() == end().
-    */
-    inline const CharT* begin() const { return m_Begin; }
-    /*
-    Returns an iterator to the character following the last character of the view.
-    This character acts as a placeholder, attempting to access it results in undefined behavior. 
-    */
-    inline const CharT* end() const { return m_Begin + length(); }
-    /*
-    Returns first character in the view.
-    The behavior is undefined if empty() == true.
-    */
-    inline const CharT front() const { return *m_Begin; }
-    /*
-    Returns last character in the view.
-    The behavior is undefined if empty() == true. 
-    */
-    inline const CharT back() const { return m_Begin[length() - 1]; }
-    
-    inline CharT operator[](size_t index) const { return m_Begin[index]; }
-    inline CharT at(size_t index) const { return m_Begin[index]; }
+// Returns index of the lowest set bit. x must not be 0.
+inline uint32_t ctz64(uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    return (uint32_t)x != 0 ? ctz32((uint32_t)x) : 32 + ctz32((uint32_t)(x >> 32));
+#else
+    return (uint32_t)__builtin_ctzll(x);
+#endif
+}
 
-    /*
-    Returns null-terminated string with contents of this object.
-    Possibly an internal copy.
-    */
-    inline const CharT* c_str() const;
+// Maps x uniformly to range [0, n) without division.
+inline uint32_t fast_range32(uint32_t x, uint32_t n) { return (uint32_t)(((uint64_t)x * n) >> 32); }
 
-    /*
-    Returns a view of the substring [offset, offset + length).
-    length can exceed actual length(). It then spans to the end of this string.
-    */
-    inline str_view_template<CharT> substr(size_t offset = 0, size_t length = SIZE_MAX) const;
+/*
+Fast, non-cryptographic hash of a range of bytes.
+transformBlock(uint64_t) is applied to every 8 bytes before hashing them, with the last block padded
+with zeros, e.g. to fold case on the fly.
+*/
+template<typename TransformBlock>
+inline uint64_t hash_bytes(const void* data, size_t byteCount, uint64_t seed, TransformBlock transformBlock)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed ^ (byteCount * 0x9E3779B97F4A7C15ull);
+    for(; byteCount >= 8; p += 8, byteCount -= 8)
+    {
+        uint64_t block;
+        memcpy(&block, p, 8);
+        h = rotl64(h ^ (transformBlock(block) * 0x87C37B91114253D5ull), 31) * 0x4CF5AD432745937Full;
+    }
+    if(byteCount)
+    {
+        uint64_t block = 0;
+        memcpy(&block, p, byteCount);
+        h ^= transformBlock(block) * 0x87C37B91114253D5ull;
+    }
+    return mix64(h);
+}
 
-    /*
-    Copies the substring [offset, offset + length) to the character string pointed to by dst.
-    If pointer string ends before length is reached, string is copied to the end.
-    Null character is not added past the end of destination.
-    Returns number of characters copied.
-    */
-    inline size_t copy_to(CharT* dst, size_t offset = 0, size_t length = SIZE_MAX) const;
+inline uint64_t hash_bytes(const void* data, size_t byteCount, uint64_t seed)
+{
+    return hash_bytes(data, byteCount, seed, [](uint64_t block) { return block; });
+}
 
-    inline void to_string(StringT& dst, size_t offset = 0, size_t length = SIZE_MAX) const;
-    inline StringT to_string(size_t offset = 0, size_t length = SIZE_MAX) const;
+/*
+Converts ASCII upper case letters to lower case in every CharSize-byte lane of x, without branches.
+For each lane, the highest bit of the lane is used as a flag computed from the lower bits.
+*/
+template<size_t CharSize>
+inline uint64_t ascii_to_lower_swar(uint64_t x)
+{
+    const uint64_t laneOnes = ~0ull / ((1ull << (CharSize * 8 - 1) << 1) - 1); // 1 in the lowest bit of every lane.
+    const uint64_t highBits = laneOnes << (CharSize * 8 - 1);
+    const uint64_t low = x & ~highBits;
+    // Highest bit of a lane is set if its lower bits are >= 'A', and if they are > 'Z'.
+    const uint64_t geA = low + laneOnes * ((1ull << (CharSize * 8 - 1)) - 'A');
+    const uint64_t gtZ = low + laneOnes * ((1ull << (CharSize * 8 - 1)) - 'Z' - 1);
+    const uint64_t isUpper = geA & ~gtZ & ~x & highBits;
+    return x | (isUpper >> (CharSize * 8 - 6));
+}
 
-#if STR_VIEW_CPP17
-    inline void to_string_view(StringViewT& dst, size_t offset = 0, size_t length = SIZE_MAX) const;
-    inline StringViewT to_string_view(size_t offset = 0, size_t length = SIZE_MAX) const;
+// Returns index of the highest set bit. x must not be 0.
+inline uint32_t bsr32(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return (uint32_t)index;
+#else
+    return 31u - (uint32_t)__builtin_clz(x);
 #endif
+}
 
-    /*
-    Compares this with rhs lexicographically.
-    Returns negative value, 0, or positive value, depending on the result.
-    
-    Comparison is made using functions like strncmp, so they don't compare characters
-    past '\0' if it's present in the string.
-    */
-    inline int compare(const str_view_template<CharT>& rhs, bool case_sensitive = true) const;
-
-    inline bool operator==(const str_view_template<CharT>& rhs) const { return compare(rhs) == 0; }
-    inline bool operator!=(const str_view_template<CharT>& rhs) const { return compare(rhs) != 0; }
-    inline bool operator< (const str_view_template<CharT>& rhs) const { return compare(rhs) <  0; }
-    inline bool operator> (const str_view_template<CharT>& rhs) const { return compare(rhs) >  0; }
-    inline bool operator<=(const str_view_template<CharT>& rhs) const { return compare(rhs) <= 0; }
-    inline bool operator>=(const str_view_template<CharT>& rhs) const { return compare(rhs) >= 0; }
+inline uint32_t bsr64(uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (uint32_t)index;
+#elif defined(_MSC_VER)
+    return (uint32_t)(x >> 32) != 0 ? 32 + bsr32((uint32_t)(x >> 32)) : bsr32((uint32_t)x);
+#else
+    return 63u - (uint32_t)__builtin_clzll(x);
+#endif
+}
 
-    /*
-    Checks if the string view begins with the given prefix.
+template<typename CharT>
+inline CharT ascii_to_lower(CharT ch) { return ch >= (CharT)'A' && ch <= (CharT)'Z' ? (CharT)(ch + ('a' - 'A')) : ch; }
+template<typename CharT>
+inline CharT ascii_to_upper(CharT ch) { return ch >= (CharT)'a' && ch <= (CharT)'z' ? (CharT)(ch - ('a' - 'A')) : ch; }
 
-    If the string view is shorter than the prefix, returns false.
-    If prefix is empty, returns true.
-    */
-    inline bool starts_with(CharT prefix, bool case_sensitive = true) const;
-    inline bool starts_with(const str_view_template<CharT>& prefix, bool case_sensitive = true) const;
+/*
+Range of code points changed by Unicode simple case folding: first, first + stride, ..., last
+are mapped to code point + delta.
+*/
+struct case_fold_range
+{
+    uint32_t first;
+    uint32_t last;
+    int32_t delta;
+    uint32_t stride;
+};
 
-    /*
-    Checks if the string view ends with the given suffix.
+/*
+Returns code point after Unicode simple case folding (mappings with status C and S from CaseFolding.txt,
+Unicode 14.0), which maps a character to a single one, usually its lowercase version.
+*/
+inline uint32_t unicode_simple_fold(uint32_t code)
+{
+    if(code < 0x80)
+        return ascii_to_lower(code);
+    static const case_fold_range ranges[] = {
+        { 0x00B5, 0x00B5, 775, 1 }, { 0x00C0, 0x00D6, 32, 1 }, { 0x00D8, 0x00DE, 32, 1 }, { 0x0100, 0x012E, 1, 2 },
+        { 0x0132, 0x0136, 1, 2 }, { 0x0139, 0x0147, 1, 2 }, { 0x014A, 0x0176, 1, 2 }, { 0x0178, 0x0178, -121, 1 },
+        { 0x0179, 0x017D, 1, 2 }, { 0x017F, 0x017F, -268, 1 }, { 0x0181, 0x0181, 210, 1 }, { 0x0182, 0x0184, 1, 2 },
+        { 0x0186, 0x0186, 206, 1 }, { 0x0187, 0x0187, 1, 1 }, { 0x0189, 0x018A, 205, 1 }, { 0x018B, 0x018B, 1, 1 },
+        { 0x018E, 0x018E, 79, 1 }, { 0x018F, 0x018F, 202, 1 }, { 0x0190, 0x0190, 203, 1 }, { 0x0191, 0x0191, 1, 1 },
+        { 0x0193, 0x0193, 205, 1 }, { 0x0194, 0x0194, 207, 1 }, { 0x0196, 0x0196, 211, 1 }, { 0x0197, 0x0197, 209, 1 },
+        { 0x0198, 0x0198, 1, 1 }, { 0x019C, 0x019C, 211, 1 }, { 0x019D, 0x019D, 213, 1 }, { 0x019F, 0x019F, 214, 1 },
+        { 0x01A0, 0x01A4, 1, 2 }, { 0x01A6, 0x01A6, 218, 1 }, { 0x01A7, 0x01A7, 1, 1 }, { 0x01A9, 0x01A9, 218, 1 },
+        { 0x01AC, 0x01AC, 1, 1 }, { 0x01AE, 0x01AE, 218, 1 }, { 0x01AF, 0x01AF, 1, 1 }, { 0x01B1, 0x01B2, 217, 1 },
+        { 0x01B3, 0x01B5, 1, 2 }, { 0x01B7, 0x01B7, 219, 1 }, { 0x01B8, 0x01B8, 1, 1 }, { 0x01BC, 0x01BC, 1, 1 },
+        { 0x01C4, 0x01C4, 2, 1 }, { 0x01C5, 0x01C5, 1, 1 }, { 0x01C7, 0x01C7, 2, 1 }, { 0x01C8, 0x01C8, 1, 1 },
+        { 0x01CA, 0x01CA, 2, 1 }, { 0x01CB, 0x01DB, 1, 2 }, { 0x01DE, 0x01EE, 1, 2 }, { 0x01F1, 0x01F1, 2, 1 },
+        { 0x01F2, 0x01F4, 1, 2 }, { 0x01F6, 0x01F6, -97, 1 }, { 0x01F7, 0x01F7, -56, 1 }, { 0x01F8, 0x021E, 1, 2 },
+        { 0x0220, 0x0220, -130, 1 }, { 0x0222, 0x0232, 1, 2 }, { 0x023A, 0x023A, 10795, 1 }, { 0x023B, 0x023B, 1, 1 },
+        { 0x023D, 0x023D, -163, 1 }, { 0x023E, 0x023E, 10792, 1 }, { 0x0241, 0x0241, 1, 1 }, { 0x0243, 0x0243, -195, 1 },
+        { 0x0244, 0x0244, 69, 1 }, { 0x0245, 0x0245, 71, 1 }, { 0x0246, 0x024E, 1, 2 }, { 0x0345, 0x0345, 116, 1 },
+        { 0x0370, 0x0372, 1, 2 }, { 0x0376, 0x0376, 1, 1 }, { 0x037F, 0x037F, 116, 1 }, { 0x0386, 0x0386, 38, 1 },
+        { 0x0388, 0x038A, 37, 1 }, { 0x038C, 0x038C, 64, 1 }, { 0x038E, 0x038F, 63, 1 }, { 0x0391, 0x03A1, 32, 1 },
+        { 0x03A3, 0x03AB, 32, 1 }, { 0x03C2, 0x03C2, 1, 1 }, { 0x03CF, 0x03CF, 8, 1 }, { 0x03D0, 0x03D0, -30, 1 },
+        { 0x03D1, 0x03D1, -25, 1 }, { 0x03D5, 0x03D5, -15, 1 }, { 0x03D6, 0x03D6, -22, 1 }, { 0x03D8, 0x03EE, 1, 2 },
+        { 0x03F0, 0x03F0, -54, 1 }, { 0x03F1, 0x03F1, -48, 1 }, { 0x03F4, 0x03F4, -60, 1 }, { 0x03F5, 0x03F5, -64, 1 },
+        { 0x03F7, 0x03F7, 1, 1 }, { 0x03F9, 0x03F9, -7, 1 }, { 0x03FA, 0x03FA, 1, 1 }, { 0x03FD, 0x03FF, -130, 1 },
+        { 0x0400, 0x040F, 80, 1 }, { 0x0410, 0x042F, 32, 1 }, { 0x0460, 0x0480, 1, 2 }, { 0x048A, 0x04BE, 1, 2 },
+        { 0x04C0, 0x04C0, 15, 1 }, { 0x04C1, 0x04CD, 1, 2 }, { 0x04D0, 0x052E, 1, 2 }, { 0x0531, 0x0556, 48, 1 },
+        { 0x10A0, 0x10C5, 7264, 1 }, { 0x10C7, 0x10C7, 7264, 1 }, { 0x10CD, 0x10CD, 7264, 1 }, { 0x13F8, 0x13FD, -8, 1 },
+        { 0x1C80, 0x1C80, -6222, 1 }, { 0x1C81, 0x1C81, -6221, 1 }, { 0x1C82, 0x1C82, -6212, 1 }, { 0x1C83, 0x1C84, -6210, 1 },
+        { 0x1C85, 0x1C85, -6211, 1 }, { 0x1C86, 0x1C86, -6204, 1 }, { 0x1C87, 0x1C87, -6180, 1 }, { 0x1C88, 0x1C88, 35267, 1 },
+        { 0x1C90, 0x1CBA, -3008, 1 }, { 0x1CBD, 0x1CBF, -3008, 1 }, { 0x1E00, 0x1E94, 1, 2 }, { 0x1E9B, 0x1E9B, -58, 1 },
+        { 0x1E9E, 0x1E9E, -7615, 1 }, { 0x1EA0, 0x1EFE, 1, 2 }, { 0x1F08, 0x1F0F, -8, 1 }, { 0x1F18, 0x1F1D, -8, 1 },
+        { 0x1F28, 0x1F2F, -8, 1 }, { 0x1F38, 0x1F3F, -8, 1 }, { 0x1F48, 0x1F4D, -8, 1 }, { 0x1F59, 0x1F59, -8, 1 },
+        { 0x1F5B, 0x1F5B, -8, 1 }, { 0x1F5D, 0x1F5D, -8, 1 }, { 0x1F5F, 0x1F5F, -8, 1 }, { 0x1F68, 0x1F6F, -8, 1 },
+        { 0x1F88, 0x1F8F, -8, 1 }, { 0x1F98, 0x1F9F, -8, 1 }, { 0x1FA8, 0x1FAF, -8, 1 }, { 0x1FB8, 0x1FB9, -8, 1 },
+        { 0x1FBA, 0x1FBB, -74, 1 }, { 0x1FBC, 0x1FBC, -9, 1 }, { 0x1FBE, 0x1FBE, -7173, 1 }, { 0x1FC8, 0x1FCB, -86, 1 },
+        { 0x1FCC, 0x1FCC, -9, 1 }, { 0x1FD8, 0x1FD9, -8, 1 }, { 0x1FDA, 0x1FDB, -100, 1 }, { 0x1FE8, 0x1FE9, -8, 1 },
+        { 0x1FEA, 0x1FEB, -112, 1 }, { 0x1FEC, 0x1FEC, -7, 1 }, { 0x1FF8, 0x1FF9, -128, 1 }, { 0x1FFA, 0x1FFB, -126, 1 },
+        { 0x1FFC, 0x1FFC, -9, 1 }, { 0x2126, 0x2126, -7517, 1 }, { 0x212A, 0x212A, -8383, 1 }, { 0x212B, 0x212B, -8262, 1 },
+        { 0x2132, 0x2132, 28, 1 }, { 0x2160, 0x216F, 16, 1 }, { 0x2183, 0x2183, 1, 1 }, { 0x24B6, 0x24CF, 26, 1 },
+        { 0x2C00, 0x2C2F, 48, 1 }, { 0x2C60, 0x2C60, 1, 1 }, { 0x2C62, 0x2C62, -10743, 1 }, { 0x2C63, 0x2C63, -3814, 1 },
+        { 0x2C64, 0x2C64, -10727, 1 }, { 0x2C67, 0x2C6B, 1, 2 }, { 0x2C6D, 0x2C6D, -10780, 1 }, { 0x2C6E, 0x2C6E, -10749, 1 },
+        { 0x2C6F, 0x2C6F, -10783, 1 }, { 0x2C70, 0x2C70, -10782, 1 }, { 0x2C72, 0x2C72, 1, 1 }, { 0x2C75, 0x2C75, 1, 1 },
+        { 0x2C7E, 0x2C7F, -10815, 1 }, { 0x2C80, 0x2CE2, 1, 2 }, { 0x2CEB, 0x2CED, 1, 2 }, { 0x2CF2, 0x2CF2, 1, 1 },
+        { 0xA640, 0xA66C, 1, 2 }, { 0xA680, 0xA69A, 1, 2 }, { 0xA722, 0xA72E, 1, 2 }, { 0xA732, 0xA76E, 1, 2 },
+        { 0xA779, 0xA77B, 1, 2 }, { 0xA77D, 0xA77D, -35332, 1 }, { 0xA77E, 0xA786, 1, 2 }, { 0xA78B, 0xA78B, 1, 1 },
+        { 0xA78D, 0xA78D, -42280, 1 }, { 0xA790, 0xA792, 1, 2 }, { 0xA796, 0xA7A8, 1, 2 }, { 0xA7AA, 0xA7AA, -42308, 1 },
+        { 0xA7AB, 0xA7AB, -42319, 1 }, { 0xA7AC, 0xA7AC, -42315, 1 }, { 0xA7AD, 0xA7AD, -42305, 1 }, { 0xA7AE, 0xA7AE, -42308, 1 },
+        { 0xA7B0, 0xA7B0, -42258, 1 }, { 0xA7B1, 0xA7B1, -42282, 1 }, { 0xA7B2, 0xA7B2, -42261, 1 }, { 0xA7B3, 0xA7B3, 928, 1 },
+        { 0xA7B4, 0xA7C2, 1, 2 }, { 0xA7C4, 0xA7C4, -48, 1 }, { 0xA7C5, 0xA7C5, -42307, 1 }, { 0xA7C6, 0xA7C6, -35384, 1 },
+        { 0xA7C7, 0xA7C9, 1, 2 }, { 0xA7D0, 0xA7D0, 1, 1 }, { 0xA7D6, 0xA7D8, 1, 2 }, { 0xA7F5, 0xA7F5, 1, 1 },
+        { 0xAB70, 0xABBF, -38864, 1 }, { 0xFF21, 0xFF3A, 32, 1 }, { 0x10400, 0x10427, 40, 1 }, { 0x104B0, 0x104D3, 40, 1 },
+        { 0x10570, 0x1057A, 39, 1 }, { 0x1057C, 0x1058A, 39, 1 }, { 0x1058C, 0x10592, 39, 1 }, { 0x10594, 0x10595, 39, 1 },
+        { 0x10C80, 0x10CB2, 64, 1 }, { 0x118A0, 0x118BF, 32, 1 }, { 0x16E40, 0x16E5F, 32, 1 }, { 0x1E900, 0x1E921, 34, 1 },
+    };
+    const case_fold_range* const end = ranges + sizeof(ranges) / sizeof(ranges[0]);
+    // The last range that begins at or before the code point.
+    const case_fold_range* it = std::upper_bound(ranges, end, code,
+        [](uint32_t c, const case_fold_range& range) { return c < range.first; });
+    if(it == ranges)
+        return code;
+    --it;
+    if(code > it->last || (code - it->first) % it->stride != 0)
+        return code;
+    return (uint32_t)((int32_t)code + it->delta);
+}
 
-    If the string view is shorter than the suffix, returns false.
-    If suffix is empty, returns true.
-    */
-    inline bool ends_with(CharT suffix, bool case_sensitive = true) const;
-    inline bool ends_with(const str_view_template<CharT>& suffix, bool case_sensitive = true) const;
+/*
+Folds character for case-insensitive comparison of views with default traits:
+ASCII letters only for 8-bit characters, as their encoding is not known,
+Unicode simple case folding for wide characters.
+With 16-bit wchar_t, surrogate pairs are not combined, so only characters of BMP are folded.
+*/
+template<typename CharT>
+inline CharT simple_fold(CharT ch)
+{
+    if(sizeof(CharT) == 1)
+        return ascii_to_lower(ch);
+    return (CharT)unicode_simple_fold((uint32_t)(typename std::make_unsigned<CharT>::type)ch);
+}
 
-    /*
-    Finds the first substring equal to the given character sequence.
-    pos - position at which to start the search.
-    Returns position of the first character of the found substring, or SIZE_MAX if no such substring is found.
-    If substr is empty, returns pos.
-    */
-    inline size_t find(CharT ch, size_t pos = 0) const;
-    inline size_t find(const str_view_template<CharT>& substr, size_t pos = 0) const;
+// Applies simple_fold() to every character in 8 bytes. Blocks of ASCII characters are folded all at once.
+template<typename CharT>
+inline uint64_t simple_fold_block(uint64_t block)
+{
+    const uint64_t nonAsciiBits = sizeof(CharT) == 1 ? 0 : sizeof(CharT) == 2 ? 0xFF80FF80FF80FF80ull : 0xFFFFFF80FFFFFF80ull;
+    if((block & nonAsciiBits) == 0)
+        return ascii_to_lower_swar<sizeof(CharT)>(block);
+    CharT chars[8 / sizeof(CharT)];
+    memcpy(chars, &block, 8);
+    for(size_t i = 0; i < 8 / sizeof(CharT); ++i)
+        chars[i] = simple_fold(chars[i]);
+    memcpy(&block, chars, 8);
+    return block;
+}
 
-    /*
-    Finds the last substring equal to the given character sequence.
-    pos - position at which to start the search.
-    Returns position of the first character of the found substring, or SIZE_MAX if no such substring is found.
-    If substr is empty, returns pos.
-    */
-    inline size_t rfind(CharT ch, size_t pos = SIZE_MAX) const;
-    inline size_t rfind(const str_view_template<CharT>& substr, size_t pos = SIZE_MAX) const;
+#if STR_VIEW_SSE2
 
-    /*
-    Finds the first character equal to any of the characters in the given character sequence. 
-    pos - position at which to start the search.
-    Returns position of the first occurrence of any character of the substring,
-    or SIZE_MAX if no such character is found.
-    If chars is empty, returns SIZE_MAX.
-    */
-    inline size_t find_first_of(const str_view_template<CharT>& chars, size_t pos = 0) const;
-    /*
-    Finds the last character equal to one of characters in the given character sequence.
-    The search considers only the interval [0; pos].
-    If the character is not present in the interval, SIZE_MAX will be returned.
-    If chars is empty, returns SIZE_MAX.
-    */
-    inline size_t find_last_of(const str_view_template<CharT>& chars, size_t pos = SIZE_MAX) const;
-    /*
-    Finds the first character NOT equal to any of the characters in the given character sequence. 
-    pos - position at which to start the search.
-    Returns position of the first occurrence of any character not of the substring,
-    or SIZE_MAX if no such character is found.
-    If chars is empty, returns SIZE_MAX.
-    */
-    inline size_t find_first_not_of(const str_view_template<CharT>& chars, size_t pos = 0) const;
-    /*
-    Finds the last character NOT equal to one of characters in the given character sequence.
-    The search considers only the interval [0; pos].
-    If the character is not present in the interval, SIZE_MAX will be returned.
-    If chars is empty, returns SIZE_MAX.
-    */
-    inline size_t find_last_not_of(const str_view_template<CharT>& chars, size_t pos = SIZE_MAX) const;
-
-    /*
-    Moves the start of the view forward by n characters. 
-    */
-    inline void remove_prefix(size_t n);
-    /*
-    Moves the end of the view back by n characters. 
-    */
-    inline void remove_suffix(size_t n);
-
-private:
-    /*
-    SIZE_MAX means unknown.
-    */
-    mutable size_t m_Length;
-    
-    const CharT* m_Begin;
-
-    /*
-    Null: a null-terminated copy not yet created.
-    Equal to m_Begin: the original string is null-terminated itself.
-    Any other value: A copy is created.
-    */
-    mutable const CharT* m_NullTerminatedPtr;
+/*
+SSE2 operations on 16-byte vectors of characters, selected by character size.
+movemask() of a comparison result sets CharSize bits per matching character.
+load16_bytes(), store16_bytes() convert between 16 characters and 16 bytes. Characters above 255
+are loaded as 255. Packing instructions saturate signed values, so characters with the highest bit
+set are replaced with 255 before packing, as they would become 0.
+*/
+template<size_t CharSize> struct sse2_chars;
+template<> struct sse2_chars<1>
+{
+    static __m128i set1(uint32_t ch) { return _mm_set1_epi8((char)ch); }
+    static __m128i cmpeq(__m128i lhs, __m128i rhs) { return _mm_cmpeq_epi8(lhs, rhs); }
+    static __m128i cmpgt(__m128i lhs, __m128i rhs) { return _mm_cmpgt_epi8(lhs, rhs); }
+    static __m128i add(__m128i lhs, __m128i rhs) { return _mm_add_epi8(lhs, rhs); }
+    static __m128i load16_bytes(const void* str) { return _mm_loadu_si128((const __m128i*)str); }
+    static void store16_bytes(void* dst, __m128i bytes) { _mm_storeu_si128((__m128i*)dst, bytes); }
 };
-
-typedef str_view_template<char> str_view;
-typedef str_view_template<wchar_t> wstr_view;
-
-template<typename CharT>
-inline str_view_template<CharT>::str_view_template() :
-    m_Length(0),
-    m_Begin(nullptr),
-    m_NullTerminatedPtr(nullptr)
+template<> struct sse2_chars<2>
 {
-}
-
-template<typename CharT>
-inline str_view_template<CharT>::str_view_template(const CharT* sz) :
-    m_Length(sz ? SIZE_MAX : 0),
-    m_Begin(sz),
-    m_NullTerminatedPtr(sz ? sz : nullptr)
+    static __m128i set1(uint32_t ch) { return _mm_set1_epi16((short)ch); }
+    static __m128i cmpeq(__m128i lhs, __m128i rhs) { return _mm_cmpeq_epi16(lhs, rhs); }
+    static __m128i cmpgt(__m128i lhs, __m128i rhs) { return _mm_cmpgt_epi16(lhs, rhs); }
+    static __m128i add(__m128i lhs, __m128i rhs) { return _mm_add_epi16(lhs, rhs); }
+    static __m128i clamp_negative(__m128i v)
+    {
+        const __m128i negative = _mm_srai_epi16(v, 15);
+        return _mm_or_si128(_mm_andnot_si128(negative, v), _mm_srli_epi16(negative, 8));
+    }
+    static __m128i load16_bytes(const void* str)
+    {
+        const __m128i* src = (const __m128i*)str;
+        return _mm_packus_epi16(clamp_negative(_mm_loadu_si128(src)), clamp_negative(_mm_loadu_si128(src + 1)));
+    }
+    static void store16_bytes(void* dst, __m128i bytes)
+    {
+        __m128i* out = (__m128i*)dst;
+        _mm_storeu_si128(out, _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(bytes, _mm_setzero_si128()));
+    }
+};
+template<> struct sse2_chars<4>
 {
-}
+    static __m128i set1(uint32_t ch) { return _mm_set1_epi32((int)ch); }
+    static __m128i cmpeq(__m128i lhs, __m128i rhs) { return _mm_cmpeq_epi32(lhs, rhs); }
+    static __m128i cmpgt(__m128i lhs, __m128i rhs) { return _mm_cmpgt_epi32(lhs, rhs); }
+    static __m128i add(__m128i lhs, __m128i rhs) { return _mm_add_epi32(lhs, rhs); }
+    static __m128i clamp_negative(__m128i v)
+    {
+        const __m128i negative = _mm_srai_epi32(v, 31);
+        return _mm_or_si128(_mm_andnot_si128(negative, v), _mm_srli_epi32(negative, 24));
+    }
+    static __m128i load16_bytes(const void* str)
+    {
+        const __m128i* src = (const __m128i*)str;
+        const __m128i lo = _mm_packs_epi32(clamp_negative(_mm_loadu_si128(src)), clamp_negative(_mm_loadu_si128(src + 1)));
+        const __m128i hi = _mm_packs_epi32(clamp_negative(_mm_loadu_si128(src + 2)), clamp_negative(_mm_loadu_si128(src + 3)));
+        return _mm_packus_epi16(lo, hi);
+    }
+    static void store16_bytes(void* dst, __m128i bytes)
+    {
+        __m128i* out = (__m128i*)dst;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+};
 
 template<typename CharT>
-inline str_view_template<CharT>::str_view_template(const CharT* str, size_t length) :
-    m_Length(length),
-    m_Begin(length ? str : nullptr),
-    m_NullTerminatedPtr(nullptr)
+inline uint32_t sse2_match_mask(const CharT* str, __m128i vec)
 {
+    return (uint32_t)_mm_movemask_epi8(sse2_chars<sizeof(CharT)>::cmpeq(_mm_loadu_si128((const __m128i*)str), vec));
 }
 
-template<typename CharT>
-template<size_t Length>
-inline str_view_template<CharT>::str_view_template(const CharT str[Length]) :
-    m_Length(Length),
-    m_Begin(str),
-    m_NullTerminatedPtr(nullptr)
+#endif // #if STR_VIEW_SSE2
+
+// Returns the highest instruction set level supported by the CPU and the operating system.
+inline STR_VIEW_SIMD_LEVEL detect_simd_level()
 {
+#if STR_VIEW_DISPATCH
+    unsigned int regs[4] = {};
+#ifdef _MSC_VER
+    __cpuid((int*)regs, 0);
+#else
+    __cpuid(0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    if(regs[0] < 7)
+        return STR_VIEW_SIMD_LEVEL_SSE2;
+#ifdef _MSC_VER
+    __cpuid((int*)regs, 1);
+#else
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    // OSXSAVE, AVX, POPCNT.
+    const uint32_t requiredEcx = (1u << 27) | (1u << 28) | (1u << 23);
+    if((regs[2] & requiredEcx) != requiredEcx)
+        return STR_VIEW_SIMD_LEVEL_SSE2;
+#ifdef _MSC_VER
+    const uint64_t xcr0 = _xgetbv(0);
+#else
+    uint32_t xcr0Lo, xcr0Hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+    const uint64_t xcr0 = ((uint64_t)xcr0Hi << 32) | xcr0Lo;
+#endif
+    // The operating system must save XMM and YMM registers, and for AVX-512 also opmask and ZMM registers.
+    if((xcr0 & 0x06) != 0x06)
+        return STR_VIEW_SIMD_LEVEL_SSE2;
+#ifdef _MSC_VER
+    __cpuidex((int*)regs, 7, 0);
+#else
+    __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    if((regs[1] & (1u << 5)) == 0) // AVX2
+        return STR_VIEW_SIMD_LEVEL_SSE2;
+    const uint32_t avx512Ebx = (1u << 16) | (1u << 30); // AVX512F, AVX512BW
+    if((regs[1] & avx512Ebx) != avx512Ebx || (xcr0 & 0xE6) != 0xE6)
+        return STR_VIEW_SIMD_LEVEL_AVX2;
+    return STR_VIEW_SIMD_LEVEL_AVX512;
+#elif STR_VIEW_SSE2
+    return STR_VIEW_SIMD_LEVEL_SSE2;
+#else
+    return STR_VIEW_SIMD_LEVEL_SCALAR;
+#endif
 }
 
-template<typename CharT>
-inline str_view_template<CharT>::str_view_template(const CharT* str, size_t length, StillNullTerminated) :
-    m_Length(length),
-    m_Begin(nullptr),
-    m_NullTerminatedPtr(nullptr)
+// Returns the detected level, lowered by environment variable STR_VIEW_SIMD_LEVEL if it is set.
+inline STR_VIEW_SIMD_LEVEL initial_simd_level()
 {
-    if(length)
+    const STR_VIEW_SIMD_LEVEL detected = detect_simd_level();
+    char name[16] = {};
+#ifdef _MSC_VER
+    size_t nameLen = 0;
+    if(getenv_s(&nameLen, name, sizeof(name), "STR_VIEW_SIMD_LEVEL") != 0 || nameLen == 0)
+        return detected;
+#else
+    const char* const env = getenv("STR_VIEW_SIMD_LEVEL");
+    if(env == nullptr || strlen(env) >= sizeof(name))
+        return detected;
+    strcpy(name, env);
+#endif
+    static const char* const levelNames[] = { "scalar", "sse2", "avx2", "avx512" };
+    for(int level = 0; level < (int)(sizeof(levelNames) / sizeof(levelNames[0])); ++level)
     {
-        m_Begin = str;
-        m_NullTerminatedPtr = str;
+        if(strcmp(name, levelNames[level]) == 0)
+            return (STR_VIEW_SIMD_LEVEL)std::min(level, (int)detected);
     }
-    assert(m_Begin[m_Length] == (CharT)0); // Make sure it's really null terminated.
+    return detected;
 }
 
-template<typename CharT>
-inline str_view_template<CharT>::str_view_template(const StringT& str, size_t offset, size_t length) :
-    m_Length(0),
-    m_Begin(nullptr),
-    m_NullTerminatedPtr(nullptr)
+inline std::atomic<int>& simd_level_storage()
 {
-    assert(offset <= str.length());
-    m_Length = std::min(length, str.length() - offset);
-    if(m_Length)
-    {
-        if(m_Length == str.length() - offset)
-        {
-            m_Begin = str.c_str() + offset;
-            m_NullTerminatedPtr = m_Begin;
-        }
-        else
-            m_Begin = str.data() + offset;
-    }
+    static std::atomic<int> level(initial_simd_level());
+    return level;
 }
 
-#if STR_VIEW_CPP17
+inline STR_VIEW_SIMD_LEVEL simd_level() { return (STR_VIEW_SIMD_LEVEL)simd_level_storage().load(std::memory_order_relaxed); }
 
-template<typename CharT>
-inline str_view_template<CharT>::str_view_template(const StringViewT& str, size_t offset, size_t length) :
-    m_Length(0),
-    m_Begin(nullptr),
-    m_NullTerminatedPtr(nullptr)
+#if STR_VIEW_DISPATCH
+
+// Equivalent of sse2_chars for AVX2 and AVX-512. AVX-512 comparisons return one bit per character.
+template<size_t CharSize> struct avx2_chars;
+template<> struct avx2_chars<1>
 {
-    assert(offset <= str.length());
-    m_Length = std::min(length, str.length() - offset);
-    if(m_Length)
-        m_Begin = str.data() + offset;
-}
+    STR_VIEW_TARGET_AVX2 static __m256i set1(uint32_t ch) { return _mm256_set1_epi8((char)ch); }
+    STR_VIEW_TARGET_AVX2 static __m256i cmpeq(__m256i lhs, __m256i rhs) { return _mm256_cmpeq_epi8(lhs, rhs); }
+};
+template<> struct avx2_chars<2>
+{
+    STR_VIEW_TARGET_AVX2 static __m256i set1(uint32_t ch) { return _mm256_set1_epi16((short)ch); }
+    STR_VIEW_TARGET_AVX2 static __m256i cmpeq(__m256i lhs, __m256i rhs) { return _mm256_cmpeq_epi16(lhs, rhs); }
+};
+template<> struct avx2_chars<4>
+{
+    STR_VIEW_TARGET_AVX2 static __m256i set1(uint32_t ch) { return _mm256_set1_epi32((int)ch); }
+    STR_VIEW_TARGET_AVX2 static __m256i cmpeq(__m256i lhs, __m256i rhs) { return _mm256_cmpeq_epi32(lhs, rhs); }
+};
 
-#endif // #if STR_VIEW_CPP17
+template<size_t CharSize> struct avx512_chars;
+template<> struct avx512_chars<1>
+{
+    STR_VIEW_TARGET_AVX512 static __m512i set1(uint32_t ch) { return _mm512_set1_epi8((char)ch); }
+    STR_VIEW_TARGET_AVX512 static uint64_t cmpeq_mask(__m512i lhs, __m512i rhs) { return _mm512_cmpeq_epi8_mask(lhs, rhs); }
+};
+template<> struct avx512_chars<2>
+{
+    STR_VIEW_TARGET_AVX512 static __m512i set1(uint32_t ch) { return _mm512_set1_epi16((short)ch); }
+    STR_VIEW_TARGET_AVX512 static uint64_t cmpeq_mask(__m512i lhs, __m512i rhs) { return _mm512_cmpeq_epi16_mask(lhs, rhs); }
+};
+template<> struct avx512_chars<4>
+{
+    STR_VIEW_TARGET_AVX512 static __m512i set1(uint32_t ch) { return _mm512_set1_epi32((int)ch); }
+    STR_VIEW_TARGET_AVX512 static uint64_t cmpeq_mask(__m512i lhs, __m512i rhs) { return _mm512_cmpeq_epi32_mask(lhs, rhs); }
+};
 
 template<typename CharT>
-inline str_view_template<CharT>::str_view_template(const str_view_template<CharT>& src, size_t offset, size_t length) :
-    m_Length(0),
-    m_Begin(nullptr),
-    m_NullTerminatedPtr(nullptr)
+STR_VIEW_TARGET_AVX2 inline size_t find_char_avx2(const CharT* str, size_t count, CharT ch)
 {
-    // Source length is unknown, constructor doesn't limit the length - it may remain unknown.
-    if(src.m_Length == SIZE_MAX && length == SIZE_MAX)
+    const size_t charsPerVec = 32 / sizeof(CharT);
+    const __m256i vec = avx2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    size_t i = 0;
+    for(; i + charsPerVec <= count; i += charsPerVec)
     {
-        m_Length = SIZE_MAX;
-        m_Begin = src.m_Begin + offset;
-        assert(src.m_NullTerminatedPtr == src.m_Begin);
-        m_NullTerminatedPtr = m_Begin;
+        const uint32_t mask = (uint32_t)_mm256_movemask_epi8(avx2_chars<sizeof(CharT)>::cmpeq(_mm256_loadu_si256((const __m256i*)(str + i)), vec));
+        if(mask)
+            return i + ctz32(mask) / sizeof(CharT);
     }
-    else
+    for(; i < count; ++i)
     {
-        const size_t srcLen = src.length();
-        assert(offset <= srcLen);
-        m_Length = std::min(length, srcLen - offset);
-        if(m_Length)
-        {
-            m_Begin = src.m_Begin + offset;
-            if(src.m_NullTerminatedPtr == src.m_Begin && m_Length == srcLen - offset)
-                m_NullTerminatedPtr = m_Begin;
-        }
+        if(str[i] == ch)
+            return i;
     }
+    return SIZE_MAX;
 }
 
 template<typename CharT>
-inline str_view_template<CharT>::str_view_template(str_view_template<CharT>&& src) :
-    m_Length(src.m_Length),
-    m_Begin(src.m_Begin),
-    m_NullTerminatedPtr(src.m_NullTerminatedPtr)
+STR_VIEW_TARGET_AVX2 inline size_t rfind_char_avx2(const CharT* str, size_t count, CharT ch)
 {
-    src.m_Length = 0;
-    src.m_Begin = nullptr;
-    src.m_NullTerminatedPtr = nullptr;
+    const size_t charsPerVec = 32 / sizeof(CharT);
+    const __m256i vec = avx2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    size_t i = count;
+    for(; i >= charsPerVec; i -= charsPerVec)
+    {
+        const uint32_t mask = (uint32_t)_mm256_movemask_epi8(avx2_chars<sizeof(CharT)>::cmpeq(
+            _mm256_loadu_si256((const __m256i*)(str + (i - charsPerVec))), vec));
+        if(mask)
+            return i - charsPerVec + bsr32(mask) / sizeof(CharT);
+    }
+    while(i--)
+    {
+        if(str[i] == ch)
+            return i;
+    }
+    return SIZE_MAX;
 }
 
 template<typename CharT>
-inline str_view_template<CharT>::~str_view_template()
+STR_VIEW_TARGET_AVX2 inline size_t count_char_avx2(const CharT* str, size_t count, CharT ch)
 {
-    if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
-        delete[] m_NullTerminatedPtr;
+    // Every matching character sets sizeof(CharT) bits of the mask.
+    const size_t charsPerVec = 32 / sizeof(CharT);
+    const __m256i vec = avx2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    size_t bitCount = 0;
+    size_t i = 0;
+    for(; i + charsPerVec <= count; i += charsPerVec)
+        bitCount += (size_t)_mm_popcnt_u32((uint32_t)_mm256_movemask_epi8(
+            avx2_chars<sizeof(CharT)>::cmpeq(_mm256_loadu_si256((const __m256i*)(str + i)), vec)));
+    size_t result = bitCount / sizeof(CharT);
+    for(; i < count; ++i)
+        result += str[i] == ch ? 1 : 0;
+    return result;
 }
 
 template<typename CharT>
-inline str_view_template<CharT>& str_view_template<CharT>::operator=(const str_view_template<CharT>& src)
+STR_VIEW_TARGET_AVX512 inline size_t find_char_avx512(const CharT* str, size_t count, CharT ch)
 {
-    if(&src != this)
+    const size_t charsPerVec = 64 / sizeof(CharT);
+    const __m512i vec = avx512_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    size_t i = 0;
+    for(; i + charsPerVec <= count; i += charsPerVec)
     {
-        if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
-            delete[] m_NullTerminatedPtr;
-        m_Begin = src.m_Begin;
-        m_Length = src.m_Length;
-        m_NullTerminatedPtr = src.m_NullTerminatedPtr == src.m_Begin ? m_Begin : nullptr;
+        const uint64_t mask = avx512_chars<sizeof(CharT)>::cmpeq_mask(_mm512_loadu_si512((const void*)(str + i)), vec);
+        if(mask)
+            return i + ctz64(mask);
     }
-    return *this;
+    for(; i < count; ++i)
+    {
+        if(str[i] == ch)
+            return i;
+    }
+    return SIZE_MAX;
 }
 
 template<typename CharT>
-inline str_view_template<CharT>& str_view_template<CharT>::operator=(str_view_template<CharT>&& src)
+STR_VIEW_TARGET_AVX512 inline size_t rfind_char_avx512(const CharT* str, size_t count, CharT ch)
 {
-    if(&src != this)
+    const size_t charsPerVec = 64 / sizeof(CharT);
+    const __m512i vec = avx512_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    size_t i = count;
+    for(; i >= charsPerVec; i -= charsPerVec)
     {
-        if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
-            delete[] m_NullTerminatedPtr;
-        m_Begin = src.m_Begin;
-        m_Length = src.m_Length;
-        m_NullTerminatedPtr = src.m_NullTerminatedPtr;
-        src.m_Length = 0;
-        src.m_Begin = nullptr;
-        src.m_NullTerminatedPtr = nullptr;
+        const uint64_t mask = avx512_chars<sizeof(CharT)>::cmpeq_mask(_mm512_loadu_si512((const void*)(str + (i - charsPerVec))), vec);
+        if(mask)
+            return i - charsPerVec + bsr64(mask);
     }
-    return *this;
+    while(i--)
+    {
+        if(str[i] == ch)
+            return i;
+    }
+    return SIZE_MAX;
 }
 
 template<typename CharT>
-inline void str_view_template<CharT>::swap(str_view_template<CharT>& rhs) noexcept
+STR_VIEW_TARGET_AVX512 inline size_t count_char_avx512(const CharT* str, size_t count, CharT ch)
 {
-    std::swap(m_Length, rhs.m_Length);
-    std::swap(m_Begin, rhs.m_Begin);
-    std::swap(m_NullTerminatedPtr, rhs.m_NullTerminatedPtr);
+    const size_t charsPerVec = 64 / sizeof(CharT);
+    const __m512i vec = avx512_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    size_t result = 0;
+    size_t i = 0;
+    for(; i + charsPerVec <= count; i += charsPerVec)
+        result += (size_t)_mm_popcnt_u64(avx512_chars<sizeof(CharT)>::cmpeq_mask(_mm512_loadu_si512((const void*)(str + i)), vec));
+    for(; i < count; ++i)
+        result += str[i] == ch ? 1 : 0;
+    return result;
 }
 
-template<typename CharT>
-inline size_t str_view_template<CharT>::length() const
+#endif // #if STR_VIEW_DISPATCH
+
+#if STR_VIEW_DISPATCH
+
+STR_VIEW_TARGET_AVX2 inline size_t mismatch_bytes_avx2(const unsigned char* lhs, const unsigned char* rhs, size_t byteCount)
 {
-    if(m_Length == SIZE_MAX)
+    size_t i = 0;
+    for(; i + 32 <= byteCount; i += 32)
     {
-        assert(m_NullTerminatedPtr == m_Begin);
-        m_Length = tstrlen(m_Begin);
+        const uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i*)(lhs + i)), _mm256_loadu_si256((const __m256i*)(rhs + i))));
+        if(mask)
+            return i + ctz32(mask);
     }
-    return m_Length;
+    return i;
 }
 
-template<typename CharT>
-inline bool str_view_template<CharT>::empty() const
+STR_VIEW_TARGET_AVX512 inline size_t mismatch_bytes_avx512(const unsigned char* lhs, const unsigned char* rhs, size_t byteCount)
 {
-    if(m_Length == SIZE_MAX)
+    size_t i = 0;
+    for(; i + 64 <= byteCount; i += 64)
     {
-        // Length is unknown. String is null-terminated.
-        // We still don't need to know the length. We just peek first character.
-        assert(m_NullTerminatedPtr == m_Begin);
-        return m_Begin == nullptr || *m_Begin == (CharT)0;
+        const uint64_t mask = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((const void*)(lhs + i)), _mm512_loadu_si512((const void*)(rhs + i)));
+        if(mask)
+            return i + ctz64(mask);
     }
-    return m_Length == 0;
+    return i;
 }
 
-template<typename CharT>
-inline const CharT* str_view_template<CharT>::c_str() const
+#endif // #if STR_VIEW_DISPATCH
+
+/*
+Returns index of the first byte that differs between lhs[0, byteCount) and rhs[0, byteCount),
+or byteCount if they are equal, like memcmp, which doesn't stop at '\0'.
+*/
+inline size_t mismatch_bytes(const void* lhsPtr, const void* rhsPtr, size_t byteCount)
 {
-    static const CharT nullChar = (CharT)0;
-    if(empty())
-        return &nullChar;
-    if(m_NullTerminatedPtr == m_Begin)
+    const unsigned char* const lhs = (const unsigned char*)lhsPtr;
+    const unsigned char* const rhs = (const unsigned char*)rhsPtr;
+    size_t i = 0;
+#if STR_VIEW_DISPATCH
+    // Vector kernels return position where fewer than a vector of bytes remain, unless they find a difference.
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(level == STR_VIEW_SIMD_LEVEL_AVX512)
+        i = mismatch_bytes_avx512(lhs, rhs, byteCount);
+    else if(level == STR_VIEW_SIMD_LEVEL_AVX2)
+        i = mismatch_bytes_avx2(lhs, rhs, byteCount);
+    if(level != STR_VIEW_SIMD_LEVEL_SCALAR)
+#endif
+#if STR_VIEW_SSE2
     {
-        //assert(m_Begin[length()] == (CharT)0); // Make sure it's really null terminated.
-        return m_Begin;
+        for(; i + 16 <= byteCount; i += 16)
+        {
+            const uint32_t mask = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i*)(lhs + i)), _mm_loadu_si128((const __m128i*)(rhs + i)))) & 0xFFFF;
+            if(mask)
+                return i + ctz32(mask);
+        }
     }
-    if(m_NullTerminatedPtr == nullptr)
+#endif
+    // Equal blocks of 8 bytes are skipped without looking at single bytes.
+    for(; i + 8 <= byteCount; i += 8)
     {
-        // Not null terminated, so length must be known.
-        assert(m_Length != SIZE_MAX);
-        CharT* nullTerminated = new CharT[m_Length + 1];
-        memcpy(nullTerminated, begin(), m_Length * sizeof(CharT));
-        nullTerminated[m_Length] = (CharT)0;
-        m_NullTerminatedPtr = nullTerminated;
+        uint64_t lhsBlock, rhsBlock;
+        memcpy(&lhsBlock, lhs + i, 8);
+        memcpy(&rhsBlock, rhs + i, 8);
+        if(lhsBlock != rhsBlock)
+            break;
     }
-    return m_NullTerminatedPtr;
+    for(; i < byteCount; ++i)
+    {
+        if(lhs[i] != rhs[i])
+            return i;
+    }
+    return byteCount;
 }
 
+// Returns index of the first character that differs between lhs[0, count) and rhs[0, count), or count if they are equal.
 template<typename CharT>
-inline size_t str_view_template<CharT>::copy_to(CharT* dst, size_t offset, size_t length) const
+inline size_t mismatch(const CharT* lhs, const CharT* rhs, size_t count)
 {
-    const size_t thisLen = this->length();
-    assert(offset <= thisLen);
-    length = std::min(length, thisLen - offset);
-    memcpy(dst, m_Begin + offset, length * sizeof(CharT));
-    return length;
+    return mismatch_bytes(lhs, rhs, count * sizeof(CharT)) / sizeof(CharT);
 }
 
+/*
+Compares lhs[0, lhsLen) with rhs[0, rhsLen) lexicographically, characters as unsigned values,
+without stopping at '\0'. Returns negative value, 0, or positive value.
+*/
 template<typename CharT>
-inline void str_view_template<CharT>::to_string(StringT& dst, size_t offset, size_t length) const
+inline int compare_chars(const CharT* lhs, size_t lhsLen, const CharT* rhs, size_t rhsLen)
 {
-    const size_t thisLen = this->length();
-    assert(offset <= thisLen);
-    length = std::min(length, thisLen - offset);
-    dst.assign(m_Begin + offset, m_Begin + (offset + length));
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    const size_t minLen = std::min(lhsLen, rhsLen);
+    const size_t index = minLen ? mismatch(lhs, rhs, minLen) : 0;
+    if(index < minLen)
+        return (UCharT)lhs[index] < (UCharT)rhs[index] ? -1 : 1;
+    return lhsLen < rhsLen ? -1 : lhsLen > rhsLen ? 1 : 0;
 }
 
+// Returns index of the first ch in str[0, count), or SIZE_MAX if not found.
 template<typename CharT>
-inline typename str_view_template<CharT>::StringT str_view_template<CharT>::to_string(size_t offset, size_t length) const
+inline size_t find_char(const CharT* str, size_t count, CharT ch)
 {
-    const size_t thisLen = this->length();
-    assert(offset <= thisLen);
-    length = std::min(length, thisLen - offset);
-    return StringT(m_Begin + offset, m_Begin + (offset + length));
-}
-
-#if STR_VIEW_CPP17
-
-template<typename CharT>
-inline void str_view_template<CharT>::to_string_view(StringViewT& dst, size_t offset, size_t length) const
-{
-    const size_t thisLen = this->length();
-    assert(offset <= thisLen);
-    length = std::min(length, thisLen - offset);
-    dst = StringViewT(m_Begin + offset, length);
-}
-
-template<typename CharT>
-inline typename str_view_template<CharT>::StringViewT str_view_template<CharT>::to_string_view(size_t offset, size_t length) const
-{
-    const size_t thisLen = this->length();
-    assert(offset <= thisLen);
-    length = std::min(length, thisLen - offset);
-    return StringViewT(m_Begin + offset, length);
+    size_t i = 0;
+#if STR_VIEW_DISPATCH
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(level == STR_VIEW_SIMD_LEVEL_AVX512)
+        return find_char_avx512(str, count, ch);
+    if(level == STR_VIEW_SIMD_LEVEL_AVX2)
+        return find_char_avx2(str, count, ch);
+    if(level == STR_VIEW_SIMD_LEVEL_SSE2)
+#endif
+#if STR_VIEW_SSE2
+    {
+        const size_t charsPerVec = 16 / sizeof(CharT);
+        const __m128i vec = sse2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+        for(; i + charsPerVec <= count; i += charsPerVec)
+        {
+            const uint32_t mask = sse2_match_mask(str + i, vec);
+            if(mask)
+                return i + ctz32(mask) / sizeof(CharT);
+        }
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        if(str[i] == ch)
+            return i;
+    }
+    return SIZE_MAX;
 }
 
-#endif // #if STR_VIEW_CPP17
-
+// Returns index of the last ch in str[0, count), or SIZE_MAX if not found.
 template<typename CharT>
-inline str_view_template<CharT> str_view_template<CharT>::substr(size_t offset, size_t length) const
+inline size_t rfind_char(const CharT* str, size_t count, CharT ch)
 {
-    // Length can remain unknown.
-    if(m_Length == SIZE_MAX && length == SIZE_MAX)
+    size_t i = count;
+#if STR_VIEW_DISPATCH
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(level == STR_VIEW_SIMD_LEVEL_AVX512)
+        return rfind_char_avx512(str, count, ch);
+    if(level == STR_VIEW_SIMD_LEVEL_AVX2)
+        return rfind_char_avx2(str, count, ch);
+    if(level == STR_VIEW_SIMD_LEVEL_SSE2)
+#endif
+#if STR_VIEW_SSE2
     {
-        assert(m_NullTerminatedPtr == m_Begin);
-        return str_view_template<CharT>(m_Begin + offset);
+        const size_t charsPerVec = 16 / sizeof(CharT);
+        const __m128i vec = sse2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+        for(; i >= charsPerVec; i -= charsPerVec)
+        {
+            const uint32_t mask = sse2_match_mask(str + (i - charsPerVec), vec);
+            if(mask)
+                return i - charsPerVec + bsr32(mask) / sizeof(CharT);
+        }
     }
-
-    const size_t thisLen = this->length();
-    assert(offset <= thisLen);
-    length = std::min(length, thisLen - offset);
-    // Result will be null-terminated.
-    if(m_NullTerminatedPtr == m_Begin && length == thisLen - offset)
-        return str_view_template<CharT>(m_Begin + offset, length, StillNullTerminated());
-    // Result will not be null-terminated.
-    return str_view_template<CharT>(m_Begin + offset, length);
+#endif
+    while(i--)
+    {
+        if(str[i] == ch)
+            return i;
+    }
+    return SIZE_MAX;
 }
 
-template<typename CharT>
-inline int str_view_template<CharT>::compare(const str_view_template<CharT>& rhs, bool case_sensitive) const
+inline uint32_t popcount32(uint32_t x)
 {
-    const size_t lhsLen = length();
-    const size_t rhsLen = rhs.length();
-    const size_t minLen = std::min(lhsLen, rhsLen);
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_popcount(x);
+#else
+    // __popcnt requires POPCNT instruction, which is not guaranteed with SSE2.
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    return (((x + (x >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+}
 
-    if(minLen > 0)
-    {
-        const int result = case_sensitive ?
-            tstrncmp(data(), rhs.data(), minLen) :
-            tstrnicmp(data(), rhs.data(), minLen);
-        if(result != 0)
-            return result;
-    }
+/*
+Kernels that take a null-terminated string of unknown length read it in whole aligned 16-byte
+blocks, which may extend past the terminator. It is safe, as such a block never crosses a page
+boundary, but address sanitizer would report it.
+*/
+#if defined(__clang__) || defined(__GNUC__)
+    #define STR_VIEW_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#elif defined(_MSC_VER) && defined(__SANITIZE_ADDRESS__)
+    #define STR_VIEW_NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#else
+    #define STR_VIEW_NO_SANITIZE_ADDRESS
+#endif
 
-    if(lhsLen < rhsLen)
-        return -1;
-    if(lhsLen > rhsLen)
-        return 1;
-    return 0;
-}
+#if STR_VIEW_SSE2
 
-template<typename CharT>
-inline bool str_view_template<CharT>::starts_with(CharT prefix, bool case_sensitive) const
+// Per-lane counters for count_char, selected by character size.
+template<size_t CharSize> struct sse2_counters;
+template<> struct sse2_counters<1>
 {
-    if(!empty())
+    static __m128i sub(__m128i lhs, __m128i rhs) { return _mm_sub_epi8(lhs, rhs); }
+    static size_t sum(__m128i v)
     {
-        if(case_sensitive)
-            return *m_Begin == prefix;
-        return tstrnicmp(m_Begin, &prefix, 1) == 0;
+        const __m128i sums = _mm_sad_epu8(v, _mm_setzero_si128());
+        return (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
     }
-    return false;
-}
-
-template<typename CharT>
-inline bool str_view_template<CharT>::starts_with(const str_view_template<CharT>& prefix, bool case_sensitive) const
+};
+template<> struct sse2_counters<4>
 {
-    const size_t prefixLen = prefix.length();
-    if(length() >= prefixLen)
+    static __m128i sub(__m128i lhs, __m128i rhs) { return _mm_sub_epi32(lhs, rhs); }
+    static size_t sum(__m128i v)
     {
-        const int cmpResult = case_sensitive ?
-            tstrncmp(m_Begin, prefix.m_Begin, prefixLen) :
-            tstrnicmp(m_Begin, prefix.m_Begin, prefixLen);
-        return cmpResult == 0;
+        v = _mm_add_epi32(v, _mm_srli_si128(v, 8));
+        v = _mm_add_epi32(v, _mm_srli_si128(v, 4));
+        return (size_t)(uint32_t)_mm_cvtsi128_si32(v);
     }
-    return false;
-}
+};
+template<> struct sse2_counters<2>
+{
+    static __m128i sub(__m128i lhs, __m128i rhs) { return _mm_sub_epi16(lhs, rhs); }
+    static size_t sum(__m128i v) { return sse2_counters<4>::sum(_mm_madd_epi16(v, _mm_set1_epi16(1))); }
+};
 
+// Returns mask with CharSize bits set for every character of the vector equal to any of separators.
 template<typename CharT>
-inline bool str_view_template<CharT>::ends_with(CharT suffix, bool case_sensitive) const
+inline uint32_t sse2_separator_mask(__m128i vec, const __m128i* separatorVecs, size_t separatorCount)
 {
-    const size_t thisLen = length();
-    if(thisLen > 0)
-    {
-        if(case_sensitive)
-            return m_Begin[thisLen - 1] == suffix;
-        return tstrnicmp(m_Begin + (thisLen - 1), &suffix, 1) == 0;
-    }
-    return false;
+    __m128i result = _mm_setzero_si128();
+    for(size_t i = 0; i < separatorCount; ++i)
+        result = _mm_or_si128(result, sse2_chars<sizeof(CharT)>::cmpeq(vec, separatorVecs[i]));
+    return (uint32_t)_mm_movemask_epi8(result);
 }
 
+#endif // #if STR_VIEW_SSE2
+
+// Returns number of characters equal to ch in str[0, count).
 template<typename CharT>
-inline bool str_view_template<CharT>::ends_with(const str_view_template<CharT>& suffix, bool case_sensitive) const
+inline size_t count_char(const CharT* str, size_t count, CharT ch)
 {
-    const size_t thisLen = length();
-    const size_t suffixLen = suffix.length();
-    if(thisLen >= suffixLen)
+    size_t result = 0;
+    size_t i = 0;
+#if STR_VIEW_DISPATCH
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(level == STR_VIEW_SIMD_LEVEL_AVX512)
+        return count_char_avx512(str, count, ch);
+    if(level == STR_VIEW_SIMD_LEVEL_AVX2)
+        return count_char_avx2(str, count, ch);
+    if(level == STR_VIEW_SIMD_LEVEL_SSE2)
+#endif
+#if STR_VIEW_SSE2
     {
-        const int cmpResult = case_sensitive ?
-            tstrncmp(m_Begin + (thisLen - suffixLen), suffix.m_Begin, suffixLen) :
-            tstrnicmp(m_Begin + (thisLen - suffixLen), suffix.m_Begin, suffixLen);
-        return cmpResult == 0;
+        // Matches are subtracted (comparison yields -1) from per-lane counters, which are summed
+        // before they can overflow.
+        typedef sse2_counters<sizeof(CharT)> Counters;
+        const size_t charsPerVec = 16 / sizeof(CharT);
+        const size_t maxIterations = 255;
+        const __m128i vec = sse2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+        while(i + charsPerVec <= count)
+        {
+            __m128i counters = _mm_setzero_si128();
+            for(size_t iter = 0; iter < maxIterations && i + charsPerVec <= count; ++iter, i += charsPerVec)
+            {
+                const __m128i chars = _mm_loadu_si128((const __m128i*)(str + i));
+                counters = Counters::sub(counters, sse2_chars<sizeof(CharT)>::cmpeq(chars, vec));
+            }
+            result += Counters::sum(counters);
+        }
     }
-    return false;
+#endif
+    for(; i < count; ++i)
+        result += str[i] == ch ? 1 : 0;
+    return result;
 }
 
+/*
+Like count_char, but str is null-terminated with unknown length. ch must not be 0.
+Finds the terminator in the same pass and returns the length in outLength.
+*/
 template<typename CharT>
-inline size_t str_view_template<CharT>::find(CharT ch, size_t pos) const
+STR_VIEW_NO_SANITIZE_ADDRESS inline size_t count_char_sz(const CharT* str, CharT ch, size_t* outLength)
 {
-    const size_t thisLen = length();
-    if(thisLen == 0)
-        return SIZE_MAX;
-    for(size_t i = pos; i < thisLen; ++i)
+    assert(ch != 0);
+    size_t result = 0;
+    const CharT* p = str;
+#if STR_VIEW_SSE2
+    // Scalar loop until the pointer is aligned.
+    for(; ((uintptr_t)p & 15) != 0; ++p)
     {
-        if(m_Begin[i] == ch)
-            return i;
+        if(*p == 0)
+        {
+            *outLength = p - str;
+            return result;
+        }
+        result += *p == ch ? 1 : 0;
     }
-    return SIZE_MAX;
-}
-
-template<typename CharT>
-inline size_t str_view_template<CharT>::find(const str_view_template<CharT>& substr, size_t pos) const
-{
-    const size_t subLen = substr.length();
-    if(subLen == 0)
-        return pos;
-    const size_t thisLen = length();
-    if(thisLen < subLen)
-        return SIZE_MAX;
-    const size_t maxPos = thisLen - subLen;
-    for(size_t i = pos; i <= maxPos; ++i)
+    const size_t charsPerVec = 16 / sizeof(CharT);
+    const __m128i vec = sse2_chars<sizeof(CharT)>::set1((uint32_t)ch);
+    const __m128i zero = _mm_setzero_si128();
+    for(;; p += charsPerVec)
     {
-        if(memcmp(m_Begin + i, substr.m_Begin, subLen * sizeof(CharT)) == 0)
-            return i;
+        const __m128i chars = _mm_load_si128((const __m128i*)p);
+        const uint32_t matchMask = (uint32_t)_mm_movemask_epi8(sse2_chars<sizeof(CharT)>::cmpeq(chars, vec));
+        const uint32_t zeroMask = (uint32_t)_mm_movemask_epi8(sse2_chars<sizeof(CharT)>::cmpeq(chars, zero));
+        if(zeroMask)
+        {
+            const uint32_t zeroIndex = ctz32(zeroMask);
+            result += popcount32(matchMask & ((1u << zeroIndex) - 1)) / sizeof(CharT);
+            *outLength = (p - str) + zeroIndex / sizeof(CharT);
+            return result;
+        }
+        result += popcount32(matchMask) / sizeof(CharT);
     }
-    return SIZE_MAX;
+#else
+    for(; *p; ++p)
+        result += *p == ch ? 1 : 0;
+    *outLength = p - str;
+    return result;
+#endif
 }
 
+/*
+Returns number of words in str[0, count) - maximal sequences of characters not equal to any of
+separators[0, separatorCount).
+*/
 template<typename CharT>
-inline size_t str_view_template<CharT>::rfind(CharT ch, size_t pos) const
+inline size_t count_words(const CharT* str, size_t count, const CharT* separators, size_t separatorCount)
 {
-    const size_t thisLen = length();
-    if(thisLen == 0)
-        return SIZE_MAX;
-    for(size_t i = std::min(pos, thisLen - 1) + 1; i--; )
+    size_t result = 0;
+    size_t i = 0;
+    bool prevSeparator = true;
+#if STR_VIEW_SSE2
+    const size_t charsPerVec = 16 / sizeof(CharT);
+    if(separatorCount <= 16 && count >= charsPerVec)
     {
-        if(m_Begin[i] == ch)
-            return i;
+        __m128i separatorVecs[16];
+        for(size_t s = 0; s < separatorCount; ++s)
+            separatorVecs[s] = sse2_chars<sizeof(CharT)>::set1((uint32_t)separators[s]);
+        // Masks have sizeof(CharT) bits per character. A word starts at a non-separator preceded by a separator.
+        const uint32_t charBits = (1u << sizeof(CharT)) - 1;
+        uint32_t carry = charBits;
+        for(; i + charsPerVec <= count; i += charsPerVec)
+        {
+            const __m128i chars = _mm_loadu_si128((const __m128i*)(str + i));
+            const uint32_t sepMask = sse2_separator_mask<CharT>(chars, separatorVecs, separatorCount);
+            const uint32_t starts = ~sepMask & ((sepMask << sizeof(CharT)) | carry) & 0xFFFF;
+            result += popcount32(starts) / sizeof(CharT);
+            carry = sepMask >> (16 - sizeof(CharT));
+        }
+        prevSeparator = carry != 0;
     }
-    return SIZE_MAX;
+#endif
+    for(; i < count; ++i)
+    {
+        const bool separator = std::find(separators, separators + separatorCount, str[i]) != separators + separatorCount;
+        result += !separator && prevSeparator ? 1 : 0;
+        prevSeparator = separator;
+    }
+    return result;
 }
 
+/*
+Like count_words, but str is null-terminated with unknown length. Separators must not contain 0.
+Finds the terminator in the same pass and returns the length in outLength.
+*/
 template<typename CharT>
-inline size_t str_view_template<CharT>::rfind(const str_view_template<CharT>& substr, size_t pos) const
+STR_VIEW_NO_SANITIZE_ADDRESS inline size_t count_words_sz(const CharT* str, const CharT* separators, size_t separatorCount,
+    size_t* outLength)
 {
-    const size_t subLen = substr.length();
-    if(subLen == 0)
-        return pos;
-    const size_t thisLen = length();
-    if(thisLen < subLen)
-        return SIZE_MAX;
-    for(size_t i = std::min(pos, thisLen - subLen) + 1; i--; )
+    size_t result = 0;
+    const CharT* p = str;
+    bool prevSeparator = true;
+#if STR_VIEW_SSE2
+    if(separatorCount <= 16)
     {
-        if(memcmp(m_Begin + i, substr.m_Begin, subLen * sizeof(CharT)) == 0)
-            return i;
+        for(; ((uintptr_t)p & 15) != 0; ++p)
+        {
+            if(*p == 0)
+            {
+                *outLength = p - str;
+                return result;
+            }
+            const bool separator = std::find(separators, separators + separatorCount, *p) != separators + separatorCount;
+            result += !separator && prevSeparator ? 1 : 0;
+            prevSeparator = separator;
+        }
+        __m128i separatorVecs[16];
+        for(size_t s = 0; s < separatorCount; ++s)
+            separatorVecs[s] = sse2_chars<sizeof(CharT)>::set1((uint32_t)separators[s]);
+        const size_t charsPerVec = 16 / sizeof(CharT);
+        const uint32_t charBits = (1u << sizeof(CharT)) - 1;
+        const __m128i zero = _mm_setzero_si128();
+        uint32_t carry = prevSeparator ? charBits : 0;
+        for(;; p += charsPerVec)
+        {
+            const __m128i chars = _mm_load_si128((const __m128i*)p);
+            uint32_t sepMask = sse2_separator_mask<CharT>(chars, separatorVecs, separatorCount);
+            const uint32_t zeroMask = (uint32_t)_mm_movemask_epi8(sse2_chars<sizeof(CharT)>::cmpeq(chars, zero));
+            // The terminator and anything after it is treated as separators.
+            const uint32_t zeroIndex = zeroMask ? ctz32(zeroMask) : 16;
+            sepMask |= ~((1u << zeroIndex) - 1);
+            const uint32_t starts = ~sepMask & ((sepMask << sizeof(CharT)) | carry) & 0xFFFF;
+            result += popcount32(starts) / sizeof(CharT);
+            if(zeroMask)
+            {
+                *outLength = (p - str) + zeroIndex / sizeof(CharT);
+                return result;
+            }
+            carry = (sepMask >> (16 - sizeof(CharT))) & charBits;
+        }
     }
-    return SIZE_MAX;
+#endif
+    for(; *p; ++p)
+    {
+        const bool separator = std::find(separators, separators + separatorCount, *p) != separators + separatorCount;
+        result += !separator && prevSeparator ? 1 : 0;
+        prevSeparator = separator;
+    }
+    *outLength = p - str;
+    return result;
 }
 
+/*
+Checks candidate position of needle in hay, whose first and last characters already match.
+Returns true if the search should stop at pos: the middle characters also match, or verifyBudget
+is exhausted - see find_substr.
+*/
 template<typename CharT>
-inline size_t str_view_template<CharT>::find_first_of(const str_view_template<CharT>& chars, size_t pos) const
+inline bool verify_substr_candidate(const CharT* hay, size_t pos, const CharT* needle, size_t middleLen, size_t* verifyBudget)
 {
-    const size_t charsLen = chars.length();
-    if(charsLen == 0)
-        return SIZE_MAX;
-    const size_t thisLen = length();
-    for(size_t thisIndex = pos; thisIndex < thisLen; ++thisIndex)
+    if(verifyBudget)
     {
-        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        if(*verifyBudget < middleLen)
         {
-            if(m_Begin[thisIndex] == chars.m_Begin[charsIndex])
-                return thisIndex;
+            *verifyBudget = 0;
+            return true;
         }
+        *verifyBudget -= middleLen;
     }
-    return SIZE_MAX;
+    return memcmp(hay + pos + 1, needle + 1, middleLen * sizeof(CharT)) == 0;
 }
 
+#if STR_VIEW_DISPATCH
+
+/*
+Equivalents of the SSE2 loop of find_substr. They check candidates starting at inOutPos, a whole
+vector at a time, up to maxPos. Return the position where the search stopped, or SIZE_MAX after
+setting inOutPos to the first position not checked, when fewer than a vector of positions remain.
+*/
 template<typename CharT>
-inline size_t str_view_template<CharT>::find_last_of(const str_view_template<CharT>& chars, size_t pos) const
+STR_VIEW_TARGET_AVX2 inline size_t find_substr_avx2(const CharT* hay, size_t& inOutPos, size_t maxPos,
+    const CharT* needle, size_t needleLen, size_t* verifyBudget)
 {
-    const size_t charsLen = chars.length();
-    if(charsLen == 0)
-        return SIZE_MAX;
-    const size_t thisLen = length();
-    if(thisLen == 0)
-        return SIZE_MAX;
-    for(size_t thisIndex = std::min(pos, thisLen - 1) + 1; thisIndex--; )
+    const size_t charsPerVec = 32 / sizeof(CharT);
+    const __m256i first = avx2_chars<sizeof(CharT)>::set1((uint32_t)needle[0]);
+    const __m256i last = avx2_chars<sizeof(CharT)>::set1((uint32_t)needle[needleLen - 1]);
+    size_t i = inOutPos;
+    for(; i + charsPerVec <= maxPos + 1; i += charsPerVec)
     {
-        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+            avx2_chars<sizeof(CharT)>::cmpeq(_mm256_loadu_si256((const __m256i*)(hay + i)), first),
+            avx2_chars<sizeof(CharT)>::cmpeq(_mm256_loadu_si256((const __m256i*)(hay + i + needleLen - 1)), last)));
+        while(mask)
         {
-            if(m_Begin[thisIndex] == chars.m_Begin[charsIndex])
-                return thisIndex;
+            const uint32_t bit = ctz32(mask);
+            const size_t pos = i + bit / sizeof(CharT);
+            if(verify_substr_candidate(hay, pos, needle, needleLen - 2, verifyBudget))
+                return pos;
+            mask &= ~(((1u << sizeof(CharT)) - 1) << bit);
         }
     }
+    inOutPos = i;
     return SIZE_MAX;
 }
 
 template<typename CharT>
-inline size_t str_view_template<CharT>::find_first_not_of(const str_view_template<CharT>& chars, size_t pos) const
+STR_VIEW_TARGET_AVX512 inline size_t find_substr_avx512(const CharT* hay, size_t& inOutPos, size_t maxPos,
+    const CharT* needle, size_t needleLen, size_t* verifyBudget)
 {
-    const size_t charsLen = chars.length();
-    if(charsLen == 0)
-        return SIZE_MAX;
-    const size_t thisLen = length();
-    for(size_t thisIndex = pos; thisIndex < thisLen; ++thisIndex)
+    const size_t charsPerVec = 64 / sizeof(CharT);
+    const __m512i first = avx512_chars<sizeof(CharT)>::set1((uint32_t)needle[0]);
+    const __m512i last = avx512_chars<sizeof(CharT)>::set1((uint32_t)needle[needleLen - 1]);
+    size_t i = inOutPos;
+    for(; i + charsPerVec <= maxPos + 1; i += charsPerVec)
     {
-        bool found = false;
-        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        uint64_t mask = avx512_chars<sizeof(CharT)>::cmpeq_mask(_mm512_loadu_si512((const void*)(hay + i)), first) &
+            avx512_chars<sizeof(CharT)>::cmpeq_mask(_mm512_loadu_si512((const void*)(hay + i + needleLen - 1)), last);
+        for(; mask; mask &= mask - 1)
         {
-            if(m_Begin[thisIndex] == chars.m_Begin[charsIndex])
-            {
-                found = true;
-                break;
-            }
+            const size_t pos = i + ctz64(mask);
+            if(verify_substr_candidate(hay, pos, needle, needleLen - 2, verifyBudget))
+                return pos;
         }
-        if(!found)
-            return thisIndex;
     }
+    inOutPos = i;
     return SIZE_MAX;
 }
 
+#endif // #if STR_VIEW_DISPATCH
+
+/*
+Returns index of the first occurrence of needle in hay[0, hayLen), or SIZE_MAX if not found.
+needleLen must be in range [1, hayLen].
+
+Candidate positions are found by comparing the first and the last character of the needle
+with a vector of hay at once, then verified with memcmp.
+
+If verifyBudget is not null, it limits the number of characters compared while verifying
+candidates, which protects against quadratic time on pathological inputs. When the budget
+is exhausted, the function sets *verifyBudget to 0 and returns the position at which the search
+stopped - all the positions before it were checked and rejected.
+*/
 template<typename CharT>
-inline size_t str_view_template<CharT>::find_last_not_of(const str_view_template<CharT>& chars, size_t pos) const
+inline size_t find_substr(const CharT* hay, size_t hayLen, const CharT* needle, size_t needleLen,
+    size_t* verifyBudget = nullptr)
 {
-    const size_t charsLen = chars.length();
-    if(charsLen == 0)
-        return SIZE_MAX;
-    const size_t thisLen = length();
-    if(thisLen == 0)
-        return SIZE_MAX;
-    for(size_t thisIndex = std::min(pos, thisLen - 1) + 1; thisIndex--; )
+    assert(needleLen > 0 && needleLen <= hayLen);
+    if(needleLen == 1)
+        return find_char(hay, hayLen, needle[0]);
+    const size_t maxPos = hayLen - needleLen;
+    const size_t middleLen = needleLen - 2;
+    size_t i = 0;
+#if STR_VIEW_DISPATCH
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(level == STR_VIEW_SIMD_LEVEL_AVX512 || level == STR_VIEW_SIMD_LEVEL_AVX2)
     {
-        bool found = false;
-        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        const size_t pos = level == STR_VIEW_SIMD_LEVEL_AVX512 ?
+            find_substr_avx512(hay, i, maxPos, needle, needleLen, verifyBudget) :
+            find_substr_avx2(hay, i, maxPos, needle, needleLen, verifyBudget);
+        if(pos != SIZE_MAX)
+            return pos;
+    }
+    if(level != STR_VIEW_SIMD_LEVEL_SCALAR)
+#endif
+#if STR_VIEW_SSE2
+    {
+        const size_t charsPerVec = 16 / sizeof(CharT);
+        const __m128i first = sse2_chars<sizeof(CharT)>::set1((uint32_t)needle[0]);
+        const __m128i last = sse2_chars<sizeof(CharT)>::set1((uint32_t)needle[needleLen - 1]);
+        for(; i + charsPerVec <= maxPos + 1; i += charsPerVec)
         {
-            if(m_Begin[thisIndex] == chars.m_Begin[charsIndex])
+            uint32_t mask = sse2_match_mask(hay + i, first) & sse2_match_mask(hay + i + needleLen - 1, last);
+            while(mask)
             {
-                found = true;
-                break;
+                const uint32_t bit = ctz32(mask);
+                const size_t pos = i + bit / sizeof(CharT);
+                if(verify_substr_candidate(hay, pos, needle, middleLen, verifyBudget))
+                    return pos;
+                mask &= ~(((1u << sizeof(CharT)) - 1) << bit);
             }
         }
-        if(!found)
-            return thisIndex;
+    }
+#endif
+    for(; i <= maxPos; ++i)
+    {
+        if(hay[i] == needle[0] && hay[i + needleLen - 1] == needle[needleLen - 1] &&
+            verify_substr_candidate(hay, i, needle, middleLen, verifyBudget))
+            return i;
     }
     return SIZE_MAX;
 }
 
+/*
+Pattern preprocessed for Myers' bit-parallel edit distance algorithm: for every character, a bit
+mask of positions in the pattern where it occurs. Patterns longer than 64 characters use multiple
+64-bit words per mask. Patterns up to 64 characters don't allocate memory.
+*/
 template<typename CharT>
-inline void str_view_template<CharT>::remove_prefix(size_t n)
+class myers_pattern
 {
-    if(n == 0)
-        return;
-    if(m_Length != SIZE_MAX)
+public:
+    // reversed - build masks for the pattern read from the end.
+    inline myers_pattern(const CharT* pattern, size_t length, bool reversed);
+
+    size_t word_count() const { return m_WordCount; }
+    // Bit of the last word that corresponds to the last character of the pattern.
+    uint64_t last_bit() const { return 1ull << ((m_Length - 1) % 64); }
+    // Returns word_count() words of the mask for given character.
+    inline const uint64_t* masks(CharT ch) const;
+
+private:
+    // Characters below this code have masks in a directly indexed table.
+    static const uint32_t DIRECT_COUNT = 256;
+    static const size_t MAX_SMALL_LENGTH = 64;
+
+    size_t m_Length;
+    size_t m_WordCount;
+    // Used when m_WordCount == 1.
+    uint64_t m_Direct[DIRECT_COUNT];
+    uint32_t m_OtherCodes[MAX_SMALL_LENGTH];
+    uint64_t m_OtherMasks[MAX_SMALL_LENGTH];
+    size_t m_OtherCount;
+    // Used when m_WordCount > 1.
+    std::vector<uint64_t> m_DirectWide;
+    std::vector<uint32_t> m_OtherCodesWide;
+    std::vector<uint64_t> m_OtherMasksWide;
+    std::vector<uint64_t> m_ZeroWide;
+    uint64_t m_Zero;
+
+    static uint32_t to_code(CharT ch) { return (uint32_t)(typename std::make_unsigned<CharT>::type)ch; }
+};
+
+template<typename CharT>
+inline myers_pattern<CharT>::myers_pattern(const CharT* pattern, size_t length, bool reversed) :
+    m_Length(length),
+    m_WordCount((length + 63) / 64),
+    m_OtherCount(0),
+    m_Zero(0)
+{
+    assert(length > 0);
+    if(m_WordCount == 1)
     {
-        assert(n <= m_Length);
-        if(n < m_Length)
+        memset(m_Direct, 0, sizeof(m_Direct));
+        for(size_t i = 0; i < length; ++i)
         {
-            if(m_NullTerminatedPtr)
+            const uint32_t code = to_code(pattern[reversed ? length - 1 - i : i]);
+            if(code < DIRECT_COUNT)
             {
-                if(m_NullTerminatedPtr == m_Begin)
-                    m_NullTerminatedPtr += n;
-                else
-                {
-                    delete[] m_NullTerminatedPtr;
-                    m_NullTerminatedPtr = nullptr;
-                }
+                m_Direct[code] |= 1ull << i;
+                continue;
             }
-            m_Length -= n;
-            m_Begin += n;
+            // Keep the other codes sorted.
+            size_t index = std::lower_bound(m_OtherCodes, m_OtherCodes + m_OtherCount, code) - m_OtherCodes;
+            if(index == m_OtherCount || m_OtherCodes[index] != code)
+            {
+                memmove(m_OtherCodes + index + 1, m_OtherCodes + index, (m_OtherCount - index) * sizeof(uint32_t));
+                memmove(m_OtherMasks + index + 1, m_OtherMasks + index, (m_OtherCount - index) * sizeof(uint64_t));
+                m_OtherCodes[index] = code;
+                m_OtherMasks[index] = 0;
+                ++m_OtherCount;
+            }
+            m_OtherMasks[index] |= 1ull << i;
+        }
+        return;
+    }
+
+    m_DirectWide.assign(DIRECT_COUNT * m_WordCount, 0);
+    m_ZeroWide.assign(m_WordCount, 0);
+    for(size_t i = 0; i < length; ++i)
+    {
+        const uint32_t code = to_code(pattern[i]);
+        if(code >= DIRECT_COUNT)
+            m_OtherCodesWide.push_back(code);
+    }
+    std::sort(m_OtherCodesWide.begin(), m_OtherCodesWide.end());
+    m_OtherCodesWide.erase(std::unique(m_OtherCodesWide.begin(), m_OtherCodesWide.end()), m_OtherCodesWide.end());
+    m_OtherMasksWide.assign(m_OtherCodesWide.size() * m_WordCount, 0);
+    for(size_t i = 0; i < length; ++i)
+    {
+        const uint32_t code = to_code(pattern[reversed ? length - 1 - i : i]);
+        uint64_t* masks;
+        if(code < DIRECT_COUNT)
+            masks = &m_DirectWide[code * m_WordCount];
+        else
+        {
+            const size_t index = std::lower_bound(m_OtherCodesWide.begin(), m_OtherCodesWide.end(), code) -
+                m_OtherCodesWide.begin();
+            masks = &m_OtherMasksWide[index * m_WordCount];
+        }
+        masks[i / 64] |= 1ull << (i % 64);
+    }
+}
+
+template<typename CharT>
+inline const uint64_t* myers_pattern<CharT>::masks(CharT ch) const
+{
+    const uint32_t code = to_code(ch);
+    if(m_WordCount == 1)
+    {
+        if(code < DIRECT_COUNT)
+            return &m_Direct[code];
+        const size_t index = std::lower_bound(m_OtherCodes, m_OtherCodes + m_OtherCount, code) - m_OtherCodes;
+        return index < m_OtherCount && m_OtherCodes[index] == code ? &m_OtherMasks[index] : &m_Zero;
+    }
+    if(code < DIRECT_COUNT)
+        return &m_DirectWide[code * m_WordCount];
+    const size_t index = std::lower_bound(m_OtherCodesWide.begin(), m_OtherCodesWide.end(), code) -
+        m_OtherCodesWide.begin();
+    return index < m_OtherCodesWide.size() && m_OtherCodesWide[index] == code ?
+        &m_OtherMasksWide[index * m_WordCount] : m_ZeroWide.data();
+}
+
+/*
+Processes one character of text in Myers' algorithm, as formulated by Hyyro for multiple words.
+pv, mv - vertical positive and negative delta vectors, updated in place.
+eq - masks of the pattern for the character.
+hin - horizontal delta entering the first row: 0 for searching, 1 for global edit distance.
+Returns horizontal delta at the last row of the pattern: -1, 0 or 1.
+*/
+inline int myers_advance(uint64_t* pv, uint64_t* mv, const uint64_t* eq, size_t wordCount, uint64_t lastBit, int hin)
+{
+    for(size_t w = 0; w < wordCount; ++w)
+    {
+        const uint64_t pvw = pv[w];
+        const uint64_t mvw = mv[w];
+        uint64_t eqw = eq[w];
+        const uint64_t highBit = w + 1 == wordCount ? lastBit : 1ull << 63;
+        const uint64_t xv = eqw | mvw;
+        if(hin < 0)
+            eqw |= 1;
+        const uint64_t xh = (((eqw & pvw) + pvw) ^ pvw) | eqw;
+        uint64_t ph = mvw | ~(xh | pvw);
+        uint64_t mh = pvw & xh;
+        const int hout = (ph & highBit) ? 1 : (mh & highBit) ? -1 : 0;
+        ph <<= 1;
+        mh <<= 1;
+        if(hin < 0)
+            mh |= 1;
+        else if(hin > 0)
+            ph |= 1;
+        pv[w] = mh | ~(xv | ph);
+        mv[w] = ph & xv;
+        hin = hout;
+    }
+    return hin;
+}
+
+// Vertical delta vectors of Myers' algorithm. Doesn't allocate memory for a single word.
+class myers_state
+{
+public:
+    explicit myers_state(size_t wordCount) :
+        m_WordCount(wordCount),
+        m_PvSmall(~0ull),
+        m_MvSmall(0)
+    {
+        if(wordCount > 1)
+        {
+            m_PvWide.assign(wordCount, ~0ull);
+            m_MvWide.assign(wordCount, 0);
+        }
+    }
+    // Processes one character of text. Returns horizontal delta at the last row.
+    template<typename CharT>
+    int advance(const myers_pattern<CharT>& pattern, CharT ch, int hin)
+    {
+        if(m_WordCount == 1)
+            return myers_advance(&m_PvSmall, &m_MvSmall, pattern.masks(ch), 1, pattern.last_bit(), hin);
+        return myers_advance(m_PvWide.data(), m_MvWide.data(), pattern.masks(ch), m_WordCount, pattern.last_bit(), hin);
+    }
+
+private:
+    size_t m_WordCount;
+    uint64_t m_PvSmall, m_MvSmall;
+    std::vector<uint64_t> m_PvWide, m_MvWide;
+};
+
+/*
+Computes Levenshtein distance between pattern and text, where pattern must not be empty.
+Returns SIZE_MAX if it exceeds maxDistance, possibly without processing the whole text.
+*/
+template<typename CharT>
+inline size_t myers_distance(const myers_pattern<CharT>& pattern, size_t patternLen,
+    const CharT* text, size_t textLen, size_t maxDistance)
+{
+    myers_state state(pattern.word_count());
+    size_t score = patternLen;
+    for(size_t j = 0; j < textLen; ++j)
+    {
+        score += state.advance(pattern, text[j], 1);
+        // Each remaining character can decrease the score by at most 1.
+        const size_t remaining = textLen - 1 - j;
+        if(score > maxDistance && score - maxDistance > remaining)
+            return SIZE_MAX;
+    }
+    return score <= maxDistance ? score : SIZE_MAX;
+}
+
+// Number of characters processed by one task of parallel algorithms.
+static const size_t PARALLEL_CHUNK_LENGTH = 1024 * 1024;
+
+/*
+Calls func(chunkIndex) for every chunk index in [0, chunkCount) using up to threadCount threads,
+including the calling one. Chunks are taken dynamically in increasing order, so threads that
+finish early take more of them.
+threadCount - 0 means std::thread::hardware_concurrency().
+*/
+template<typename Func>
+inline void parallel_for_chunks(size_t chunkCount, uint32_t threadCount, const Func& func)
+{
+#if !STR_VIEW_THREADS
+    (void)threadCount;
+    for(size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+        func(chunkIndex);
+#else
+    if(threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = (uint32_t)std::min<size_t>(threadCount, chunkCount);
+    std::atomic<size_t> nextChunk(0);
+    const auto worker = [&]()
+    {
+        for(size_t chunkIndex; (chunkIndex = nextChunk.fetch_add(1)) < chunkCount; )
+            func(chunkIndex);
+    };
+    std::vector<std::thread> threads;
+    for(uint32_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for(std::thread& thread : threads)
+        thread.join();
+#endif
+}
+
+// Lowers atomic value to newValue if it is smaller.
+inline void atomic_min(std::atomic<size_t>& value, size_t newValue)
+{
+    size_t oldValue = value.load();
+    while(newValue < oldValue && !value.compare_exchange_weak(oldValue, newValue)) { }
+}
+
+// Raises atomic value to newValue if it is larger.
+inline void atomic_max(std::atomic<size_t>& value, size_t newValue)
+{
+    size_t oldValue = value.load();
+    while(newValue > oldValue && !value.compare_exchange_weak(oldValue, newValue)) { }
+}
+
+/*
+Searches itemCount items in parallel chunks and returns index of the first found one, or the last
+one if reverse is true, or SIZE_MAX if nothing is found. Chunks beyond an already found item are skipped.
+searchChunk(begin, count) - searches items [begin, begin + count), returns index relative to begin or SIZE_MAX.
+*/
+template<typename Func>
+inline size_t parallel_search(size_t itemCount, bool reverse, uint32_t threadCount, const Func& searchChunk)
+{
+    const size_t chunkCount = (itemCount + PARALLEL_CHUNK_LENGTH - 1) / PARALLEL_CHUNK_LENGTH;
+    if(!reverse)
+    {
+        std::atomic<size_t> result(SIZE_MAX);
+        parallel_for_chunks(chunkCount, threadCount, [&](size_t chunkIndex)
+        {
+            const size_t chunkBegin = chunkIndex * PARALLEL_CHUNK_LENGTH;
+            if(chunkBegin >= result.load())
+                return;
+            const size_t index = searchChunk(chunkBegin, std::min((size_t)PARALLEL_CHUNK_LENGTH, itemCount - chunkBegin));
+            if(index != SIZE_MAX)
+                atomic_min(result, chunkBegin + index);
+        });
+        return result.load();
+    }
+    // Stored plus one, so that 0 means nothing found.
+    std::atomic<size_t> resultPlusOne(0);
+    parallel_for_chunks(chunkCount, threadCount, [&](size_t chunkIndex)
+    {
+        const size_t chunkBegin = (chunkCount - 1 - chunkIndex) * PARALLEL_CHUNK_LENGTH;
+        const size_t count = std::min((size_t)PARALLEL_CHUNK_LENGTH, itemCount - chunkBegin);
+        if(resultPlusOne.load() >= chunkBegin + count)
+            return;
+        const size_t index = searchChunk(chunkBegin, count);
+        if(index != SIZE_MAX)
+            atomic_max(resultPlusOne, chunkBegin + index + 1);
+    });
+    return resultPlusOne.load() - 1;
+}
+
+/*
+Returns mask with bit i set if x has odd number of bits set in range [0, i].
+With x being positions of quote characters, it gives positions inside quoted text.
+*/
+inline uint64_t prefix_xor64(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+#if STR_VIEW_SSE2
+
+// Returns mask with one bit for each of 16 characters starting at str that is equal to ch in vec.
+inline uint32_t sse2_mask16(const char* str, __m128i vec)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)str), vec));
+}
+template<typename CharT>
+inline typename std::enable_if<sizeof(CharT) == 2, uint32_t>::type sse2_mask16(const CharT* str, __m128i vec)
+{
+    const __m128i cmp0 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)str), vec);
+    const __m128i cmp1 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(str + 8)), vec);
+    return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(cmp0, cmp1));
+}
+template<typename CharT>
+inline typename std::enable_if<sizeof(CharT) == 4, uint32_t>::type sse2_mask16(const CharT* str, __m128i vec)
+{
+    __m128i cmp[4];
+    for(size_t i = 0; i < 4; ++i)
+        cmp[i] = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(str + i * 4)), vec);
+    return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(cmp[0], cmp[1]), _mm_packs_epi32(cmp[2], cmp[3])));
+}
+
+#endif // #if STR_VIEW_SSE2
+
+/*
+Finds characters of CSV syntax in 64 characters starting at str: sets bits of outStructurals
+for delimiters and '\n', and of outQuotes for quotes.
+*/
+template<typename CharT>
+inline void csv_classify64_scalar(const CharT* str, CharT delimiter, CharT quote, uint64_t& outStructurals, uint64_t& outQuotes)
+{
+    outStructurals = 0;
+    outQuotes = 0;
+    for(uint32_t i = 0; i < 64; ++i)
+    {
+        if(str[i] == delimiter || str[i] == (CharT)'\n')
+            outStructurals |= 1ull << i;
+        else if(str[i] == quote)
+            outQuotes |= 1ull << i;
+    }
+}
+
+#if STR_VIEW_SSE2
+
+template<typename CharT>
+inline void csv_classify64_sse2(const CharT* str, CharT delimiter, CharT quote, uint64_t& outStructurals, uint64_t& outQuotes)
+{
+    const __m128i delimiterVec = sse2_chars<sizeof(CharT)>::set1((uint32_t)delimiter);
+    const __m128i newLineVec = sse2_chars<sizeof(CharT)>::set1((uint32_t)'\n');
+    const __m128i quoteVec = sse2_chars<sizeof(CharT)>::set1((uint32_t)quote);
+    outStructurals = 0;
+    outQuotes = 0;
+    for(uint32_t i = 0; i < 64; i += 16)
+    {
+        outStructurals |= (uint64_t)(sse2_mask16(str + i, delimiterVec) | sse2_mask16(str + i, newLineVec)) << i;
+        outQuotes |= (uint64_t)sse2_mask16(str + i, quoteVec) << i;
+    }
+}
+
+#endif // #if STR_VIEW_SSE2
+
+#if STR_VIEW_DISPATCH
+
+// Only for 1-byte characters, as AVX2 comparisons of wider ones would need packing to get one bit per character.
+STR_VIEW_TARGET_AVX2 inline void csv_classify64_avx2(const char* str, char delimiter, char quote, uint64_t& outStructurals, uint64_t& outQuotes)
+{
+    const __m256i delimiterVec = _mm256_set1_epi8(delimiter);
+    const __m256i newLineVec = _mm256_set1_epi8('\n');
+    const __m256i quoteVec = _mm256_set1_epi8(quote);
+    outStructurals = 0;
+    outQuotes = 0;
+    for(uint32_t i = 0; i < 64; i += 32)
+    {
+        const __m256i chars = _mm256_loadu_si256((const __m256i*)(str + i));
+        outStructurals |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, delimiterVec), _mm256_cmpeq_epi8(chars, newLineVec))) << i;
+        outQuotes |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, quoteVec)) << i;
+    }
+}
+
+template<typename CharT>
+STR_VIEW_TARGET_AVX512 inline void csv_classify64_avx512(const CharT* str, CharT delimiter, CharT quote, uint64_t& outStructurals, uint64_t& outQuotes)
+{
+    typedef avx512_chars<sizeof(CharT)> Chars;
+    const size_t charsPerVec = 64 / sizeof(CharT);
+    const __m512i delimiterVec = Chars::set1((uint32_t)delimiter);
+    const __m512i newLineVec = Chars::set1((uint32_t)'\n');
+    const __m512i quoteVec = Chars::set1((uint32_t)quote);
+    outStructurals = 0;
+    outQuotes = 0;
+    for(size_t i = 0; i < 64; i += charsPerVec)
+    {
+        const __m512i chars = _mm512_loadu_si512((const void*)(str + i));
+        outStructurals |= (Chars::cmpeq_mask(chars, delimiterVec) | Chars::cmpeq_mask(chars, newLineVec)) << i;
+        outQuotes |= Chars::cmpeq_mask(chars, quoteVec) << i;
+    }
+}
+
+#endif // #if STR_VIEW_DISPATCH
+
+template<typename CharT>
+inline void csv_classify64(const CharT* str, CharT delimiter, CharT quote, uint64_t& outStructurals, uint64_t& outQuotes)
+{
+#if STR_VIEW_DISPATCH
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(level == STR_VIEW_SIMD_LEVEL_AVX512)
+        csv_classify64_avx512(str, delimiter, quote, outStructurals, outQuotes);
+    else if(sizeof(CharT) == 1 && level == STR_VIEW_SIMD_LEVEL_AVX2)
+        csv_classify64_avx2((const char*)str, (char)delimiter, (char)quote, outStructurals, outQuotes);
+    else if(level != STR_VIEW_SIMD_LEVEL_SCALAR)
+        csv_classify64_sse2(str, delimiter, quote, outStructurals, outQuotes);
+    else
+        csv_classify64_scalar(str, delimiter, quote, outStructurals, outQuotes);
+#elif STR_VIEW_SSE2
+    csv_classify64_sse2(str, delimiter, quote, outStructurals, outQuotes);
+#else
+    csv_classify64_scalar(str, delimiter, quote, outStructurals, outQuotes);
+#endif
+}
+
+/*
+Appends base + i + 1 to outLineStarts for every '\n' at str[i], i in [0, count) - beginnings of lines that follow
+these line breaks. Blocks of 64 characters are compared using SSE2 and only positions of set bits are visited.
+*/
+template<typename CharT>
+inline void append_line_starts(const CharT* str, size_t count, size_t base, std::vector<size_t>& outLineStarts)
+{
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    const __m128i newLineVec = sse2_chars<sizeof(CharT)>::set1((uint32_t)'\n');
+    for(; i + 64 <= count; i += 64)
+    {
+        uint64_t mask = 0;
+        for(uint32_t j = 0; j < 64; j += 16)
+            mask |= (uint64_t)sse2_mask16(str + i + j, newLineVec) << j;
+        for(; mask; mask &= mask - 1)
+            outLineStarts.push_back(base + i + ctz64(mask) + 1);
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        if(str[i] == (CharT)'\n')
+            outLineStarts.push_back(base + i + 1);
+    }
+}
+
+#if STR_VIEW_SSE2
+
+// Returns mask of bytes in range [lo, hi]. Bytes 128..255 are never in range.
+inline __m128i sse2_in_range(__m128i bytes, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8((char)(lo - 1))), _mm_cmpgt_epi8(_mm_set1_epi8((char)(hi + 1)), bytes));
+}
+
+#endif // #if STR_VIEW_SSE2
+
+/*
+Writes src[0, count) to dst with ASCII letters converted to upper case if toUpper, lower case otherwise.
+Characters are compared as signed lanes, so values above 127 (or 0x7FFF for 2-byte characters) never
+fall into the letter range.
+*/
+template<typename CharT>
+inline void ascii_convert_case(const CharT* src, size_t count, CharT* dst, bool toUpper)
+{
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    typedef sse2_chars<sizeof(CharT)> chars;
+    const size_t charsPerVec = 16 / sizeof(CharT);
+    const __m128i rangeBegin = chars::set1(toUpper ? 'a' - 1 : 'A' - 1);
+    const __m128i rangeEnd = chars::set1(toUpper ? 'z' + 1 : 'Z' + 1);
+    const __m128i delta = chars::set1(toUpper ? (uint32_t)-('a' - 'A') : (uint32_t)('a' - 'A'));
+    for(; i + charsPerVec <= count; i += charsPerVec)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i isLetter = _mm_and_si128(chars::cmpgt(v, rangeBegin), chars::cmpgt(rangeEnd, v));
+        _mm_storeu_si128((__m128i*)(dst + i), chars::add(v, _mm_and_si128(isLetter, delta)));
+    }
+#endif
+    for(; i < count; ++i)
+        dst[i] = toUpper ? ascii_to_upper(src[i]) : ascii_to_lower(src[i]);
+}
+
+// Returns value of a hexadecimal digit, or -1 if ch is not one.
+template<typename CharT>
+inline int hex_digit_value(CharT ch)
+{
+    if(ch >= (CharT)'0' && ch <= (CharT)'9')
+        return (int)(ch - (CharT)'0');
+    if(ch >= (CharT)'a' && ch <= (CharT)'f')
+        return (int)(ch - (CharT)'a') + 10;
+    if(ch >= (CharT)'A' && ch <= (CharT)'F')
+        return (int)(ch - (CharT)'A') + 10;
+    return -1;
+}
+
+// Returns 6-bit value of a base64 character, or -1 if ch is not one.
+template<typename CharT>
+inline int base64_char_value(CharT ch, bool urlSafe)
+{
+    if(ch >= (CharT)'A' && ch <= (CharT)'Z')
+        return (int)(ch - (CharT)'A');
+    if(ch >= (CharT)'a' && ch <= (CharT)'z')
+        return (int)(ch - (CharT)'a') + 26;
+    if(ch >= (CharT)'0' && ch <= (CharT)'9')
+        return (int)(ch - (CharT)'0') + 52;
+    if(ch == (CharT)(urlSafe ? '-' : '+'))
+        return 62;
+    if(ch == (CharT)(urlSafe ? '_' : '/'))
+        return 63;
+    return -1;
+}
+
+inline const char* base64_alphabet(bool urlSafe)
+{
+    return urlSafe ?
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_" :
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+}
+
+// Characters that need handling in escape and unescape functions.
+enum ESCAPE_SCAN { ESCAPE_SCAN_BACKSLASH, ESCAPE_SCAN_PERCENT, ESCAPE_SCAN_PERCENT_PLUS, ESCAPE_SCAN_C, ESCAPE_SCAN_JSON, ESCAPE_SCAN_URL };
+
+template<ESCAPE_SCAN Scan, typename CharT>
+inline bool needs_escape_scan(CharT ch)
+{
+    const uint32_t code = (uint32_t)(typename std::make_unsigned<CharT>::type)ch;
+    switch(Scan)
+    {
+    case ESCAPE_SCAN_BACKSLASH: return code == '\\';
+    case ESCAPE_SCAN_PERCENT: return code == '%';
+    case ESCAPE_SCAN_PERCENT_PLUS: return code == '%' || code == '+';
+    case ESCAPE_SCAN_C: return code < 0x20 || code == 0x7F || code == '\\' || code == '"';
+    case ESCAPE_SCAN_JSON: return code < 0x20 || code == '\\' || code == '"';
+    default: // ESCAPE_SCAN_URL - all but unreserved characters from RFC 3986.
+        return !((code >= 'a' && code <= 'z') || (code >= 'A' && code <= 'Z') || (code >= '0' && code <= '9') ||
+            code == '-' || code == '.' || code == '_' || code == '~');
+    }
+}
+
+#if STR_VIEW_SSE2
+
+/*
+Vectorized version of needs_escape_scan for 16 characters converted with sse2_chars::load16_bytes.
+Characters above 255 become 255, which gives the same result for all the scans, as none of them
+needs 255 or any wider character.
+*/
+template<ESCAPE_SCAN Scan>
+inline __m128i sse2_needs_escape_scan(__m128i bytes)
+{
+    switch(Scan)
+    {
+    case ESCAPE_SCAN_BACKSLASH: return _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'));
+    case ESCAPE_SCAN_PERCENT: return _mm_cmpeq_epi8(bytes, _mm_set1_epi8('%'));
+    case ESCAPE_SCAN_PERCENT_PLUS:
+        return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('%')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('+')));
+    case ESCAPE_SCAN_C:
+        return _mm_or_si128(_mm_or_si128(sse2_in_range(bytes, 0, 0x1F), _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x7F))),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))));
+    case ESCAPE_SCAN_JSON:
+        return _mm_or_si128(sse2_in_range(bytes, 0, 0x1F),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))));
+    default:
+    {
+        // Bytes above 127 are negative, so they fall into none of the ranges.
+        const __m128i alnum = _mm_or_si128(_mm_or_si128(sse2_in_range(bytes, 'a', 'z'), sse2_in_range(bytes, 'A', 'Z')),
+            sse2_in_range(bytes, '0', '9'));
+        const __m128i other = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('-')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('.'))),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('~'))));
+        return _mm_andnot_si128(_mm_or_si128(alnum, other), _mm_set1_epi8(-1));
+    }
+    }
+}
+
+#endif // #if STR_VIEW_SSE2
+
+#if STR_VIEW_DISPATCH
+
+STR_VIEW_TARGET_AVX2 inline __m256i avx2_in_range(__m256i bytes, char lo, char hi)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8((char)(lo - 1))), _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), bytes));
+}
+
+// AVX2 version of sse2_needs_escape_scan, for 32 characters of 1 byte.
+template<ESCAPE_SCAN Scan>
+STR_VIEW_TARGET_AVX2 inline __m256i avx2_needs_escape_scan(__m256i bytes)
+{
+    switch(Scan)
+    {
+    case ESCAPE_SCAN_BACKSLASH: return _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'));
+    case ESCAPE_SCAN_PERCENT: return _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('%'));
+    case ESCAPE_SCAN_PERCENT_PLUS:
+        return _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('%')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('+')));
+    case ESCAPE_SCAN_C:
+        return _mm256_or_si256(_mm256_or_si256(avx2_in_range(bytes, 0, 0x1F), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x7F))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"'))));
+    case ESCAPE_SCAN_JSON:
+        return _mm256_or_si256(avx2_in_range(bytes, 0, 0x1F),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"'))));
+    default:
+    {
+        const __m256i alnum = _mm256_or_si256(_mm256_or_si256(avx2_in_range(bytes, 'a', 'z'), avx2_in_range(bytes, 'A', 'Z')),
+            avx2_in_range(bytes, '0', '9'));
+        const __m256i other = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('.'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('~'))));
+        return _mm256_andnot_si256(_mm256_or_si256(alnum, other), _mm256_set1_epi8(-1));
+    }
+    }
+}
+
+/*
+Returns index of the first character in str[0, count) that needs handling,
+or position of the first character not checked, when fewer than 32 remain.
+*/
+template<ESCAPE_SCAN Scan>
+STR_VIEW_TARGET_AVX2 inline size_t find_escape_scan_avx2(const char* str, size_t count)
+{
+    size_t i = 0;
+    for(; i + 32 <= count; i += 32)
+    {
+        const uint32_t mask = (uint32_t)_mm256_movemask_epi8(avx2_needs_escape_scan<Scan>(_mm256_loadu_si256((const __m256i*)(str + i))));
+        if(mask)
+            return i + ctz32(mask);
+    }
+    return i;
+}
+
+#endif // #if STR_VIEW_DISPATCH
+
+// Returns index of the first character in str[0, count) that needs handling, or count if there is none.
+template<ESCAPE_SCAN Scan, typename CharT>
+inline size_t find_escape_scan(const CharT* str, size_t count)
+{
+    size_t i = 0;
+#if STR_VIEW_DISPATCH
+    // Wide characters are first converted to bytes, which is done only for SSE2.
+    const STR_VIEW_SIMD_LEVEL level = simd_level();
+    if(sizeof(CharT) == 1 && level >= STR_VIEW_SIMD_LEVEL_AVX2)
+        i = find_escape_scan_avx2<Scan>((const char*)str, count);
+    if(level != STR_VIEW_SIMD_LEVEL_SCALAR)
+#endif
+#if STR_VIEW_SSE2
+    {
+        for(; i + 16 <= count; i += 16)
+        {
+            const uint32_t mask = (uint32_t)_mm_movemask_epi8(sse2_needs_escape_scan<Scan>(sse2_chars<sizeof(CharT)>::load16_bytes(str + i)));
+            if(mask)
+                return i + ctz32(mask);
+        }
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        if(needs_escape_scan<Scan>(str[i]))
+            return i;
+    }
+    return count;
+}
+
+// Writes code point as UTF-8 to out, which must have space for 4 bytes. Returns number of bytes written.
+inline size_t encode_utf8(uint32_t codePoint, unsigned char* out)
+{
+    if(codePoint < 0x80)
+    {
+        out[0] = (unsigned char)codePoint;
+        return 1;
+    }
+    if(codePoint < 0x800)
+    {
+        out[0] = (unsigned char)(0xC0 | (codePoint >> 6));
+        out[1] = (unsigned char)(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if(codePoint < 0x10000)
+    {
+        out[0] = (unsigned char)(0xE0 | (codePoint >> 12));
+        out[1] = (unsigned char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (unsigned char)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = (unsigned char)(0xF0 | (codePoint >> 18));
+    out[1] = (unsigned char)(0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = (unsigned char)(0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = (unsigned char)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+// Appends code point encoded as UTF-8, UTF-16 or UTF-32, depending on size of CharT.
+template<typename CharT>
+inline void append_code_point(std::basic_string<CharT>& dst, uint32_t codePoint)
+{
+    if(sizeof(CharT) == 1)
+    {
+        unsigned char bytes[4];
+        const size_t byteCount = encode_utf8(codePoint, bytes);
+        dst.append((const CharT*)bytes, byteCount);
+    }
+    else if(sizeof(CharT) == 2 && codePoint >= 0x10000)
+    {
+        dst += (CharT)(0xD800 + ((codePoint - 0x10000) >> 10));
+        dst += (CharT)(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+    }
+    else
+        dst += (CharT)codePoint;
+}
+
+/*
+Decodes a code point from UTF-8 sequence bytes[0, count), where the length of the sequence is already
+known from its first byte. Returns UINT32_MAX if the sequence is invalid, overlong or encodes a surrogate.
+*/
+inline uint32_t decode_utf8(const unsigned char* bytes, size_t count)
+{
+    static const uint32_t minCodePoint[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    uint32_t codePoint = bytes[0] & (0x7F >> count);
+    for(size_t i = 1; i < count; ++i)
+    {
+        if((bytes[i] & 0xC0) != 0x80)
+            return UINT32_MAX;
+        codePoint = (codePoint << 6) | (bytes[i] & 0x3F);
+    }
+    if(codePoint < minCodePoint[count] || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint < 0xE000))
+        return UINT32_MAX;
+    return codePoint;
+}
+
+// Returns length of UTF-8 sequence starting with given byte, or 0 if it cannot start one.
+inline size_t utf8_sequence_length(unsigned char firstByte)
+{
+    return firstByte < 0x80 ? 1 : firstByte < 0xC2 ? 0 : firstByte < 0xE0 ? 2 : firstByte < 0xF0 ? 3 : firstByte < 0xF5 ? 4 : 0;
+}
+
+/*
+Copies str[begin, count) to dst, after str[0, begin), replacing every sequence that starts with
+a character found by Scan with the result of process(str, count, pos, dst), which appends it and
+returns position after the sequence, or SIZE_MAX if it is invalid.
+Returns SIZE_MAX on success, otherwise position of the invalid sequence.
+*/
+template<ESCAPE_SCAN Scan, typename CharT, typename Process>
+inline size_t process_escape_scan(const CharT* str, size_t count, size_t begin, std::basic_string<CharT>& dst, Process process)
+{
+    dst.assign(str, begin);
+    size_t i = begin;
+    while(i < count)
+    {
+        const size_t next = process(str, count, i, dst);
+        if(next == SIZE_MAX)
+            return i;
+        i = next;
+        const size_t end = i + find_escape_scan<Scan>(str + i, count - i);
+        dst.append(str + i, end - i);
+        i = end;
+    }
+    return SIZE_MAX;
+}
+
+// Parses up to maxDigits hexadecimal digits starting at str[i]. Returns number of digits parsed.
+template<typename CharT>
+inline size_t parse_hex_digits(const CharT* str, size_t count, size_t i, size_t maxDigits, uint32_t& outValue)
+{
+    size_t digitCount = 0;
+    outValue = 0;
+    for(int digit; digitCount < maxDigits && i + digitCount < count && (digit = hex_digit_value(str[i + digitCount])) >= 0; ++digitCount)
+        outValue = (outValue << 4) | (uint32_t)digit;
+    return digitCount;
+}
+
+inline bool is_valid_code_point(uint32_t codePoint) { return codePoint <= 0x10FFFF && (codePoint < 0xD800 || codePoint >= 0xE000); }
+
+template<typename CharT>
+inline size_t unescape_c_sequence(const CharT* str, size_t count, size_t i, std::basic_string<CharT>& dst)
+{
+    if(++i == count)
+        return SIZE_MAX;
+    const CharT ch = str[i++];
+    uint32_t value;
+    switch(ch)
+    {
+    case (CharT)'n': dst += (CharT)'\n'; return i;
+    case (CharT)'t': dst += (CharT)'\t'; return i;
+    case (CharT)'r': dst += (CharT)'\r'; return i;
+    case (CharT)'a': dst += (CharT)'\a'; return i;
+    case (CharT)'b': dst += (CharT)'\b'; return i;
+    case (CharT)'f': dst += (CharT)'\f'; return i;
+    case (CharT)'v': dst += (CharT)'\v'; return i;
+    case (CharT)'\\': case (CharT)'\'': case (CharT)'"': case (CharT)'?':
+        dst += ch;
+        return i;
+    case (CharT)'x':
+    {
+        const size_t digitCount = parse_hex_digits(str, count, i, 2 * sizeof(CharT), value);
+        if(digitCount == 0)
+            return SIZE_MAX;
+        dst += (CharT)value;
+        return i + digitCount;
+    }
+    case (CharT)'u': case (CharT)'U':
+    {
+        const size_t digitCount = ch == (CharT)'u' ? 4 : 8;
+        if(parse_hex_digits(str, count, i, digitCount, value) != digitCount || !is_valid_code_point(value))
+            return SIZE_MAX;
+        append_code_point(dst, value);
+        return i + digitCount;
+    }
+    default:
+        if(ch < (CharT)'0' || ch > (CharT)'7')
+            return SIZE_MAX;
+        value = (uint32_t)(ch - (CharT)'0');
+        for(size_t digitCount = 1; digitCount < 3 && i < count && str[i] >= (CharT)'0' && str[i] <= (CharT)'7'; ++digitCount, ++i)
+            value = (value << 3) | (uint32_t)(str[i] - (CharT)'0');
+        if(value > (uint32_t)(typename std::make_unsigned<CharT>::type)~(CharT)0)
+            return SIZE_MAX;
+        dst += (CharT)value;
+        return i;
+    }
+}
+
+template<typename CharT>
+inline size_t unescape_json_sequence(const CharT* str, size_t count, size_t i, std::basic_string<CharT>& dst)
+{
+    if(++i == count)
+        return SIZE_MAX;
+    const CharT ch = str[i++];
+    switch(ch)
+    {
+    case (CharT)'"': case (CharT)'\\': case (CharT)'/': dst += ch; return i;
+    case (CharT)'b': dst += (CharT)'\b'; return i;
+    case (CharT)'f': dst += (CharT)'\f'; return i;
+    case (CharT)'n': dst += (CharT)'\n'; return i;
+    case (CharT)'r': dst += (CharT)'\r'; return i;
+    case (CharT)'t': dst += (CharT)'\t'; return i;
+    case (CharT)'u':
+    {
+        uint32_t value;
+        if(parse_hex_digits(str, count, i, 4, value) != 4 || (value >= 0xDC00 && value < 0xE000))
+            return SIZE_MAX;
+        i += 4;
+        if(value >= 0xD800 && value < 0xDC00)
+        {
+            // High surrogate must be followed by escaped low surrogate.
+            uint32_t low;
+            if(i + 2 > count || str[i] != (CharT)'\\' || str[i + 1] != (CharT)'u' ||
+                parse_hex_digits(str, count, i + 2, 4, low) != 4 || low < 0xDC00 || low >= 0xE000)
+                return SIZE_MAX;
+            value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00);
+            i += 6;
+        }
+        append_code_point(dst, value);
+        return i;
+    }
+    default:
+        return SIZE_MAX;
+    }
+}
+
+// Parses "%XX" at str[i]. Returns the byte value, or -1 if it's not there.
+template<typename CharT>
+inline int parse_percent_byte(const CharT* str, size_t count, size_t i)
+{
+    uint32_t value;
+    if(i >= count || str[i] != (CharT)'%' || parse_hex_digits(str, count, i + 1, 2, value) != 2)
+        return -1;
+    return (int)value;
+}
+
+template<typename CharT>
+inline size_t unescape_percent_sequence(const CharT* str, size_t count, size_t i, std::basic_string<CharT>& dst)
+{
+    if(str[i] == (CharT)'+')
+    {
+        dst += (CharT)' ';
+        return i + 1;
+    }
+    const int firstByte = parse_percent_byte(str, count, i);
+    if(firstByte < 0)
+        return SIZE_MAX;
+    if(sizeof(CharT) == 1 || firstByte < 0x80)
+    {
+        dst += (CharT)firstByte;
+        return i + 3;
+    }
+    // Wide characters need a whole UTF-8 sequence, made of consecutive percent-encoded bytes.
+    unsigned char bytes[4] = { (unsigned char)firstByte };
+    const size_t byteCount = utf8_sequence_length(bytes[0]);
+    if(byteCount == 0)
+        return SIZE_MAX;
+    for(size_t byteIndex = 1; byteIndex < byteCount; ++byteIndex)
+    {
+        const int byte = parse_percent_byte(str, count, i + byteIndex * 3);
+        if(byte < 0)
+            return SIZE_MAX;
+        bytes[byteIndex] = (unsigned char)byte;
+    }
+    const uint32_t codePoint = decode_utf8(bytes, byteCount);
+    if(codePoint == UINT32_MAX)
+        return SIZE_MAX;
+    append_code_point(dst, codePoint);
+    return i + byteCount * 3;
+}
+
+template<typename CharT>
+inline void append_ascii(std::basic_string<CharT>& dst, const char* str)
+{
+    for(; *str; ++str)
+        dst += (CharT)*str;
+}
+
+template<typename CharT>
+inline size_t escape_c_char(const CharT* str, size_t, size_t i, std::basic_string<CharT>& dst)
+{
+    const CharT ch = str[i];
+    const char* named = nullptr;
+    switch(ch)
+    {
+    case (CharT)'\\': named = "\\\\"; break;
+    case (CharT)'"': named = "\\\""; break;
+    case (CharT)'\n': named = "\\n"; break;
+    case (CharT)'\t': named = "\\t"; break;
+    case (CharT)'\r': named = "\\r"; break;
+    case (CharT)'\a': named = "\\a"; break;
+    case (CharT)'\b': named = "\\b"; break;
+    case (CharT)'\f': named = "\\f"; break;
+    case (CharT)'\v': named = "\\v"; break;
+    }
+    if(named)
+        append_ascii(dst, named);
+    else
+    {
+        // Always 3 octal digits, so a following digit is not taken as part of the sequence.
+        const uint32_t code = (uint32_t)(typename std::make_unsigned<CharT>::type)ch;
+        assert(code < 0x20 || code == 0x7F);
+        const char octal[] = { '\\', (char)('0' + (code >> 6)), (char)('0' + ((code >> 3) & 7)), (char)('0' + (code & 7)), '\0' };
+        append_ascii(dst, octal);
+    }
+    return i + 1;
+}
+
+template<typename CharT>
+inline size_t escape_json_char(const CharT* str, size_t, size_t i, std::basic_string<CharT>& dst)
+{
+    const CharT ch = str[i];
+    switch(ch)
+    {
+    case (CharT)'\\': append_ascii(dst, "\\\\"); break;
+    case (CharT)'"': append_ascii(dst, "\\\""); break;
+    case (CharT)'\n': append_ascii(dst, "\\n"); break;
+    case (CharT)'\t': append_ascii(dst, "\\t"); break;
+    case (CharT)'\r': append_ascii(dst, "\\r"); break;
+    case (CharT)'\b': append_ascii(dst, "\\b"); break;
+    case (CharT)'\f': append_ascii(dst, "\\f"); break;
+    default:
+    {
+        const uint32_t code = (uint32_t)(typename std::make_unsigned<CharT>::type)ch;
+        assert(code < 0x20);
+        const char unicode[] = { '\\', 'u', '0', '0', "0123456789abcdef"[code >> 4], "0123456789abcdef"[code & 15], '\0' };
+        append_ascii(dst, unicode);
+    }
+    }
+    return i + 1;
+}
+
+template<typename CharT>
+inline size_t escape_percent_char(const CharT* str, size_t count, size_t i, std::basic_string<CharT>& dst)
+{
+    uint32_t code = (uint32_t)(typename std::make_unsigned<CharT>::type)str[i++];
+    unsigned char bytes[4] = { (unsigned char)code };
+    size_t byteCount = 1;
+    if(sizeof(CharT) > 1 && code >= 0x80)
+    {
+        // Wide characters are encoded as UTF-8 bytes. Invalid ones become U+FFFD.
+        if(sizeof(CharT) == 2 && code >= 0xD800 && code < 0xDC00 && i < count &&
+            (uint32_t)str[i] >= 0xDC00 && (uint32_t)str[i] < 0xE000)
+            code = 0x10000 + ((code - 0xD800) << 10) + ((uint32_t)str[i++] - 0xDC00);
+        byteCount = encode_utf8(is_valid_code_point(code) ? code : 0xFFFD, bytes);
+    }
+    for(size_t byteIndex = 0; byteIndex < byteCount; ++byteIndex)
+    {
+        const char percent[] = { '%', "0123456789ABCDEF"[bytes[byteIndex] >> 4], "0123456789ABCDEF"[bytes[byteIndex] & 15], '\0' };
+        append_ascii(dst, percent);
+    }
+    return i;
+}
+
+/*
+Compares lhs[0, count) with rhs[0, count) after folding characters with TraitsT::fold, as unsigned values.
+Doesn't stop at '\0'. Equal prefix is skipped 8 bytes at a time using TraitsT::fold_block.
+*/
+template<typename TraitsT, typename CharT>
+inline int compare_folded(const CharT* lhs, const CharT* rhs, size_t count)
+{
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    const size_t charsPerBlock = 8 / sizeof(CharT);
+    size_t i = 0;
+    for(; i + charsPerBlock <= count; i += charsPerBlock)
+    {
+        uint64_t lhsBlock, rhsBlock;
+        memcpy(&lhsBlock, lhs + i, 8);
+        memcpy(&rhsBlock, rhs + i, 8);
+        if(TraitsT::fold_block(lhsBlock) != TraitsT::fold_block(rhsBlock))
+            break;
+    }
+    for(; i < count; ++i)
+    {
+        const UCharT lhsCh = (UCharT)TraitsT::fold(lhs[i]);
+        const UCharT rhsCh = (UCharT)TraitsT::fold(rhs[i]);
+        if(lhsCh != rhsCh)
+            return lhsCh < rhsCh ? -1 : 1;
+    }
+    return 0;
+}
+
+#if STR_VIEW_SSE2
+
+/*
+Loads 16 bytes of characters from str folded with TraitsT: ASCII letters using SIMD,
+other characters one by one, only in vectors that contain any of them.
+*/
+template<typename TraitsT, typename CharT>
+inline __m128i sse2_load_folded(const CharT* str)
+{
+    typedef sse2_chars<sizeof(CharT)> chars;
+    const size_t charsPerVec = 16 / sizeof(CharT);
+    const __m128i v = _mm_loadu_si128((const __m128i*)str);
+    if(sizeof(CharT) > 1)
+    {
+        const __m128i nonAscii = _mm_and_si128(v, chars::set1(~(uint32_t)0x7F));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(nonAscii, _mm_setzero_si128())) != 0xFFFF)
+        {
+            CharT folded[charsPerVec];
+            for(size_t i = 0; i < charsPerVec; ++i)
+                folded[i] = TraitsT::fold(str[i]);
+            return _mm_loadu_si128((const __m128i*)folded);
+        }
+    }
+    // Characters above 127 are negative or greater than 'Z', so they are not changed.
+    const __m128i isUpper = _mm_and_si128(chars::cmpgt(v, chars::set1('A' - 1)), chars::cmpgt(chars::set1('Z' + 1), v));
+    return chars::add(v, _mm_and_si128(isUpper, chars::set1('a' - 'A')));
+}
+
+#endif // #if STR_VIEW_SSE2
+
+/*
+Checks if str[0, count) folded with TraitsT is equal to folded[0, count), which is already folded.
+Equal prefix is skipped 8 bytes at a time using TraitsT::fold_block.
+*/
+template<typename TraitsT, typename CharT>
+inline bool equal_to_folded(const CharT* str, const CharT* folded, size_t count)
+{
+    const size_t charsPerBlock = 8 / sizeof(CharT);
+    size_t i = 0;
+    for(; i + charsPerBlock <= count; i += charsPerBlock)
+    {
+        uint64_t strBlock, foldedBlock;
+        memcpy(&strBlock, str + i, 8);
+        memcpy(&foldedBlock, folded + i, 8);
+        if(TraitsT::fold_block(strBlock) != foldedBlock)
+            return false;
+    }
+    for(; i < count; ++i)
+    {
+        if(TraitsT::fold(str[i]) != folded[i])
+            return false;
+    }
+    return true;
+}
+
+/*
+Returns the first position pos in [0, hayLen - needleLen] where hay[pos] folded with TraitsT equals first,
+hay[pos + needleLen - 1] folded equals last, and verify(pos) returns true, or SIZE_MAX if there is none.
+needleLen must be in range [1, hayLen]. Haystack is folded on the fly, 16 bytes at a time,
+and both characters are checked for all positions in the vector at once, so verify() is called rarely.
+*/
+template<typename TraitsT, typename CharT, typename VerifyT>
+inline size_t find_folded_first_last(const CharT* hay, size_t hayLen, size_t needleLen, CharT first, CharT last, VerifyT verify)
+{
+    const size_t posCount = hayLen - needleLen + 1;
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    typedef sse2_chars<sizeof(CharT)> chars;
+    const size_t charsPerVec = 16 / sizeof(CharT);
+    const __m128i firstVec = chars::set1((uint32_t)(typename std::make_unsigned<CharT>::type)first);
+    const __m128i lastVec = chars::set1((uint32_t)(typename std::make_unsigned<CharT>::type)last);
+    for(; i + charsPerVec <= posCount; i += charsPerVec)
+    {
+        __m128i match = chars::cmpeq(sse2_load_folded<TraitsT>(hay + i), firstVec);
+        if(needleLen > 1)
+            match = _mm_and_si128(match, chars::cmpeq(sse2_load_folded<TraitsT>(hay + i + needleLen - 1), lastVec));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+        while(mask)
+        {
+            const uint32_t byteIndex = ctz32(mask);
+            if(verify(i + byteIndex / sizeof(CharT)))
+                return i + byteIndex / sizeof(CharT);
+            mask &= ~((((uint32_t)1 << sizeof(CharT)) - 1) << byteIndex);
+        }
+    }
+#endif
+    for(; i < posCount; ++i)
+    {
+        if(TraitsT::fold(hay[i]) == first && TraitsT::fold(hay[i + needleLen - 1]) == last && verify(i))
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+// Like find_folded_first_last, but returns the last such position, searching backward from the end.
+template<typename TraitsT, typename CharT, typename VerifyT>
+inline size_t rfind_folded_first_last(const CharT* hay, size_t hayLen, size_t needleLen, CharT first, CharT last, VerifyT verify)
+{
+    size_t i = hayLen - needleLen + 1;
+#if STR_VIEW_SSE2
+    typedef sse2_chars<sizeof(CharT)> chars;
+    const size_t charsPerVec = 16 / sizeof(CharT);
+    const __m128i firstVec = chars::set1((uint32_t)(typename std::make_unsigned<CharT>::type)first);
+    const __m128i lastVec = chars::set1((uint32_t)(typename std::make_unsigned<CharT>::type)last);
+    while(i >= charsPerVec)
+    {
+        i -= charsPerVec;
+        __m128i match = chars::cmpeq(sse2_load_folded<TraitsT>(hay + i), firstVec);
+        if(needleLen > 1)
+            match = _mm_and_si128(match, chars::cmpeq(sse2_load_folded<TraitsT>(hay + i + needleLen - 1), lastVec));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+        while(mask)
+        {
+            // The highest bit belongs to the last byte of the character.
+            const uint32_t byteIndex = bsr32(mask) + 1 - (uint32_t)sizeof(CharT);
+            if(verify(i + byteIndex / sizeof(CharT)))
+                return i + byteIndex / sizeof(CharT);
+            mask &= ~((((uint32_t)1 << sizeof(CharT)) - 1) << byteIndex);
+        }
+    }
+#endif
+    while(i--)
+    {
+        if(TraitsT::fold(hay[i]) == first && TraitsT::fold(hay[i + needleLen - 1]) == last && verify(i))
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+/*
+Returns index of the first occurrence of needle in hay, comparing characters folded with TraitsT,
+or SIZE_MAX if not found. needleLen must be in range [1, hayLen].
+*/
+template<typename TraitsT, typename CharT>
+inline size_t find_folded(const CharT* hay, size_t hayLen, const CharT* needle, size_t needleLen)
+{
+    const size_t middleLen = needleLen > 2 ? needleLen - 2 : 0;
+    return find_folded_first_last<TraitsT>(hay, hayLen, needleLen, TraitsT::fold(needle[0]), TraitsT::fold(needle[needleLen - 1]),
+        [=](size_t pos) { return compare_folded<TraitsT>(hay + pos + 1, needle + 1, middleLen) == 0; });
+}
+
+// Like find_folded, but returns index of the last occurrence.
+template<typename TraitsT, typename CharT>
+inline size_t rfind_folded(const CharT* hay, size_t hayLen, const CharT* needle, size_t needleLen)
+{
+    const size_t middleLen = needleLen > 2 ? needleLen - 2 : 0;
+    return rfind_folded_first_last<TraitsT>(hay, hayLen, needleLen, TraitsT::fold(needle[0]), TraitsT::fold(needle[needleLen - 1]),
+        [=](size_t pos) { return compare_folded<TraitsT>(hay + pos + 1, needle + 1, middleLen) == 0; });
+}
+
+// Returns 200 characters: decimal digits of numbers 00, 01, ..., 99.
+inline const char* decimal_digit_pairs()
+{
+    static const char pairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    return pairs;
+}
+
+inline uint32_t decimal_digit_count(uint64_t value)
+{
+    uint32_t count = 1;
+    for(;;)
+    {
+        if(value < 10)
+            return count;
+        if(value < 100)
+            return count + 1;
+        if(value < 1000)
+            return count + 2;
+        if(value < 10000)
+            return count + 3;
+        value /= 10000;
+        count += 4;
+    }
+}
+
+// Writes decimal digits of value to dst, without null terminator. Returns their number.
+template<typename CharT>
+inline size_t write_decimal(uint64_t value, CharT* dst)
+{
+    const char* const pairs = decimal_digit_pairs();
+    const uint32_t len = decimal_digit_count(value);
+    CharT* p = dst + len;
+    while(value >= 100)
+    {
+        const size_t pair = (size_t)(value % 100) * 2;
+        value /= 100;
+        *--p = (CharT)pairs[pair + 1];
+        *--p = (CharT)pairs[pair];
+    }
+    if(value >= 10)
+    {
+        const size_t pair = (size_t)value * 2;
+        *--p = (CharT)pairs[pair + 1];
+        *--p = (CharT)pairs[pair];
+    }
+    else
+        *--p = (CharT)('0' + value);
+    return len;
+}
+
+/*
+Writes shortest representation of value that parses back to the same value, as 8-bit characters
+with null terminator. dst must have room for 32 characters. Returns length.
+*/
+template<typename FloatT>
+inline size_t write_float(FloatT value, char* dst)
+{
+    if(value != value)
+    {
+        memcpy(dst, "nan", 4);
+        return 3;
+    }
+    if(value == std::numeric_limits<FloatT>::infinity())
+    {
+        memcpy(dst, "inf", 4);
+        return 3;
+    }
+    if(value == -std::numeric_limits<FloatT>::infinity())
+    {
+        memcpy(dst, "-inf", 5);
+        return 4;
+    }
+#if STR_VIEW_CPP17 && defined(__cpp_lib_to_chars)
+    const std::to_chars_result result = std::to_chars(dst, dst + 31, value);
+    *result.ptr = '\0';
+    return (size_t)(result.ptr - dst);
+#else
+    // Precision of max_digits10 significant digits always round-trips. Shorter ones are tried first.
+    int len = 0;
+    for(int precision = std::numeric_limits<FloatT>::digits10; precision <= std::numeric_limits<FloatT>::max_digits10; ++precision)
+    {
+        len = snprintf(dst, 32, "%.*g", precision, (double)value);
+        const FloatT parsed = sizeof(FloatT) == sizeof(float) ? (FloatT)strtof(dst, nullptr) : (FloatT)strtod(dst, nullptr);
+        if(parsed == value)
+            break;
+    }
+    // Decimal separator of the current locale is replaced, so the result doesn't depend on it.
+    for(int i = 0; i < len; ++i)
+    {
+        if(dst[i] == ',')
+            dst[i] = '.';
+    }
+    return (size_t)len;
+#endif
+}
+
+// Returns true if ch separates components of a path: '/', and also '\\' if STR_VIEW_WINDOWS_PATHS is enabled.
+template<typename CharT>
+inline bool is_path_separator(CharT ch)
+{
+#if STR_VIEW_WINDOWS_PATHS
+    return ch == (CharT)'/' || ch == (CharT)'\\';
+#else
+    return ch == (CharT)'/';
+#endif
+}
+
+// Returns 2 if path starts with a drive letter, like "C:", and STR_VIEW_WINDOWS_PATHS is enabled, otherwise 0.
+template<typename CharT>
+inline size_t path_drive_length(const CharT* path, size_t len)
+{
+#if STR_VIEW_WINDOWS_PATHS
+    if(len >= 2 && path[1] == (CharT)':' &&
+        ((path[0] >= (CharT)'a' && path[0] <= (CharT)'z') || (path[0] >= (CharT)'A' && path[0] <= (CharT)'Z')))
+        return 2;
+#else
+    (void)path;
+    (void)len;
+#endif
+    return 0;
+}
+
+// Returns index of the first character of the file name - after the last separator or the drive.
+template<typename CharT>
+inline size_t path_filename_begin(const CharT* path, size_t len)
+{
+    const size_t driveLen = path_drive_length(path, len);
+    size_t i = len;
+    while(i > driveLen && !is_path_separator(path[i - 1]))
+        --i;
+    return i;
+}
+
+// Returns index of the dot that starts the extension, or len if there is no extension.
+template<typename CharT>
+inline size_t path_extension_begin(const CharT* path, size_t len)
+{
+    const size_t nameBegin = path_filename_begin(path, len);
+    // Dot at the beginning of the file name, like in ".bashrc", doesn't start an extension, and ".." has none.
+    for(size_t i = len; i > nameBegin + 1; --i)
+    {
+        if(path[i - 1] == (CharT)'.')
+            return i - 1 == nameBegin + 1 && len == nameBegin + 2 && path[nameBegin] == (CharT)'.' ? len : i - 1;
+    }
+    return len;
+}
+
+// Formats like printf to dst of dstSize characters. Returns length of the whole result, or negative value on error.
+inline int vformat(char* dst, size_t dstSize, const char* format, va_list args) { return vsnprintf(dst, dstSize, format, args); }
+// Returns negative value also if the result doesn't fit.
+inline int vformat(wchar_t* dst, size_t dstSize, const wchar_t* format, va_list args) { return vswprintf(dst, dstSize, format, args); }
+
+} // namespace str_view_detail
+
+/*
+Returns instruction set level used by kernels that are selected at runtime: searching and counting
+single characters, e.g. in find(), rfind(), count(), searching substrings in find(), comparing in
+compare() and comparison operators, scanning in escape and unescape functions, and classifying
+characters in csv_reader_template. Other kernels use SSE2 whenever STR_VIEW_SSE2 is enabled.
+
+By default it is the highest level supported by the CPU, detected on first use. It can be lowered
+by setting environment variable STR_VIEW_SIMD_LEVEL to "scalar", "sse2", "avx2" or "avx512" before
+first use, or by calling set_simd_level(), e.g. to compare performance of the kernels.
+Levels above SSE2 are available only if STR_VIEW_DISPATCH is enabled.
+*/
+inline STR_VIEW_SIMD_LEVEL get_simd_level() { return str_view_detail::simd_level(); }
+/*
+Sets instruction set level used by kernels selected at runtime, limited to the highest one supported.
+Returns the level actually set.
+Kernels that already run in other threads may finish with the previous level.
+*/
+inline STR_VIEW_SIMD_LEVEL set_simd_level(STR_VIEW_SIMD_LEVEL level)
+{
+    const STR_VIEW_SIMD_LEVEL newLevel = std::min(level, str_view_detail::detect_simd_level());
+    str_view_detail::simd_level_storage().store(newLevel, std::memory_order_relaxed);
+    return newLevel;
+}
+
+/*
+Traits policy - second template parameter of str_view_template, which selects at compile time
+how characters are compared, searched and hashed, so that e.g. case-insensitivity becomes a property
+of the type, used by its operator==, operator<, find(), rfind(), hash() with no branch at runtime.
+It contains:
+
+- case_sensitive - default value of case_sensitive parameters of compare(), starts_with(), ends_with(),
+  find(), rfind(), contains(), hash().
+- fold(ch) - returns the character used for case-insensitive comparison.
+- fold_block(block) - applies fold() to every character in 8 bytes, for hashing.
+
+count(), find_first_of() and similar, parallel_find() and similar always compare characters with fold(),
+so they follow case_sensitive of the traits. find_approx() compares characters exactly.
+*/
+template<typename CharT>
+struct str_view_traits
+{
+    static const bool case_sensitive = true;
+    static CharT fold(CharT ch) { return ch; }
+    static uint64_t fold_block(uint64_t block) { return block; }
+};
+
+/*
+Case-insensitive policy that folds ASCII letters only, regardless of locale.
+*/
+template<typename CharT>
+struct ascii_ci_traits
+{
+    static const bool case_sensitive = false;
+    static CharT fold(CharT ch) { return str_view_detail::ascii_to_lower(ch); }
+    static uint64_t fold_block(uint64_t block) { return str_view_detail::ascii_to_lower_swar<sizeof(CharT)>(block); }
+};
+
+/*
+Case-insensitive policy used by views with case-sensitive traits when a method is called with
+case_sensitive = false. It folds ASCII letters for char, as the encoding is not known,
+and uses Unicode simple case folding for wchar_t, e.g. L'\u0104' matches L'\u0105'.
+*/
+template<typename CharT>
+struct simple_ci_traits
+{
+    static const bool case_sensitive = false;
+    static CharT fold(CharT ch) { return str_view_detail::simple_fold(ch); }
+    static uint64_t fold_block(uint64_t block) { return str_view_detail::simple_fold_block<CharT>(block); }
+};
+
+template<typename CharT, typename TraitsT = str_view_traits<CharT>>
+class str_view_template
+{
+public:
+    typedef CharT CharT;
+    typedef std::basic_string<CharT, std::char_traits<CharT>, std::allocator<CharT>> StringT;
+#if STR_VIEW_CPP17
+    typedef std::basic_string_view<CharT, std::char_traits<CharT>> StringViewT;
+#endif
+
+    /*
+    Initializes to empty string.
+    */
+    inline str_view_template();
+    
+    /*
+    Initializes from a null-terminated string.
+    Null is acceptable. It means empty string.
+    */
+    inline str_view_template(const CharT* sz);
+    /*
+    Initializes from not null-terminated string.
+    Null is acceptable if length is 0.
+    */
+    inline str_view_template(const CharT* str, size_t length);
+    /*
+    Initializes from an array of characters with length known at compile time.
+    */
+    template<size_t Length>
+    inline str_view_template(const CharT str[Length]);
+    /*
+    Initializes from string with given length, with explicit statement that it is null-terminated.
+    Null is acceptable if length is 0.
+    */
+    struct StillNullTerminated { };
+    inline str_view_template(const CharT* str, size_t length, StillNullTerminated);
+    
+    /*
+    Initializes from an STL string.
+    length can exceed actual str.length(). It then spans to the end of str.
+    */
+    inline str_view_template(const StringT& str, size_t offset = 0, size_t length = SIZE_MAX);
+#if STR_VIEW_CPP17
+    /*
+    Initializes from an STL string view.
+    length can exceed actual str.length(). It then spans to the end of str.
+    */
+    inline str_view_template(const StringViewT& str, size_t offset = 0, size_t length = SIZE_MAX);
+#endif
+
+    // Copy constructor.
+    inline str_view_template(const str_view_template<CharT, TraitsT>& src, size_t offset = 0, size_t length = SIZE_MAX);
+    /*
+    Initializes from a view with different traits, e.g. ci_str_view from str_view.
+    Knowledge about null termination is preserved, but not an internal null-terminated copy.
+    */
+    template<typename OtherTraitsT>
+    inline str_view_template(const str_view_template<CharT, OtherTraitsT>& src);
+    // Move constructor.
+    inline str_view_template(str_view_template<CharT, TraitsT>&& src);
+    
+    inline ~str_view_template();
+
+    // Copy assignment operator.
+    inline str_view_template<CharT, TraitsT>& operator=(const str_view_template<CharT, TraitsT>& src);
+    // Move assignment operator.
+    inline str_view_template<CharT, TraitsT>& operator=(str_view_template<CharT, TraitsT>&& src);
+
+    /*
+    Exchanges the view with that of rhs.
+    */
+    inline void swap(str_view_template<CharT, TraitsT>& rhs) noexcept;
+
+    /*
+    Returns the number of characters in the view. 
+    */
+    inline size_t length() const;
+    /*
+    Returns the number of characters in the view. 
+    Usage of this method is not recommended because its name may be misleading -
+    it may suggest size in bytes not in characters.
+    */
+    inline size_t size() const { return length(); }
+    /*
+    Checks if the view has no characters, i.e. whether length() == 0.
+    It may be more efficient than checking length().
+    */
+    inline bool empty() const;
+    /*
+    Returns a pointer to the underlying character array.
+    The pointer is such that the range [data(); data() + length()) is valid and the values in it
+    correspond to the values of the view. 
+    If empty() == true, returned pointer is undefined.
+    */
+    inline const CharT* data() const { return m_Begin; }
+    /*
+    Returns an iterator to the first character of the view.
+    If empty() == true, returned pointer may or may not be null, but always begin() == end().
+    */
+    inline const CharT* begin() const { return m_Begin; }
+    /*
+    Returns an iterator to the character following the last character of the view.
+    This character acts as a placeholder, attempting to access it results in undefined behavior. 
+    */
+    inline const CharT* end() const { return m_Begin + length(); }
+    /*
+    Returns first character in the view.
+    The behavior is undefined if empty() == true.
+    */
+    inline const CharT front() const { return *m_Begin; }
+    /*
+    Returns last character in the view.
+    The behavior is undefined if empty() == true. 
+    */
+    inline const CharT back() const { return m_Begin[length() - 1]; }
+    
+    inline CharT operator[](size_t index) const { return m_Begin[index]; }
+    inline CharT at(size_t index) const { return m_Begin[index]; }
+
+    /*
+    Returns null-terminated string with contents of this object.
+    Possibly an internal copy.
+    */
+    inline const CharT* c_str() const;
+    /*
+    Returns true if the view is known to point to a null-terminated string,
+    so that c_str() returns data() without making a copy.
+    Returns false for empty view.
+    */
+    inline bool is_null_terminated() const { return m_Begin != nullptr && m_NullTerminatedPtr == m_Begin; }
+
+    /*
+    Returns a view of the substring [offset, offset + length).
+    length can exceed actual length(). It then spans to the end of this string.
+    */
+    inline str_view_template<CharT, TraitsT> substr(size_t offset = 0, size_t length = SIZE_MAX) const;
+
+    /*
+    Copies the substring [offset, offset + length) to the character string pointed to by dst.
+    If pointer string ends before length is reached, string is copied to the end.
+    Null character is not added past the end of destination.
+    Returns number of characters copied.
+    */
+    inline size_t copy_to(CharT* dst, size_t offset = 0, size_t length = SIZE_MAX) const;
+    /*
+    Copies the string to dst with ASCII letters converted to lower or upper case, followed by null character,
+    so dst must have space for length() + 1 characters. Other characters are copied unchanged, regardless of locale.
+    Returns view of dst, which is known to be null-terminated. dst may be equal to data() to convert in place
+    a string that is not a literal. Then the null character is not written, so characters after the view stay
+    unchanged, and the returned view is null-terminated only if this one is.
+    */
+    inline str_view_template<CharT, TraitsT> to_lower_into(CharT* dst) const;
+    inline str_view_template<CharT, TraitsT> to_upper_into(CharT* dst) const;
+
+    /*
+    Returns hash of the characters in the view, for use in hash tables.
+    If case_sensitive is false, ASCII letters are folded to lower case on the fly (or characters are folded
+    as defined by case-insensitive traits), so strings that differ only in case get the same hash, without
+    making a normalized copy.
+    Hash values are not stable between versions of this library.
+    */
+    inline size_t hash(bool case_sensitive = TraitsT::case_sensitive) const;
+
+    inline void to_string(StringT& dst, size_t offset = 0, size_t length = SIZE_MAX) const;
+    inline StringT to_string(size_t offset = 0, size_t length = SIZE_MAX) const;
+
+#if STR_VIEW_CPP17
+    inline void to_string_view(StringViewT& dst, size_t offset = 0, size_t length = SIZE_MAX) const;
+    inline StringViewT to_string_view(size_t offset = 0, size_t length = SIZE_MAX) const;
+#endif
+
+    /*
+    Compares this with rhs lexicographically.
+    Returns negative value, 0, or positive value, depending on the result.
+    
+    All characters are compared, including '\0', as unsigned values, like memcmp, consistently with find() and hash().
+    Case-insensitive comparison folds ASCII letters to lowercase, or uses TraitsT::fold.
+    */
+    inline int compare(const str_view_template<CharT, TraitsT>& rhs, bool case_sensitive = TraitsT::case_sensitive) const;
+    /*
+    Compares this with rhs lexicographically using functions like strncmp and strnicmp,
+    so characters past the first '\0' are not compared. If they are equal, the shorter view goes first.
+    This is how compare() worked in previous versions.
+    Use it when views of the same length may contain garbage after the terminator, e.g. when they come from fixed-size buffers.
+    */
+    inline int compare_until_null(const str_view_template<CharT, TraitsT>& rhs, bool case_sensitive = TraitsT::case_sensitive) const;
+    /*
+    Returns number of initial characters equal in this and rhs, compared exactly, including '\0'.
+    */
+    inline size_t common_prefix_length(const str_view_template<CharT, TraitsT>& rhs) const;
+
+    // Equality checks lengths first, so views of different lengths are not compared character by character.
+    inline bool operator==(const str_view_template<CharT, TraitsT>& rhs) const { return equals(rhs); }
+    inline bool operator!=(const str_view_template<CharT, TraitsT>& rhs) const { return !equals(rhs); }
+    inline bool operator< (const str_view_template<CharT, TraitsT>& rhs) const { return compare(rhs) <  0; }
+    inline bool operator> (const str_view_template<CharT, TraitsT>& rhs) const { return compare(rhs) >  0; }
+    inline bool operator<=(const str_view_template<CharT, TraitsT>& rhs) const { return compare(rhs) <= 0; }
+    inline bool operator>=(const str_view_template<CharT, TraitsT>& rhs) const { return compare(rhs) >= 0; }
+
+    /*
+    Checks if the string view begins with the given prefix.
+
+    If the string view is shorter than the prefix, returns false.
+    If prefix is empty, returns true.
+    */
+    inline bool starts_with(CharT prefix, bool case_sensitive = TraitsT::case_sensitive) const;
+    inline bool starts_with(const str_view_template<CharT, TraitsT>& prefix, bool case_sensitive = TraitsT::case_sensitive) const;
+
+    /*
+    Checks if the string view ends with the given suffix.
+
+    If the string view is shorter than the suffix, returns false.
+    If suffix is empty, returns true.
+    */
+    inline bool ends_with(CharT suffix, bool case_sensitive = TraitsT::case_sensitive) const;
+    inline bool ends_with(const str_view_template<CharT, TraitsT>& suffix, bool case_sensitive = TraitsT::case_sensitive) const;
+
+    /*
+    Finds the first substring equal to the given character sequence.
+    pos - position at which to start the search.
+    Returns position of the first character of the found substring, or SIZE_MAX if no such substring is found.
+    If substr is empty, returns pos.
+
+    Case-insensitive search folds characters of this string on the fly, 16 bytes at a time,
+    so no copy is made. See simple_ci_traits.
+    */
+    inline size_t find(CharT ch, size_t pos = 0, bool case_sensitive = TraitsT::case_sensitive) const;
+    inline size_t find(const str_view_template<CharT, TraitsT>& substr, size_t pos = 0, bool case_sensitive = TraitsT::case_sensitive) const;
+
+    /*
+    Finds the last substring equal to the given character sequence.
+    pos - position at which to start the search.
+    Returns position of the first character of the found substring, or SIZE_MAX if no such substring is found.
+    If substr is empty, returns pos.
+    */
+    inline size_t rfind(CharT ch, size_t pos = SIZE_MAX, bool case_sensitive = TraitsT::case_sensitive) const;
+    inline size_t rfind(const str_view_template<CharT, TraitsT>& substr, size_t pos = SIZE_MAX, bool case_sensitive = TraitsT::case_sensitive) const;
+
+    // Checks if the string contains the character or the substring. Empty substring is always contained.
+    inline bool contains(CharT ch, bool case_sensitive = TraitsT::case_sensitive) const { return find(ch, 0, case_sensitive) != SIZE_MAX; }
+    inline bool contains(const str_view_template<CharT, TraitsT>& substr, bool case_sensitive = TraitsT::case_sensitive) const
+    {
+        return find(substr, 0, case_sensitive) != SIZE_MAX;
+    }
+
+    /*
+    Finds the first substring that differs from the pattern by at most max_errors edits
+    (insertions, deletions, substitutions of single characters - Levenshtein distance).
+    pos - position at which to start the search.
+    Returns position of the first character of the found substring, or SIZE_MAX if no such substring is found.
+    The match ends at the first position where the pattern fits within max_errors, extended while
+    the number of errors keeps decreasing. Its start is chosen to minimize the number of errors.
+    out_length, out_errors - optional, receive length of the found substring and its distance to the pattern.
+    Doesn't allocate memory for patterns up to 64 characters long.
+    */
+    inline size_t find_approx(const str_view_template<CharT, TraitsT>& pattern, size_t max_errors, size_t pos = 0,
+        size_t* out_length = nullptr, size_t* out_errors = nullptr) const;
+
+    /*
+    Returns number of occurrences of the character in the string.
+    If the length is not yet known, it is calculated in the same pass.
+    */
+    inline size_t count(CharT ch) const;
+    /*
+    Returns number of non-overlapping occurrences of the substring in the string, counted from the beginning.
+    If substr is empty, returns 0.
+    */
+    inline size_t count(const str_view_template<CharT, TraitsT>& substr) const;
+    /*
+    Returns number of lines - number of '\n' characters, plus one if the string doesn't end with '\n'.
+    Empty string has 0 lines. "\r\n" is also counted as a single line break.
+    If the length is not yet known, it is calculated in the same pass.
+    */
+    inline size_t count_lines() const;
+    /*
+    Returns number of words - maximal sequences of characters not equal to any of separators.
+    Without parameter, separators are ASCII whitespace characters: space, '\t', '\n', '\v', '\f', '\r'.
+    If the length is not yet known, it is calculated in the same pass.
+    */
+    inline size_t count_words() const;
+    inline size_t count_words(const str_view_template<CharT, TraitsT>& separators) const;
+
+    /*
+    Parallel versions of find, rfind, count for very large strings, e.g. memory-mapped files.
+    They split the string into chunks processed by multiple threads and return exactly the same
+    result as their serial counterparts.
+    thread_count - maximum number of threads to use, including the calling one. 0 means
+    std::thread::hardware_concurrency().
+    Strings shorter than STR_VIEW_PARALLEL_MIN_LENGTH characters are processed serially.
+    */
+    inline size_t parallel_find(CharT ch, size_t pos = 0, uint32_t thread_count = 0) const;
+    inline size_t parallel_find(const str_view_template<CharT, TraitsT>& substr, size_t pos = 0, uint32_t thread_count = 0) const;
+    inline size_t parallel_rfind(CharT ch, size_t pos = SIZE_MAX, uint32_t thread_count = 0) const;
+    inline size_t parallel_rfind(const str_view_template<CharT, TraitsT>& substr, size_t pos = SIZE_MAX, uint32_t thread_count = 0) const;
+    inline size_t parallel_count(CharT ch, uint32_t thread_count = 0) const;
+    inline size_t parallel_count(const str_view_template<CharT, TraitsT>& substr, uint32_t thread_count = 0) const;
+
+    /*
+    Finds the first character equal to any of the characters in the given character sequence. 
+    pos - position at which to start the search.
+    Returns position of the first occurrence of any character of the substring,
+    or SIZE_MAX if no such character is found.
+    If chars is empty, returns SIZE_MAX.
+    */
+    inline size_t find_first_of(const str_view_template<CharT, TraitsT>& chars, size_t pos = 0) const;
+    /*
+    Finds the last character equal to one of characters in the given character sequence.
+    The search considers only the interval [0; pos].
+    If the character is not present in the interval, SIZE_MAX will be returned.
+    If chars is empty, returns SIZE_MAX.
+    */
+    inline size_t find_last_of(const str_view_template<CharT, TraitsT>& chars, size_t pos = SIZE_MAX) const;
+    /*
+    Finds the first character NOT equal to any of the characters in the given character sequence. 
+    pos - position at which to start the search.
+    Returns position of the first occurrence of any character not of the substring,
+    or SIZE_MAX if no such character is found.
+    If chars is empty, returns SIZE_MAX.
+    */
+    inline size_t find_first_not_of(const str_view_template<CharT, TraitsT>& chars, size_t pos = 0) const;
+    /*
+    Finds the last character NOT equal to one of characters in the given character sequence.
+    The search considers only the interval [0; pos].
+    If the character is not present in the interval, SIZE_MAX will be returned.
+    If chars is empty, returns SIZE_MAX.
+    */
+    inline size_t find_last_not_of(const str_view_template<CharT, TraitsT>& chars, size_t pos = SIZE_MAX) const;
+
+    /*
+    Moves the start of the view forward by n characters. 
+    */
+    inline void remove_prefix(size_t n);
+    /*
+    Moves the end of the view back by n characters. 
+    */
+    inline void remove_suffix(size_t n);
+
+private:
+    /*
+    SIZE_MAX means unknown.
+    */
+    mutable size_t m_Length;
+    
+    const CharT* m_Begin;
+
+    /*
+    Null: a null-terminated copy not yet created.
+    Equal to m_Begin: the original string is null-terminated itself.
+    Any other value: A copy is created.
+    */
+    mutable const CharT* m_NullTerminatedPtr;
+
+    template<typename, typename> friend class str_view_template;
+
+    // Traits used by case-insensitive operations, selected at compile time.
+    typedef typename std::conditional<TraitsT::case_sensitive, simple_ci_traits<CharT>, TraitsT>::type FoldTraitsT;
+
+    // Case-insensitive comparison of count characters, including '\0'.
+    static inline int compare_ci(const CharT* lhs, const CharT* rhs, size_t count)
+    {
+        return str_view_detail::compare_folded<FoldTraitsT>(lhs, rhs, count);
+    }
+    inline bool equals(const str_view_template<CharT, TraitsT>& rhs) const;
+};
+
+typedef str_view_template<char> str_view;
+typedef str_view_template<wchar_t> wstr_view;
+typedef str_view_template<char, ascii_ci_traits<char>> ci_str_view;
+typedef str_view_template<wchar_t, ascii_ci_traits<wchar_t>> wci_str_view;
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template() :
+    m_Length(0),
+    m_Begin(nullptr),
+    m_NullTerminatedPtr(nullptr)
+{
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const CharT* sz) :
+    m_Length(sz ? SIZE_MAX : 0),
+    m_Begin(sz),
+    m_NullTerminatedPtr(sz ? sz : nullptr)
+{
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const CharT* str, size_t length) :
+    m_Length(length),
+    m_Begin(length ? str : nullptr),
+    m_NullTerminatedPtr(nullptr)
+{
+}
+
+template<typename CharT, typename TraitsT>
+template<size_t Length>
+inline str_view_template<CharT, TraitsT>::str_view_template(const CharT str[Length]) :
+    m_Length(Length),
+    m_Begin(str),
+    m_NullTerminatedPtr(nullptr)
+{
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const CharT* str, size_t length, StillNullTerminated) :
+    m_Length(length),
+    m_Begin(nullptr),
+    m_NullTerminatedPtr(nullptr)
+{
+    if(length)
+    {
+        m_Begin = str;
+        m_NullTerminatedPtr = str;
+    }
+    assert(!m_Begin || m_Begin[m_Length] == (CharT)0); // Make sure it's really null terminated.
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const StringT& str, size_t offset, size_t length) :
+    m_Length(0),
+    m_Begin(nullptr),
+    m_NullTerminatedPtr(nullptr)
+{
+    assert(offset <= str.length());
+    m_Length = std::min(length, str.length() - offset);
+    if(m_Length)
+    {
+        if(m_Length == str.length() - offset)
+        {
+            m_Begin = str.c_str() + offset;
+            m_NullTerminatedPtr = m_Begin;
+        }
+        else
+            m_Begin = str.data() + offset;
+    }
+}
+
+#if STR_VIEW_CPP17
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const StringViewT& str, size_t offset, size_t length) :
+    m_Length(0),
+    m_Begin(nullptr),
+    m_NullTerminatedPtr(nullptr)
+{
+    assert(offset <= str.length());
+    m_Length = std::min(length, str.length() - offset);
+    if(m_Length)
+        m_Begin = str.data() + offset;
+}
+
+#endif // #if STR_VIEW_CPP17
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const str_view_template<CharT, TraitsT>& src, size_t offset, size_t length) :
+    m_Length(0),
+    m_Begin(nullptr),
+    m_NullTerminatedPtr(nullptr)
+{
+    // Source length is unknown, constructor doesn't limit the length - it may remain unknown.
+    if(src.m_Length == SIZE_MAX && length == SIZE_MAX)
+    {
+        m_Length = SIZE_MAX;
+        m_Begin = src.m_Begin + offset;
+        assert(src.m_NullTerminatedPtr == src.m_Begin);
+        m_NullTerminatedPtr = m_Begin;
+    }
+    else
+    {
+        const size_t srcLen = src.length();
+        assert(offset <= srcLen);
+        m_Length = std::min(length, srcLen - offset);
+        if(m_Length)
+        {
+            m_Begin = src.m_Begin + offset;
+            if(src.m_NullTerminatedPtr == src.m_Begin && m_Length == srcLen - offset)
+                m_NullTerminatedPtr = m_Begin;
+        }
+    }
+}
+
+template<typename CharT, typename TraitsT>
+template<typename OtherTraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(const str_view_template<CharT, OtherTraitsT>& src) :
+    m_Length(src.m_Length),
+    m_Begin(src.m_Begin),
+    m_NullTerminatedPtr(src.m_NullTerminatedPtr == src.m_Begin ? src.m_Begin : nullptr)
+{
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::str_view_template(str_view_template<CharT, TraitsT>&& src) :
+    m_Length(src.m_Length),
+    m_Begin(src.m_Begin),
+    m_NullTerminatedPtr(src.m_NullTerminatedPtr)
+{
+    src.m_Length = 0;
+    src.m_Begin = nullptr;
+    src.m_NullTerminatedPtr = nullptr;
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>::~str_view_template()
+{
+    if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
+        delete[] m_NullTerminatedPtr;
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>& str_view_template<CharT, TraitsT>::operator=(const str_view_template<CharT, TraitsT>& src)
+{
+    if(&src != this)
+    {
+        if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
+            delete[] m_NullTerminatedPtr;
+        m_Begin = src.m_Begin;
+        m_Length = src.m_Length;
+        m_NullTerminatedPtr = src.m_NullTerminatedPtr == src.m_Begin ? m_Begin : nullptr;
+    }
+    return *this;
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT>& str_view_template<CharT, TraitsT>::operator=(str_view_template<CharT, TraitsT>&& src)
+{
+    if(&src != this)
+    {
+        if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
+            delete[] m_NullTerminatedPtr;
+        m_Begin = src.m_Begin;
+        m_Length = src.m_Length;
+        m_NullTerminatedPtr = src.m_NullTerminatedPtr;
+        src.m_Length = 0;
+        src.m_Begin = nullptr;
+        src.m_NullTerminatedPtr = nullptr;
+    }
+    return *this;
+}
+
+template<typename CharT, typename TraitsT>
+inline void str_view_template<CharT, TraitsT>::swap(str_view_template<CharT, TraitsT>& rhs) noexcept
+{
+    std::swap(m_Length, rhs.m_Length);
+    std::swap(m_Begin, rhs.m_Begin);
+    std::swap(m_NullTerminatedPtr, rhs.m_NullTerminatedPtr);
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::length() const
+{
+    if(m_Length == SIZE_MAX)
+    {
+        assert(m_NullTerminatedPtr == m_Begin);
+        m_Length = tstrlen(m_Begin);
+    }
+    return m_Length;
+}
+
+template<typename CharT, typename TraitsT>
+inline bool str_view_template<CharT, TraitsT>::empty() const
+{
+    if(m_Length == SIZE_MAX)
+    {
+        // Length is unknown. String is null-terminated.
+        // We still don't need to know the length. We just peek first character.
+        assert(m_NullTerminatedPtr == m_Begin);
+        return m_Begin == nullptr || *m_Begin == (CharT)0;
+    }
+    return m_Length == 0;
+}
+
+template<typename CharT, typename TraitsT>
+inline const CharT* str_view_template<CharT, TraitsT>::c_str() const
+{
+    static const CharT nullChar = (CharT)0;
+    if(empty())
+        return &nullChar;
+    if(m_NullTerminatedPtr == m_Begin)
+    {
+        //assert(m_Begin[length()] == (CharT)0); // Make sure it's really null terminated.
+        return m_Begin;
+    }
+    if(m_NullTerminatedPtr == nullptr)
+    {
+        // Not null terminated, so length must be known.
+        assert(m_Length != SIZE_MAX);
+        CharT* nullTerminated = new CharT[m_Length + 1];
+        memcpy(nullTerminated, begin(), m_Length * sizeof(CharT));
+        nullTerminated[m_Length] = (CharT)0;
+        m_NullTerminatedPtr = nullTerminated;
+    }
+    return m_NullTerminatedPtr;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::copy_to(CharT* dst, size_t offset, size_t length) const
+{
+    const size_t thisLen = this->length();
+    assert(offset <= thisLen);
+    length = std::min(length, thisLen - offset);
+    memcpy(dst, m_Begin + offset, length * sizeof(CharT));
+    return length;
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT> str_view_template<CharT, TraitsT>::to_lower_into(CharT* dst) const
+{
+    const size_t len = length();
+    str_view_detail::ascii_convert_case(m_Begin, len, dst, false);
+    if(dst != m_Begin)
+        dst[len] = (CharT)0;
+    else if(!is_null_terminated())
+        return str_view_template<CharT, TraitsT>(dst, len);
+    return str_view_template<CharT, TraitsT>(dst, len, StillNullTerminated());
+}
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT> str_view_template<CharT, TraitsT>::to_upper_into(CharT* dst) const
+{
+    const size_t len = length();
+    str_view_detail::ascii_convert_case(m_Begin, len, dst, true);
+    if(dst != m_Begin)
+        dst[len] = (CharT)0;
+    else if(!is_null_terminated())
+        return str_view_template<CharT, TraitsT>(dst, len);
+    return str_view_template<CharT, TraitsT>(dst, len, StillNullTerminated());
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::hash(bool case_sensitive) const
+{
+    const size_t len = length();
+    if(case_sensitive)
+        return (size_t)str_view_detail::hash_bytes(m_Begin, len * sizeof(CharT), 0);
+    return (size_t)str_view_detail::hash_bytes(m_Begin, len * sizeof(CharT), 0, FoldTraitsT::fold_block);
+}
+
+template<typename CharT, typename TraitsT>
+inline void str_view_template<CharT, TraitsT>::to_string(StringT& dst, size_t offset, size_t length) const
+{
+    const size_t thisLen = this->length();
+    assert(offset <= thisLen);
+    length = std::min(length, thisLen - offset);
+    dst.assign(m_Begin + offset, m_Begin + (offset + length));
+}
+
+template<typename CharT, typename TraitsT>
+inline typename str_view_template<CharT, TraitsT>::StringT str_view_template<CharT, TraitsT>::to_string(size_t offset, size_t length) const
+{
+    const size_t thisLen = this->length();
+    assert(offset <= thisLen);
+    length = std::min(length, thisLen - offset);
+    return StringT(m_Begin + offset, m_Begin + (offset + length));
+}
+
+#if STR_VIEW_CPP17
+
+template<typename CharT, typename TraitsT>
+inline void str_view_template<CharT, TraitsT>::to_string_view(StringViewT& dst, size_t offset, size_t length) const
+{
+    const size_t thisLen = this->length();
+    assert(offset <= thisLen);
+    length = std::min(length, thisLen - offset);
+    dst = StringViewT(m_Begin + offset, length);
+}
+
+template<typename CharT, typename TraitsT>
+inline typename str_view_template<CharT, TraitsT>::StringViewT str_view_template<CharT, TraitsT>::to_string_view(size_t offset, size_t length) const
+{
+    const size_t thisLen = this->length();
+    assert(offset <= thisLen);
+    length = std::min(length, thisLen - offset);
+    return StringViewT(m_Begin + offset, length);
+}
+
+#endif // #if STR_VIEW_CPP17
+
+template<typename CharT, typename TraitsT>
+inline str_view_template<CharT, TraitsT> str_view_template<CharT, TraitsT>::substr(size_t offset, size_t length) const
+{
+    // Length can remain unknown.
+    if(m_Length == SIZE_MAX && length == SIZE_MAX)
+    {
+        assert(m_NullTerminatedPtr == m_Begin);
+        return str_view_template<CharT, TraitsT>(m_Begin + offset);
+    }
+
+    const size_t thisLen = this->length();
+    assert(offset <= thisLen);
+    length = std::min(length, thisLen - offset);
+    // Result will be null-terminated.
+    if(m_NullTerminatedPtr == m_Begin && length == thisLen - offset)
+        return str_view_template<CharT, TraitsT>(m_Begin + offset, length, StillNullTerminated());
+    // Result will not be null-terminated.
+    return str_view_template<CharT, TraitsT>(m_Begin + offset, length);
+}
+
+template<typename CharT, typename TraitsT>
+inline int str_view_template<CharT, TraitsT>::compare(const str_view_template<CharT, TraitsT>& rhs, bool case_sensitive) const
+{
+    const size_t lhsLen = length();
+    const size_t rhsLen = rhs.length();
+    const size_t minLen = std::min(lhsLen, rhsLen);
+
+    if(case_sensitive)
+        return str_view_detail::compare_chars(m_Begin, lhsLen, rhs.m_Begin, rhsLen);
+
+    if(minLen > 0)
+    {
+        const int result = compare_ci(m_Begin, rhs.m_Begin, minLen);
+        if(result != 0)
+            return result;
+    }
+
+    if(lhsLen < rhsLen)
+        return -1;
+    if(lhsLen > rhsLen)
+        return 1;
+    return 0;
+}
+
+template<typename CharT, typename TraitsT>
+inline int str_view_template<CharT, TraitsT>::compare_until_null(const str_view_template<CharT, TraitsT>& rhs, bool case_sensitive) const
+{
+    const size_t lhsLen = length();
+    const size_t rhsLen = rhs.length();
+    const size_t minLen = std::min(lhsLen, rhsLen);
+
+    if(minLen > 0)
+    {
+        const int result = case_sensitive ?
+            tstrncmp(m_Begin, rhs.m_Begin, minLen) :
+            tstrnicmp(m_Begin, rhs.m_Begin, minLen);
+        if(result != 0)
+            return result;
+    }
+
+    if(lhsLen < rhsLen)
+        return -1;
+    if(lhsLen > rhsLen)
+        return 1;
+    return 0;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::common_prefix_length(const str_view_template<CharT, TraitsT>& rhs) const
+{
+    const size_t minLen = std::min(length(), rhs.length());
+    return minLen ? str_view_detail::mismatch(m_Begin, rhs.m_Begin, minLen) : 0;
+}
+
+template<typename CharT, typename TraitsT>
+inline bool str_view_template<CharT, TraitsT>::equals(const str_view_template<CharT, TraitsT>& rhs) const
+{
+    const size_t len = length();
+    if(len != rhs.length())
+        return false;
+    if(len == 0 || m_Begin == rhs.m_Begin)
+        return true;
+    return TraitsT::case_sensitive ?
+        str_view_detail::mismatch(m_Begin, rhs.m_Begin, len) == len :
+        compare_ci(m_Begin, rhs.m_Begin, len) == 0;
+}
+
+template<typename CharT, typename TraitsT>
+inline bool str_view_template<CharT, TraitsT>::starts_with(CharT prefix, bool case_sensitive) const
+{
+    if(!empty())
+    {
+        if(case_sensitive)
+            return *m_Begin == prefix;
+        return compare_ci(m_Begin, &prefix, 1) == 0;
+    }
+    return false;
+}
+
+template<typename CharT, typename TraitsT>
+inline bool str_view_template<CharT, TraitsT>::starts_with(const str_view_template<CharT, TraitsT>& prefix, bool case_sensitive) const
+{
+    const size_t prefixLen = prefix.length();
+    if(length() >= prefixLen)
+    {
+        if(case_sensitive)
+            return str_view_detail::mismatch(m_Begin, prefix.m_Begin, prefixLen) == prefixLen;
+        return compare_ci(m_Begin, prefix.m_Begin, prefixLen) == 0;
+    }
+    return false;
+}
+
+template<typename CharT, typename TraitsT>
+inline bool str_view_template<CharT, TraitsT>::ends_with(CharT suffix, bool case_sensitive) const
+{
+    const size_t thisLen = length();
+    if(thisLen > 0)
+    {
+        if(case_sensitive)
+            return m_Begin[thisLen - 1] == suffix;
+        return compare_ci(m_Begin + (thisLen - 1), &suffix, 1) == 0;
+    }
+    return false;
+}
+
+template<typename CharT, typename TraitsT>
+inline bool str_view_template<CharT, TraitsT>::ends_with(const str_view_template<CharT, TraitsT>& suffix, bool case_sensitive) const
+{
+    const size_t thisLen = length();
+    const size_t suffixLen = suffix.length();
+    if(thisLen >= suffixLen)
+    {
+        if(case_sensitive)
+            return str_view_detail::mismatch(m_Begin + (thisLen - suffixLen), suffix.m_Begin, suffixLen) == suffixLen;
+        return compare_ci(m_Begin + (thisLen - suffixLen), suffix.m_Begin, suffixLen) == 0;
+    }
+    return false;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find(CharT ch, size_t pos, bool case_sensitive) const
+{
+    const size_t thisLen = length();
+    if(pos >= thisLen)
+        return SIZE_MAX;
+    const size_t index = case_sensitive ?
+        str_view_detail::find_char(m_Begin + pos, thisLen - pos, ch) :
+        str_view_detail::find_folded<FoldTraitsT>(m_Begin + pos, thisLen - pos, &ch, 1);
+    return index != SIZE_MAX ? pos + index : SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find(const str_view_template<CharT, TraitsT>& substr, size_t pos, bool case_sensitive) const
+{
+    const size_t subLen = substr.length();
+    if(subLen == 0)
+        return pos;
+    const size_t thisLen = length();
+    if(thisLen < subLen)
+        return SIZE_MAX;
+    if(pos > thisLen - subLen)
+        return SIZE_MAX;
+    const size_t index = case_sensitive ?
+        str_view_detail::find_substr(m_Begin + pos, thisLen - pos, substr.m_Begin, subLen) :
+        str_view_detail::find_folded<FoldTraitsT>(m_Begin + pos, thisLen - pos, substr.m_Begin, subLen);
+    return index != SIZE_MAX ? pos + index : SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::rfind(CharT ch, size_t pos, bool case_sensitive) const
+{
+    const size_t thisLen = length();
+    if(thisLen == 0)
+        return SIZE_MAX;
+    const size_t searchLen = std::min(pos, thisLen - 1) + 1;
+    if(case_sensitive)
+        return str_view_detail::rfind_char(m_Begin, searchLen, ch);
+    return str_view_detail::rfind_folded<FoldTraitsT>(m_Begin, searchLen, &ch, 1);
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::rfind(const str_view_template<CharT, TraitsT>& substr, size_t pos, bool case_sensitive) const
+{
+    const size_t subLen = substr.length();
+    if(subLen == 0)
+        return pos;
+    const size_t thisLen = length();
+    if(thisLen < subLen)
+        return SIZE_MAX;
+    // Occurrence may start at most at pos, so it ends before searchLen.
+    const size_t searchLen = std::min(pos, thisLen - subLen) + subLen;
+    if(!case_sensitive)
+        return str_view_detail::rfind_folded<FoldTraitsT>(m_Begin, searchLen, substr.m_Begin, subLen);
+    for(size_t i = searchLen - subLen + 1; i--; )
+    {
+        if(memcmp(m_Begin + i, substr.m_Begin, subLen * sizeof(CharT)) == 0)
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find_approx(const str_view_template<CharT, TraitsT>& pattern, size_t max_errors, size_t pos,
+    size_t* out_length, size_t* out_errors) const
+{
+    const size_t thisLen = length();
+    if(pos > thisLen)
+        return SIZE_MAX;
+    const size_t patternLen = pattern.length();
+    if(patternLen == 0)
+    {
+        if(out_length)
+            *out_length = 0;
+        if(out_errors)
+            *out_errors = 0;
+        return pos;
+    }
+
+    // Forward pass: the row 0 is all zeros, so a match can start anywhere.
+    const str_view_detail::myers_pattern<CharT> forwardPattern(pattern.m_Begin, patternLen, false);
+    str_view_detail::myers_state forwardState(forwardPattern.word_count());
+    size_t errors = patternLen;
+    size_t end = pos;
+    while(errors > max_errors && end < thisLen)
+        errors += forwardState.advance(forwardPattern, m_Begin[end++], 0);
+    if(errors > max_errors)
+        return SIZE_MAX;
+    while(errors > 0 && end < thisLen && forwardState.advance(forwardPattern, m_Begin[end], 0) < 0)
+    {
+        --errors;
+        ++end;
+    }
+
+    // Backward pass from the end with reversed pattern finds the start. The match is not longer than patternLen + errors.
+    const size_t windowLen = std::min(end - pos, patternLen + errors);
+    const str_view_detail::myers_pattern<CharT> backwardPattern(pattern.m_Begin, patternLen, true);
+    str_view_detail::myers_state backwardState(backwardPattern.word_count());
+    size_t score = patternLen;
+    size_t bestScore = patternLen, bestLen = 0;
+    for(size_t len = 1; len <= windowLen && bestScore > errors; ++len)
+    {
+        score += backwardState.advance(backwardPattern, m_Begin[end - len], 1);
+        if(score < bestScore)
+        {
+            bestScore = score;
+            bestLen = len;
+        }
+    }
+    assert(bestScore == errors);
+
+    if(out_length)
+        *out_length = bestLen;
+    if(out_errors)
+        *out_errors = bestScore;
+    return end - bestLen;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::count(CharT ch) const
+{
+    if(!TraitsT::case_sensitive)
+        return count(str_view_template<CharT, TraitsT>(&ch, 1));
+    if(m_Length == SIZE_MAX && ch != (CharT)0)
+    {
+        assert(m_NullTerminatedPtr == m_Begin);
+        return str_view_detail::count_char_sz(m_Begin, ch, &m_Length);
+    }
+    return str_view_detail::count_char(m_Begin, length(), ch);
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::count(const str_view_template<CharT, TraitsT>& substr) const
+{
+    const size_t subLen = substr.length();
+    if(subLen == 0)
+        return 0;
+    const size_t thisLen = length();
+    size_t result = 0;
+    for(size_t pos = 0; thisLen - pos >= subLen; ++result)
+    {
+        const size_t index = find(substr, pos);
+        if(index == SIZE_MAX)
+            break;
+        pos = index + subLen;
+    }
+    return result;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::count_lines() const
+{
+    const size_t lineBreakCount = count((CharT)'\n');
+    const size_t thisLen = length();
+    return thisLen > 0 && m_Begin[thisLen - 1] != (CharT)'\n' ? lineBreakCount + 1 : lineBreakCount;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::count_words() const
+{
+    const CharT separators[] = { (CharT)' ', (CharT)'\t', (CharT)'\n', (CharT)'\v', (CharT)'\f', (CharT)'\r' };
+    return count_words(str_view_template<CharT, TraitsT>(separators, sizeof(separators) / sizeof(separators[0])));
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::count_words(const str_view_template<CharT, TraitsT>& separators) const
+{
+    const size_t separatorCount = separators.length();
+    if(m_Length == SIZE_MAX &&
+        std::find(separators.m_Begin, separators.m_Begin + separatorCount, (CharT)0) == separators.m_Begin + separatorCount)
+    {
+        assert(m_NullTerminatedPtr == m_Begin);
+        return str_view_detail::count_words_sz(m_Begin, separators.m_Begin, separatorCount, &m_Length);
+    }
+    return str_view_detail::count_words(m_Begin, length(), separators.m_Begin, separatorCount);
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::parallel_find(CharT ch, size_t pos, uint32_t thread_count) const
+{
+    const size_t thisLen = length();
+    if(pos >= thisLen || thisLen - pos < STR_VIEW_PARALLEL_MIN_LENGTH || thread_count == 1)
+        return find(ch, pos);
+    const size_t index = str_view_detail::parallel_search(thisLen - pos, false, thread_count,
+        [&](size_t begin, size_t count) { return str_view_template<CharT, TraitsT>(m_Begin + pos + begin, count).find(ch); });
+    return index != SIZE_MAX ? pos + index : SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::parallel_find(const str_view_template<CharT, TraitsT>& substr, size_t pos, uint32_t thread_count) const
+{
+    const size_t subLen = substr.length();
+    const size_t thisLen = length();
+    if(subLen == 0 || thisLen < subLen || pos > thisLen - subLen ||
+        thisLen - pos < STR_VIEW_PARALLEL_MIN_LENGTH || thread_count == 1)
+    {
+        return find(substr, pos);
+    }
+    // Chunks are ranges of starting positions. Matches can extend past the end of a chunk.
+    const size_t index = str_view_detail::parallel_search(thisLen - subLen + 1 - pos, false, thread_count,
+        [&](size_t begin, size_t count)
+        {
+            return str_view_template<CharT, TraitsT>(m_Begin + pos + begin, count + subLen - 1).find(substr);
+        });
+    return index != SIZE_MAX ? pos + index : SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::parallel_rfind(CharT ch, size_t pos, uint32_t thread_count) const
+{
+    const size_t thisLen = length();
+    if(thisLen < STR_VIEW_PARALLEL_MIN_LENGTH || pos < STR_VIEW_PARALLEL_MIN_LENGTH || thread_count == 1)
+        return rfind(ch, pos);
+    return str_view_detail::parallel_search(std::min(pos, thisLen - 1) + 1, true, thread_count,
+        [&](size_t begin, size_t count) { return str_view_template<CharT, TraitsT>(m_Begin + begin, count).rfind(ch); });
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::parallel_rfind(const str_view_template<CharT, TraitsT>& substr, size_t pos, uint32_t thread_count) const
+{
+    const size_t subLen = substr.length();
+    const size_t thisLen = length();
+    if(subLen == 0 || thisLen < subLen || thisLen < STR_VIEW_PARALLEL_MIN_LENGTH ||
+        pos < STR_VIEW_PARALLEL_MIN_LENGTH || thread_count == 1)
+    {
+        return rfind(substr, pos);
+    }
+    return str_view_detail::parallel_search(std::min(pos, thisLen - subLen) + 1, true, thread_count,
+        [&](size_t begin, size_t count)
+        {
+            return str_view_template<CharT, TraitsT>(m_Begin + begin, count + subLen - 1).rfind(substr);
+        });
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::parallel_count(CharT ch, uint32_t thread_count) const
+{
+    const size_t thisLen = length();
+    if(thisLen < STR_VIEW_PARALLEL_MIN_LENGTH || thread_count == 1)
+        return count(ch);
+    const size_t chunkLen = str_view_detail::PARALLEL_CHUNK_LENGTH;
+    std::atomic<size_t> result(0);
+    str_view_detail::parallel_for_chunks((thisLen + chunkLen - 1) / chunkLen, thread_count, [&](size_t chunkIndex)
+    {
+        const size_t chunkBegin = chunkIndex * chunkLen;
+        result += str_view_template<CharT, TraitsT>(m_Begin + chunkBegin, std::min(chunkLen, thisLen - chunkBegin)).count(ch);
+    });
+    return result.load();
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::parallel_count(const str_view_template<CharT, TraitsT>& substr, uint32_t thread_count) const
+{
+    const size_t subLen = substr.length();
+    const size_t thisLen = length();
+    if(subLen == 0 || thisLen < subLen || thisLen < STR_VIEW_PARALLEL_MIN_LENGTH || thread_count == 1)
+        return count(substr);
+
+    // Chunks are ranges of starting positions. Each one is counted as if no match from the
+    // previous chunk extended into it. Then the chunks are fixed up serially.
+    const size_t chunkLen = str_view_detail::PARALLEL_CHUNK_LENGTH;
+    const size_t startCount = thisLen - subLen + 1;
+    const size_t chunkCount = (startCount + chunkLen - 1) / chunkLen;
+    // Returns position of the first match starting in [from, chunkEnd), or SIZE_MAX.
+    const auto nextMatch = [&](size_t from, size_t chunkEnd) -> size_t
+    {
+        if(from >= chunkEnd)
+            return SIZE_MAX;
+        const size_t index = str_view_template<CharT, TraitsT>(m_Begin + from, chunkEnd - from + subLen - 1).find(substr);
+        return index != SIZE_MAX ? from + index : SIZE_MAX;
+    };
+    struct ChunkResult
+    {
+        size_t count;
+        size_t lastMatchEnd; // 0 if there is no match.
+    };
+    std::vector<ChunkResult> chunkResults(chunkCount);
+    str_view_detail::parallel_for_chunks(chunkCount, thread_count, [&](size_t chunkIndex)
+    {
+        const size_t chunkBegin = chunkIndex * chunkLen;
+        const size_t chunkEnd = std::min(chunkBegin + chunkLen, startCount);
+        ChunkResult chunkResult = { 0, 0 };
+        for(size_t match = nextMatch(chunkBegin, chunkEnd); match != SIZE_MAX; match = nextMatch(match + subLen, chunkEnd))
+        {
+            ++chunkResult.count;
+            chunkResult.lastMatchEnd = match + subLen;
+        }
+        chunkResults[chunkIndex] = chunkResult;
+    });
+
+    size_t result = chunkResults[0].count;
+    // End of the last real match in all previous chunks. A long match can extend over many chunks.
+    size_t prevMatchEnd = chunkResults[0].lastMatchEnd;
+    for(size_t chunkIndex = 1; chunkIndex < chunkCount; ++chunkIndex)
+    {
+        const size_t chunkBegin = chunkIndex * chunkLen;
+        const size_t chunkEnd = std::min(chunkBegin + chunkLen, startCount);
+        ChunkResult& chunkResult = chunkResults[chunkIndex];
+        if(prevMatchEnd > chunkBegin)
+        {
+            // Walk matches found from chunkBegin (a) and from the real start (b) until they meet.
+            // From then on both sequences are the same.
+            size_t a = nextMatch(chunkBegin, chunkEnd), b = nextMatch(prevMatchEnd, chunkEnd);
+            size_t countA = 0, countB = 0, lastMatchEndB = 0;
+            while(a != b)
+            {
+                if(a < b)
+                {
+                    ++countA;
+                    a = nextMatch(a + subLen, chunkEnd);
+                }
+                else
+                {
+                    ++countB;
+                    lastMatchEndB = b + subLen;
+                    b = nextMatch(b + subLen, chunkEnd);
+                }
+            }
+            chunkResult.count = chunkResult.count + countB - countA;
+            if(a == SIZE_MAX)
+                chunkResult.lastMatchEnd = lastMatchEndB;
+        }
+        prevMatchEnd = std::max(prevMatchEnd, chunkResult.lastMatchEnd);
+        result += chunkResult.count;
+    }
+    return result;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find_first_of(const str_view_template<CharT, TraitsT>& chars, size_t pos) const
+{
+    const size_t charsLen = chars.length();
+    if(charsLen == 0)
+        return SIZE_MAX;
+    const size_t thisLen = length();
+    for(size_t thisIndex = pos; thisIndex < thisLen; ++thisIndex)
+    {
+        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        {
+            if(TraitsT::fold(m_Begin[thisIndex]) == TraitsT::fold(chars.m_Begin[charsIndex]))
+                return thisIndex;
+        }
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find_last_of(const str_view_template<CharT, TraitsT>& chars, size_t pos) const
+{
+    const size_t charsLen = chars.length();
+    if(charsLen == 0)
+        return SIZE_MAX;
+    const size_t thisLen = length();
+    if(thisLen == 0)
+        return SIZE_MAX;
+    for(size_t thisIndex = std::min(pos, thisLen - 1) + 1; thisIndex--; )
+    {
+        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        {
+            if(TraitsT::fold(m_Begin[thisIndex]) == TraitsT::fold(chars.m_Begin[charsIndex]))
+                return thisIndex;
+        }
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find_first_not_of(const str_view_template<CharT, TraitsT>& chars, size_t pos) const
+{
+    const size_t charsLen = chars.length();
+    if(charsLen == 0)
+        return SIZE_MAX;
+    const size_t thisLen = length();
+    for(size_t thisIndex = pos; thisIndex < thisLen; ++thisIndex)
+    {
+        bool found = false;
+        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        {
+            if(TraitsT::fold(m_Begin[thisIndex]) == TraitsT::fold(chars.m_Begin[charsIndex]))
+            {
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+            return thisIndex;
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t str_view_template<CharT, TraitsT>::find_last_not_of(const str_view_template<CharT, TraitsT>& chars, size_t pos) const
+{
+    const size_t charsLen = chars.length();
+    if(charsLen == 0)
+        return SIZE_MAX;
+    const size_t thisLen = length();
+    if(thisLen == 0)
+        return SIZE_MAX;
+    for(size_t thisIndex = std::min(pos, thisLen - 1) + 1; thisIndex--; )
+    {
+        bool found = false;
+        for(size_t charsIndex = 0; charsIndex < charsLen; ++charsIndex)
+        {
+            if(TraitsT::fold(m_Begin[thisIndex]) == TraitsT::fold(chars.m_Begin[charsIndex]))
+            {
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+            return thisIndex;
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline void str_view_template<CharT, TraitsT>::remove_prefix(size_t n)
+{
+    if(n == 0)
+        return;
+    if(m_Length != SIZE_MAX)
+    {
+        assert(n <= m_Length);
+        if(n < m_Length)
+        {
+            if(m_NullTerminatedPtr)
+            {
+                if(m_NullTerminatedPtr == m_Begin)
+                    m_NullTerminatedPtr += n;
+                else
+                {
+                    delete[] m_NullTerminatedPtr;
+                    m_NullTerminatedPtr = nullptr;
+                }
+            }
+            m_Length -= n;
+            m_Begin += n;
+        }
+        else
+        {
+            // String becomes empty.
+            if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
+                delete[] m_NullTerminatedPtr;
+            m_NullTerminatedPtr = nullptr;
+            m_Length = 0;
+            m_Begin = nullptr;
+        }
+    }
+    else
+    {
+        assert(m_NullTerminatedPtr == m_Begin);
+        m_Begin += n;
+        m_NullTerminatedPtr += n;
+    }
+}
+
+template<typename CharT, typename TraitsT>
+inline void str_view_template<CharT, TraitsT>::remove_suffix(size_t n)
+{
+    if(n == 0)
+        return;
+    if(m_Length != SIZE_MAX)
+    {
+        assert(n <= m_Length);
+        if(n < m_Length)
+        {
+            // No longer null terminated.
+            if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
+                delete[] m_NullTerminatedPtr;
+            m_NullTerminatedPtr = nullptr;
+            m_Length -= n;
         }
         else
         {
@@ -909,49 +4061,4956 @@ inline void str_view_template<CharT>::remove_prefix(size_t n)
     }
     else
     {
-        assert(m_NullTerminatedPtr == m_Begin);
-        m_Begin += n;
-        m_NullTerminatedPtr += n;
+        assert(m_NullTerminatedPtr == m_Begin);
+        // No longer null terminated.
+        m_Length = length() - n;
+        m_NullTerminatedPtr = nullptr;
+    }
+}
+
+template<typename CharT, typename TraitsT>
+inline void swap(str_view_template<CharT, TraitsT>& lhs, str_view_template<CharT, TraitsT>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+/*
+Function objects for hash containers, e.g.
+std::unordered_map<str_view, int, str_view_ci_hash, str_view_ci_equal>.
+Case-insensitive ones fold only ASCII letters, consistently with each other, and compare whole views,
+including any null characters inside.
+With a case-insensitive view type as the key, str_view_hash_template uses its traits, so the default
+std::equal_to is enough: std::unordered_map<ci_str_view, int, ci_str_view_hash>.
+*/
+template<typename CharT, typename TraitsT = str_view_traits<CharT>>
+struct str_view_hash_template
+{
+    size_t operator()(const str_view_template<CharT, TraitsT>& str) const { return str.hash(); }
+};
+template<typename CharT>
+struct str_view_ci_hash_template
+{
+    size_t operator()(const str_view_template<CharT>& str) const { return str.hash(false); }
+};
+template<typename CharT>
+struct str_view_ci_equal_template
+{
+    bool operator()(const str_view_template<CharT>& lhs, const str_view_template<CharT>& rhs) const
+    {
+        return lhs.length() == rhs.length() && lhs.compare(rhs, false) == 0;
+    }
+};
+
+typedef str_view_hash_template<char> str_view_hash;
+typedef str_view_hash_template<wchar_t> wstr_view_hash;
+typedef str_view_hash_template<char, ascii_ci_traits<char>> ci_str_view_hash;
+typedef str_view_hash_template<wchar_t, ascii_ci_traits<wchar_t>> wci_str_view_hash;
+typedef str_view_ci_hash_template<char> str_view_ci_hash;
+typedef str_view_ci_hash_template<wchar_t> wstr_view_ci_hash;
+typedef str_view_ci_equal_template<char> str_view_ci_equal;
+typedef str_view_ci_equal_template<wchar_t> wstr_view_ci_equal;
+
+/*
+Returns Levenshtein distance between two strings - minimum number of insertions, deletions and
+substitutions of single characters needed to turn one into the other.
+If the distance exceeds max_distance, returns SIZE_MAX. The computation then stops as soon as
+it is known that the bound cannot be met.
+Uses Myers' bit-parallel algorithm. Doesn't allocate memory if the shorter string has up to 64 characters.
+*/
+template<typename CharT>
+inline size_t edit_distance(const str_view_template<CharT>& lhs, const str_view_template<CharT>& rhs, size_t max_distance = SIZE_MAX)
+{
+    const str_view_template<CharT>& pattern = lhs.length() <= rhs.length() ? lhs : rhs;
+    const str_view_template<CharT>& text = lhs.length() <= rhs.length() ? rhs : lhs;
+    const size_t patternLen = pattern.length();
+    const size_t textLen = text.length();
+    // Distance is at least the difference in lengths.
+    if(textLen - patternLen > max_distance)
+        return SIZE_MAX;
+    if(patternLen == 0)
+        return textLen;
+    const str_view_detail::myers_pattern<CharT> myersPattern(pattern.data(), patternLen, false);
+    return str_view_detail::myers_distance(myersPattern, patternLen, text.data(), textLen, max_distance);
+}
+
+/*
+Static dictionary that maps a fixed set of keys to dense indices [0, size()), built using
+minimal perfect hashing (hash and displace). Lookup computes a single hash, reads one
+displacement value and verifies the candidate key, so keys outside of the set are rejected.
+Lookups don't allocate memory.
+
+All the data, including copies of the keys, is stored in a single flat image. The image can
+be saved to a file and later attached from memory, e.g. from a memory-mapped file, with no
+rebuilding. The image uses native byte order and sizeof(CharT), so it is not portable between
+platforms that differ in these.
+*/
+template<typename CharT>
+class perfect_hash_dictionary_template
+{
+public:
+    inline perfect_hash_dictionary_template();
+
+    /*
+    Builds the dictionary from given keys. Previous contents are discarded.
+    Keys are copied, so they don't need to remain alive after the call.
+    Returns false if keys contain duplicates or there are too many of them.
+    */
+    inline bool build(const str_view_template<CharT>* keys, size_t keyCount);
+    /*
+    Starts using an existing image, e.g. from a memory-mapped file, without copying it.
+    The memory must be aligned to 8 bytes and remain alive and unchanged as long as this object uses it.
+    Returns false if the image is invalid.
+    */
+    inline bool attach(const void* image, size_t imageSize);
+
+    /*
+    Returns the image that can be saved to a file.
+    It is valid until the object is destroyed or modified.
+    */
+    inline const void* image() const { return m_Image; }
+    inline size_t image_size() const { return m_ImageSize; }
+
+    // Returns the number of keys.
+    inline size_t size() const { return m_KeyCount; }
+    inline bool empty() const { return m_KeyCount == 0; }
+
+    /*
+    Returns index of the key in range [0, size()), or SIZE_MAX if the key is not in the dictionary.
+    */
+    inline size_t find(const str_view_template<CharT>& key) const;
+    inline bool contains(const str_view_template<CharT>& key) const { return find(key) != SIZE_MAX; }
+    /*
+    Returns the key stored under given index.
+    Returned view points into the image and is null-terminated, so its c_str() doesn't allocate.
+    */
+    inline str_view_template<CharT> key(size_t index) const;
+
+private:
+    static const uint32_t IMAGE_MAGIC = 0x48505653; // "SVPH"
+    static const uint32_t IMAGE_VERSION = 1;
+    // Set in a pilot value for bucket with single key, which then stores the slot directly.
+    static const uint32_t DIRECT_SLOT_BIT = 0x80000000u;
+
+    struct ImageHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t charSize;
+        uint32_t keyCount;
+        uint32_t bucketCount;
+        uint32_t reserved;
+        uint64_t seed;
+        uint64_t charCount;
+    };
+
+    // Owned image, if the dictionary was built rather than attached.
+    std::vector<uint64_t> m_Storage;
+    const void* m_Image;
+    size_t m_ImageSize;
+    uint32_t m_KeyCount;
+    uint32_t m_BucketCount;
+    uint64_t m_Seed;
+    const uint32_t* m_Pilots;
+    // keyCount + 1 elements. Key i spans characters [m_Offsets[i], m_Offsets[i + 1] - 1), followed by null.
+    const uint64_t* m_Offsets;
+    const CharT* m_Chars;
+
+    perfect_hash_dictionary_template(const perfect_hash_dictionary_template<CharT>&) = delete;
+    perfect_hash_dictionary_template<CharT>& operator=(const perfect_hash_dictionary_template<CharT>&) = delete;
+
+    static size_t align8(size_t size) { return (size + 7) & ~(size_t)7; }
+    inline uint32_t slot_for(uint64_t hash, uint32_t pilot) const
+    {
+        if(pilot & DIRECT_SLOT_BIT)
+            return pilot & ~DIRECT_SLOT_BIT;
+        return str_view_detail::fast_range32(
+            (uint32_t)(str_view_detail::mix64(hash ^ (pilot * 0x9E3779B97F4A7C15ull)) >> 32), m_KeyCount);
+    }
+    inline uint64_t hash_key(const str_view_template<CharT>& key, size_t keyLen) const
+    {
+        return str_view_detail::hash_bytes(keyLen ? key.data() : nullptr, keyLen * sizeof(CharT), m_Seed);
+    }
+    inline void reset();
+    inline bool setup_pointers(uint32_t keyCount, uint32_t bucketCount, uint64_t charCount);
+};
+
+typedef perfect_hash_dictionary_template<char> perfect_hash_dictionary;
+typedef perfect_hash_dictionary_template<wchar_t> wperfect_hash_dictionary;
+
+template<typename CharT>
+inline perfect_hash_dictionary_template<CharT>::perfect_hash_dictionary_template() :
+    m_Image(nullptr),
+    m_ImageSize(0),
+    m_KeyCount(0),
+    m_BucketCount(0),
+    m_Seed(0),
+    m_Pilots(nullptr),
+    m_Offsets(nullptr),
+    m_Chars(nullptr)
+{
+}
+
+template<typename CharT>
+inline void perfect_hash_dictionary_template<CharT>::reset()
+{
+    m_Storage.clear();
+    m_Image = nullptr;
+    m_ImageSize = 0;
+    m_KeyCount = 0;
+    m_BucketCount = 0;
+    m_Seed = 0;
+    m_Pilots = nullptr;
+    m_Offsets = nullptr;
+    m_Chars = nullptr;
+}
+
+template<typename CharT>
+inline bool perfect_hash_dictionary_template<CharT>::setup_pointers(uint32_t keyCount, uint32_t bucketCount, uint64_t charCount)
+{
+    const size_t pilotsOffset = sizeof(ImageHeader);
+    const size_t offsetsOffset = pilotsOffset + align8(bucketCount * sizeof(uint32_t));
+    const size_t charsOffset = offsetsOffset + ((size_t)keyCount + 1) * sizeof(uint64_t);
+    if(charsOffset > m_ImageSize || (m_ImageSize - charsOffset) / sizeof(CharT) < charCount)
+        return false;
+    const char* const bytes = (const char*)m_Image;
+    m_KeyCount = keyCount;
+    m_BucketCount = bucketCount;
+    m_Pilots = (const uint32_t*)(bytes + pilotsOffset);
+    m_Offsets = (const uint64_t*)(bytes + offsetsOffset);
+    m_Chars = (const CharT*)(bytes + charsOffset);
+    return true;
+}
+
+template<typename CharT>
+inline bool perfect_hash_dictionary_template<CharT>::build(const str_view_template<CharT>* keys, size_t keyCount)
+{
+    reset();
+    if(keyCount >= DIRECT_SLOT_BIT)
+        return false;
+    const uint32_t n = (uint32_t)keyCount;
+    // Average of 4 keys per bucket.
+    const uint32_t bucketCount = n / 4 + 1;
+    m_KeyCount = n;
+    m_BucketCount = bucketCount;
+
+    std::vector<uint64_t> hashes(n);
+    std::vector<uint32_t> order(n);
+    std::vector<uint32_t> bucketStart(bucketCount + 1);
+    std::vector<uint32_t> bucketKeys(n);
+    std::vector<uint32_t> bucketOrder(bucketCount);
+    std::vector<uint32_t> slotKeys(n);
+    std::vector<uint32_t> pilots(bucketCount);
+    std::vector<uint32_t> candidateSlots;
+
+    const uint32_t MAX_ATTEMPTS = 32;
+    const uint32_t MAX_PILOT = 1u << 20;
+    bool success = false;
+    m_Seed = 0x2545F4914F6CDD1Dull;
+    for(uint32_t attempt = 0; attempt < MAX_ATTEMPTS && !success; ++attempt)
+    {
+        m_Seed = str_view_detail::mix64(m_Seed + attempt);
+
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            hashes[i] = hash_key(keys[i], keys[i].length());
+            order[i] = i;
+        }
+
+        // Equal hashes mean either duplicate keys or a collision that requires different seed.
+        std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return hashes[lhs] < hashes[rhs]; });
+        bool collision = false;
+        for(uint32_t i = 1; i < n; ++i)
+        {
+            if(hashes[order[i - 1]] == hashes[order[i]])
+            {
+                if(keys[order[i - 1]] == keys[order[i]])
+                {
+                    reset();
+                    return false;
+                }
+                collision = true;
+                break;
+            }
+        }
+        if(collision)
+            continue;
+
+        // Distribute keys into buckets using counting sort.
+        std::fill(bucketStart.begin(), bucketStart.end(), 0);
+        for(uint32_t i = 0; i < n; ++i)
+            ++bucketStart[str_view_detail::fast_range32((uint32_t)hashes[i], bucketCount) + 1];
+        for(uint32_t b = 0; b < bucketCount; ++b)
+            bucketStart[b + 1] += bucketStart[b];
+        {
+            std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+            for(uint32_t i = 0; i < n; ++i)
+                bucketKeys[fill[str_view_detail::fast_range32((uint32_t)hashes[i], bucketCount)]++] = i;
+        }
+
+        // Place largest buckets first, when there are still many free slots.
+        for(uint32_t b = 0; b < bucketCount; ++b)
+            bucketOrder[b] = b;
+        std::stable_sort(bucketOrder.begin(), bucketOrder.end(), [&](uint32_t lhs, uint32_t rhs) {
+            return bucketStart[lhs + 1] - bucketStart[lhs] > bucketStart[rhs + 1] - bucketStart[rhs]; });
+
+        std::fill(slotKeys.begin(), slotKeys.end(), UINT32_MAX);
+        std::fill(pilots.begin(), pilots.end(), 0);
+        success = true;
+        uint32_t nextFreeSlot = 0;
+        for(uint32_t orderIndex = 0; orderIndex < bucketCount && success; ++orderIndex)
+        {
+            const uint32_t b = bucketOrder[orderIndex];
+            const uint32_t first = bucketStart[b];
+            const uint32_t count = bucketStart[b + 1] - first;
+            if(count == 0)
+                break;
+            if(count == 1)
+            {
+                // Single key can be placed in any free slot, stored directly.
+                while(slotKeys[nextFreeSlot] != UINT32_MAX)
+                    ++nextFreeSlot;
+                slotKeys[nextFreeSlot] = bucketKeys[first];
+                pilots[b] = nextFreeSlot | DIRECT_SLOT_BIT;
+                continue;
+            }
+            bool placed = false;
+            for(uint32_t pilot = 0; pilot < MAX_PILOT && !placed; ++pilot)
+            {
+                candidateSlots.clear();
+                placed = true;
+                for(uint32_t i = 0; i < count; ++i)
+                {
+                    const uint32_t slot = slot_for(hashes[bucketKeys[first + i]], pilot);
+                    if(slotKeys[slot] != UINT32_MAX ||
+                        std::find(candidateSlots.begin(), candidateSlots.end(), slot) != candidateSlots.end())
+                    {
+                        placed = false;
+                        break;
+                    }
+                    candidateSlots.push_back(slot);
+                }
+                if(placed)
+                {
+                    for(uint32_t i = 0; i < count; ++i)
+                        slotKeys[candidateSlots[i]] = bucketKeys[first + i];
+                    pilots[b] = pilot;
+                }
+            }
+            success = placed;
+        }
+    }
+    if(!success)
+    {
+        reset();
+        return false;
+    }
+
+    // Write the image.
+    uint64_t charCount = 0;
+    for(uint32_t i = 0; i < n; ++i)
+        charCount += keys[i].length() + 1;
+    const size_t imageSize = sizeof(ImageHeader) + align8(bucketCount * sizeof(uint32_t)) +
+        ((size_t)n + 1) * sizeof(uint64_t) + align8((size_t)charCount * sizeof(CharT));
+    m_Storage.resize(imageSize / sizeof(uint64_t));
+    m_Image = m_Storage.data();
+    m_ImageSize = imageSize;
+
+    ImageHeader* const header = (ImageHeader*)m_Storage.data();
+    header->magic = IMAGE_MAGIC;
+    header->version = IMAGE_VERSION;
+    header->charSize = (uint32_t)sizeof(CharT);
+    header->keyCount = n;
+    header->bucketCount = bucketCount;
+    header->reserved = 0;
+    header->seed = m_Seed;
+    header->charCount = charCount;
+    setup_pointers(n, bucketCount, charCount);
+
+    memcpy((void*)m_Pilots, pilots.data(), bucketCount * sizeof(uint32_t));
+    uint64_t* const offsets = (uint64_t*)m_Offsets;
+    CharT* const chars = (CharT*)m_Chars;
+    uint64_t charIndex = 0;
+    for(uint32_t slot = 0; slot < n; ++slot)
+    {
+        offsets[slot] = charIndex;
+        const str_view_template<CharT>& key = keys[slotKeys[slot]];
+        if(!key.empty())
+            charIndex += key.copy_to(chars + charIndex);
+        chars[charIndex++] = (CharT)0;
+    }
+    offsets[n] = charIndex;
+    return true;
+}
+
+template<typename CharT>
+inline bool perfect_hash_dictionary_template<CharT>::attach(const void* image, size_t imageSize)
+{
+    reset();
+    if(image == nullptr || ((uintptr_t)image & 7) != 0 || imageSize < sizeof(ImageHeader))
+        return false;
+    const ImageHeader* const header = (const ImageHeader*)image;
+    if(header->magic != IMAGE_MAGIC || header->version != IMAGE_VERSION ||
+        header->charSize != sizeof(CharT) || header->keyCount >= DIRECT_SLOT_BIT ||
+        header->bucketCount != header->keyCount / 4 + 1)
+        return false;
+    m_Image = image;
+    m_ImageSize = imageSize;
+    m_Seed = header->seed;
+    if(!setup_pointers(header->keyCount, header->bucketCount, header->charCount) ||
+        m_Offsets[0] != 0 || m_Offsets[m_KeyCount] != header->charCount)
+    {
+        reset();
+        return false;
+    }
+    // Every key must be inside the characters and followed by null, as find() and key() don't check it.
+    for(uint32_t i = 0; i < m_KeyCount; ++i)
+    {
+        const uint64_t keyEnd = m_Offsets[i + 1];
+        if(keyEnd <= m_Offsets[i] || keyEnd > header->charCount || m_Chars[keyEnd - 1] != (CharT)0)
+        {
+            reset();
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename CharT>
+inline size_t perfect_hash_dictionary_template<CharT>::find(const str_view_template<CharT>& key) const
+{
+    if(m_KeyCount == 0)
+        return SIZE_MAX;
+    const size_t keyLen = key.length();
+    const uint64_t hash = hash_key(key, keyLen);
+    const uint32_t slot = slot_for(hash, m_Pilots[str_view_detail::fast_range32((uint32_t)hash, m_BucketCount)]);
+    if(slot >= m_KeyCount)
+        return SIZE_MAX;
+    const uint64_t keyOffset = m_Offsets[slot];
+    if(m_Offsets[slot + 1] - keyOffset - 1 != keyLen ||
+        (keyLen && memcmp(m_Chars + keyOffset, key.data(), keyLen * sizeof(CharT)) != 0))
+        return SIZE_MAX;
+    return slot;
+}
+
+template<typename CharT>
+inline str_view_template<CharT> perfect_hash_dictionary_template<CharT>::key(size_t index) const
+{
+    assert(index < m_KeyCount);
+    const uint64_t keyOffset = m_Offsets[index];
+    return str_view_template<CharT>(m_Chars + keyOffset, (size_t)(m_Offsets[index + 1] - keyOffset - 1),
+        typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+Ordered associative container that maps keys to values, implemented as an adaptive radix tree
+with path compression. Besides exact lookup, it efficiently finds the longest key that is a
+prefix of a given string and enumerates all keys that start with a given prefix, which makes it
+a replacement for testing a long list of prefixes one by one with starts_with().
+
+Keys are compared as sequences of characters, like with operator<, but without stopping at '\0'.
+
+Keys can be either copied into an internal arena, or stored by reference - as views into strings
+that must then remain alive and unchanged as long as they are in the container.
+
+Inner nodes come in 4 sizes, depending on the number of children: 4, 16, 48, 256.
+Node with 16 children is searched using SSE2 when available. Up to 8 bytes of compressed prefix
+are stored in the node, so only longer prefixes are read from keys. Leaves are allocated in blocks.
+
+Removal of single keys is not supported. Use clear() to remove all of them.
+*/
+template<typename CharT, typename ValueT>
+class radix_map_template
+{
+public:
+    /*
+    copy_keys - if true, inserted keys are copied to internal memory, otherwise the container
+    references original strings.
+    */
+    inline explicit radix_map_template(bool copy_keys = true);
+    inline ~radix_map_template();
+
+    inline size_t size() const { return m_Size; }
+    inline bool empty() const { return m_Size == 0; }
+    // Removes all the keys.
+    inline void clear();
+
+    /*
+    Inserts a key with a value, or replaces the value if the key already exists.
+    Returns true if new key was inserted.
+    */
+    inline bool insert(const str_view_template<CharT>& key, const ValueT& value);
+
+    /*
+    Returns pointer to the value stored under exactly given key, or null if the key doesn't exist.
+    */
+    inline ValueT* find(const str_view_template<CharT>& key);
+    inline const ValueT* find(const str_view_template<CharT>& key) const;
+    inline bool contains(const str_view_template<CharT>& key) const { return find(key) != nullptr; }
+
+    /*
+    Finds the longest key that is a prefix of str (possibly equal to str).
+    Returns pointer to its value, or null if no key is a prefix of str.
+    If outKey is not null and a key was found, it receives the key.
+    */
+    inline const ValueT* longest_prefix(const str_view_template<CharT>& str,
+        str_view_template<CharT>* outKey = nullptr) const;
+
+    /*
+    Calls func(key, value) for every key, in ascending order of keys.
+    key is passed as const str_view_template<CharT>&, value as const ValueT&.
+    */
+    template<typename Func>
+    inline void for_each(Func func) const { if(m_Root) visit(m_Root, func); }
+    /*
+    Calls func(key, value) for every key that starts with prefix, in ascending order of keys.
+    */
+    template<typename Func>
+    inline void for_each_with_prefix(const str_view_template<CharT>& prefix, Func func) const;
+
+private:
+    enum NODE_TYPE : uint8_t { NODE_TYPE_4, NODE_TYPE_16, NODE_TYPE_48, NODE_TYPE_256 };
+
+    struct Leaf
+    {
+        const CharT* key;
+        size_t keyLength;
+        bool nullTerminated;
+        ValueT value;
+    };
+
+    static const size_t MAX_INLINE_PREFIX = 8;
+
+    /*
+    Pointers to children are tagged - lowest bit set means it's a Leaf, not a Node.
+    All keys below a node share the same bytes up to the node's depth plus prefixLength.
+    First MAX_INLINE_PREFIX bytes of the compressed prefix are stored in the node,
+    following ones are read from any leaf below - prefixLeaf.
+    */
+    struct Node
+    {
+        uint8_t type;
+        uint16_t childCount;
+        uint32_t prefixLength;
+        uint8_t prefix[MAX_INLINE_PREFIX];
+        const Leaf* prefixLeaf;
+        // Leaf with key ending exactly at this node, if any.
+        Leaf* terminal;
+    };
+    struct Node4 : Node
+    {
+        uint8_t keys[4];
+        Node* children[4];
+    };
+    struct Node16 : Node
+    {
+        uint8_t keys[16];
+        Node* children[16];
+    };
+    struct Node48 : Node
+    {
+        // Index into children plus 1, or 0 if there is no child for given byte.
+        uint8_t childIndex[256];
+        Node* children[48];
+    };
+    struct Node256 : Node
+    {
+        Node* children[256];
+    };
+
+    static const size_t ARENA_BLOCK_SIZE = 4096;
+    static const size_t LEAF_BLOCK_SIZE = 64;
+
+    Node* m_Root;
+    size_t m_Size;
+    bool m_CopyKeys;
+    std::vector<CharT*> m_ArenaBlocks;
+    CharT* m_ArenaPtr;
+    size_t m_ArenaLeft;
+    // Raw memory for LEAF_BLOCK_SIZE leaves each. Leaves are destroyed by delete_node.
+    std::vector<Leaf*> m_LeafBlocks;
+    Leaf* m_LeafPtr;
+    size_t m_LeafLeft;
+
+    radix_map_template(const radix_map_template<CharT, ValueT>&) = delete;
+    radix_map_template<CharT, ValueT>& operator=(const radix_map_template<CharT, ValueT>&) = delete;
+
+    static bool is_leaf(const Node* node) { return ((uintptr_t)node & 1) != 0; }
+    static Leaf* as_leaf(const Node* node) { return (Leaf*)((uintptr_t)node & ~(uintptr_t)1); }
+    static Node* leaf_ref(Leaf* leaf) { return (Node*)((uintptr_t)leaf | 1); }
+
+    /*
+    Keys are processed as sequences of bytes. Characters wider than 1 byte are split starting
+    from the most significant byte, so that ordering of bytes matches ordering of characters.
+    */
+    static inline uint8_t key_byte(const CharT* key, size_t byteIndex)
+    {
+        if(sizeof(CharT) == 1)
+            return (uint8_t)key[byteIndex];
+        const size_t shift = (sizeof(CharT) - 1 - byteIndex % sizeof(CharT)) * 8;
+        return (uint8_t)((typename std::make_unsigned<CharT>::type)key[byteIndex / sizeof(CharT)] >> shift);
+    }
+    static inline bool bytes_equal(const CharT* lhs, const CharT* rhs, size_t byteOffset, size_t byteCount);
+    // Returns byte at index i of the compressed prefix of node that starts at byte depth.
+    static inline uint8_t prefix_byte(const Node* node, size_t depth, size_t i)
+    {
+        return i < MAX_INLINE_PREFIX ? node->prefix[i] : key_byte(node->prefixLeaf->key, depth + i);
+    }
+    // Checks if first byteCount bytes of the compressed prefix of node at byte depth are equal to bytes of str.
+    static inline bool prefix_equal(const Node* node, const CharT* str, size_t depth, size_t byteCount);
+    // Sets the compressed prefix of node at byte depth to prefixLength bytes of prefixLeaf.
+    static inline void set_prefix(Node* node, size_t depth, uint32_t prefixLength, const Leaf* prefixLeaf);
+    static inline bool leaf_matches(const Leaf* leaf, const CharT* key, size_t keyLength)
+    {
+        return leaf->keyLength == keyLength &&
+            (keyLength == 0 || memcmp(leaf->key, key, keyLength * sizeof(CharT)) == 0);
+    }
+    static inline str_view_template<CharT> leaf_key(const Leaf* leaf)
+    {
+        if(leaf->nullTerminated)
+            return str_view_template<CharT>(leaf->key, leaf->keyLength,
+                typename str_view_template<CharT>::StillNullTerminated());
+        return str_view_template<CharT>(leaf->key, leaf->keyLength);
+    }
+
+    inline Leaf* new_leaf(const str_view_template<CharT>& key, size_t keyLength, const ValueT& value);
+    static inline Node4* new_node4(size_t depth, uint32_t prefixLength, const Leaf* prefixLeaf);
+    static inline void delete_node(Node* node);
+    static inline Node* const* find_child(const Node* node, uint8_t byte);
+    static inline void add_child(Node*& nodeRef, uint8_t byte, Node* child);
+    // Places the leaf either as the terminal of the node, or as its child.
+    static inline void place_leaf(Node*& nodeRef, Leaf* leaf, size_t depth);
+    template<typename Func>
+    static inline void visit(const Node* node, Func& func);
+};
+
+template<typename ValueT> using radix_map = radix_map_template<char, ValueT>;
+template<typename ValueT> using wradix_map = radix_map_template<wchar_t, ValueT>;
+
+template<typename CharT, typename ValueT>
+inline radix_map_template<CharT, ValueT>::radix_map_template(bool copy_keys) :
+    m_Root(nullptr),
+    m_Size(0),
+    m_CopyKeys(copy_keys),
+    m_ArenaPtr(nullptr),
+    m_ArenaLeft(0),
+    m_LeafPtr(nullptr),
+    m_LeafLeft(0)
+{
+}
+
+template<typename CharT, typename ValueT>
+inline radix_map_template<CharT, ValueT>::~radix_map_template()
+{
+    clear();
+}
+
+template<typename CharT, typename ValueT>
+inline void radix_map_template<CharT, ValueT>::clear()
+{
+    if(m_Root)
+        delete_node(m_Root);
+    m_Root = nullptr;
+    m_Size = 0;
+    for(size_t i = m_ArenaBlocks.size(); i--; )
+        delete[] m_ArenaBlocks[i];
+    m_ArenaBlocks.clear();
+    m_ArenaPtr = nullptr;
+    m_ArenaLeft = 0;
+    for(size_t i = m_LeafBlocks.size(); i--; )
+        ::operator delete(m_LeafBlocks[i]);
+    m_LeafBlocks.clear();
+    m_LeafPtr = nullptr;
+    m_LeafLeft = 0;
+}
+
+template<typename CharT, typename ValueT>
+inline bool radix_map_template<CharT, ValueT>::bytes_equal(const CharT* lhs, const CharT* rhs, size_t byteOffset, size_t byteCount)
+{
+    if(sizeof(CharT) == 1)
+        return byteCount == 0 || memcmp(lhs + byteOffset, rhs + byteOffset, byteCount) == 0;
+    for(size_t i = 0; i < byteCount; ++i)
+    {
+        if(key_byte(lhs, byteOffset + i) != key_byte(rhs, byteOffset + i))
+            return false;
+    }
+    return true;
+}
+
+template<typename CharT, typename ValueT>
+inline bool radix_map_template<CharT, ValueT>::prefix_equal(const Node* node, const CharT* str, size_t depth, size_t byteCount)
+{
+    const size_t inlineCount = std::min(byteCount, (size_t)MAX_INLINE_PREFIX);
+    for(size_t i = 0; i < inlineCount; ++i)
+    {
+        if(node->prefix[i] != key_byte(str, depth + i))
+            return false;
+    }
+    return byteCount <= MAX_INLINE_PREFIX ||
+        bytes_equal(node->prefixLeaf->key, str, depth + MAX_INLINE_PREFIX, byteCount - MAX_INLINE_PREFIX);
+}
+
+template<typename CharT, typename ValueT>
+inline void radix_map_template<CharT, ValueT>::set_prefix(Node* node, size_t depth, uint32_t prefixLength, const Leaf* prefixLeaf)
+{
+    node->prefixLength = prefixLength;
+    node->prefixLeaf = prefixLeaf;
+    const size_t inlineCount = std::min((size_t)prefixLength, (size_t)MAX_INLINE_PREFIX);
+    for(size_t i = 0; i < inlineCount; ++i)
+        node->prefix[i] = key_byte(prefixLeaf->key, depth + i);
+}
+
+template<typename CharT, typename ValueT>
+inline typename radix_map_template<CharT, ValueT>::Leaf* radix_map_template<CharT, ValueT>::new_leaf(
+    const str_view_template<CharT>& key, size_t keyLength, const ValueT& value)
+{
+    if(m_LeafLeft == 0)
+    {
+        m_LeafBlocks.push_back((Leaf*)::operator new(LEAF_BLOCK_SIZE * sizeof(Leaf)));
+        m_LeafPtr = m_LeafBlocks.back();
+        m_LeafLeft = LEAF_BLOCK_SIZE;
+    }
+    Leaf* const leaf = new(m_LeafPtr) Leaf{ key.data(), keyLength, false, value };
+    ++m_LeafPtr;
+    --m_LeafLeft;
+    if(m_CopyKeys)
+    {
+        if(keyLength + 1 > m_ArenaLeft)
+        {
+            const size_t blockSize = std::max(keyLength + 1, (size_t)ARENA_BLOCK_SIZE);
+            m_ArenaBlocks.push_back(new CharT[blockSize]);
+            m_ArenaPtr = m_ArenaBlocks.back();
+            m_ArenaLeft = blockSize;
+        }
+        if(keyLength)
+            memcpy(m_ArenaPtr, key.data(), keyLength * sizeof(CharT));
+        m_ArenaPtr[keyLength] = (CharT)0;
+        leaf->key = m_ArenaPtr;
+        leaf->nullTerminated = true;
+        m_ArenaPtr += keyLength + 1;
+        m_ArenaLeft -= keyLength + 1;
+    }
+    else
+        leaf->nullTerminated = key.is_null_terminated();
+    return leaf;
+}
+
+template<typename CharT, typename ValueT>
+inline typename radix_map_template<CharT, ValueT>::Node4* radix_map_template<CharT, ValueT>::new_node4(
+    size_t depth, uint32_t prefixLength, const Leaf* prefixLeaf)
+{
+    Node4* const node = new Node4;
+    node->type = NODE_TYPE_4;
+    node->childCount = 0;
+    set_prefix(node, depth, prefixLength, prefixLeaf);
+    node->terminal = nullptr;
+    return node;
+}
+
+template<typename CharT, typename ValueT>
+inline void radix_map_template<CharT, ValueT>::delete_node(Node* node)
+{
+    // Memory of leaves is freed by clear().
+    if(is_leaf(node))
+    {
+        as_leaf(node)->~Leaf();
+        return;
+    }
+    if(node->terminal)
+        node->terminal->~Leaf();
+    switch(node->type)
+    {
+    case NODE_TYPE_4:
+        for(uint32_t i = 0; i < node->childCount; ++i)
+            delete_node(((Node4*)node)->children[i]);
+        delete (Node4*)node;
+        break;
+    case NODE_TYPE_16:
+        for(uint32_t i = 0; i < node->childCount; ++i)
+            delete_node(((Node16*)node)->children[i]);
+        delete (Node16*)node;
+        break;
+    case NODE_TYPE_48:
+        for(uint32_t i = 0; i < node->childCount; ++i)
+            delete_node(((Node48*)node)->children[i]);
+        delete (Node48*)node;
+        break;
+    case NODE_TYPE_256:
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            if(((Node256*)node)->children[i])
+                delete_node(((Node256*)node)->children[i]);
+        }
+        delete (Node256*)node;
+        break;
+    }
+}
+
+template<typename CharT, typename ValueT>
+inline typename radix_map_template<CharT, ValueT>::Node* const* radix_map_template<CharT, ValueT>::find_child(
+    const Node* node, uint8_t byte)
+{
+    switch(node->type)
+    {
+    case NODE_TYPE_4:
+    {
+        const Node4* const n = (const Node4*)node;
+        for(uint32_t i = 0; i < n->childCount; ++i)
+        {
+            if(n->keys[i] == byte)
+                return &n->children[i];
+        }
+        return nullptr;
+    }
+    case NODE_TYPE_16:
+    {
+        const Node16* const n = (const Node16*)node;
+#if STR_VIEW_SSE2
+        const __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte), _mm_loadu_si128((const __m128i*)n->keys));
+        const uint32_t mask = (uint32_t)_mm_movemask_epi8(cmp) & ((1u << n->childCount) - 1);
+        return mask ? &n->children[str_view_detail::ctz32(mask)] : nullptr;
+#else
+        for(uint32_t i = 0; i < n->childCount; ++i)
+        {
+            if(n->keys[i] == byte)
+                return &n->children[i];
+        }
+        return nullptr;
+#endif
+    }
+    case NODE_TYPE_48:
+    {
+        const Node48* const n = (const Node48*)node;
+        return n->childIndex[byte] ? &n->children[n->childIndex[byte] - 1] : nullptr;
+    }
+    default:
+    {
+        const Node256* const n = (const Node256*)node;
+        return n->children[byte] ? &n->children[byte] : nullptr;
+    }
+    }
+}
+
+template<typename CharT, typename ValueT>
+inline void radix_map_template<CharT, ValueT>::add_child(Node*& nodeRef, uint8_t byte, Node* child)
+{
+    Node* const node = nodeRef;
+    switch(node->type)
+    {
+    case NODE_TYPE_4:
+    {
+        Node4* const n = (Node4*)node;
+        if(n->childCount < 4)
+        {
+            // Keep keys sorted.
+            uint32_t pos = n->childCount;
+            for(; pos > 0 && n->keys[pos - 1] > byte; --pos)
+            {
+                n->keys[pos] = n->keys[pos - 1];
+                n->children[pos] = n->children[pos - 1];
+            }
+            n->keys[pos] = byte;
+            n->children[pos] = child;
+            ++n->childCount;
+            return;
+        }
+        Node16* const grown = new Node16;
+        *(Node*)grown = *(Node*)n;
+        grown->type = NODE_TYPE_16;
+        memcpy(grown->keys, n->keys, sizeof(n->keys));
+        memcpy(grown->children, n->children, sizeof(n->children));
+        delete n;
+        nodeRef = grown;
+        add_child(nodeRef, byte, child);
+        return;
+    }
+    case NODE_TYPE_16:
+    {
+        Node16* const n = (Node16*)node;
+        if(n->childCount < 16)
+        {
+            uint32_t pos = n->childCount;
+            for(; pos > 0 && n->keys[pos - 1] > byte; --pos)
+            {
+                n->keys[pos] = n->keys[pos - 1];
+                n->children[pos] = n->children[pos - 1];
+            }
+            n->keys[pos] = byte;
+            n->children[pos] = child;
+            ++n->childCount;
+            return;
+        }
+        Node48* const grown = new Node48;
+        *(Node*)grown = *(Node*)n;
+        grown->type = NODE_TYPE_48;
+        memset(grown->childIndex, 0, sizeof(grown->childIndex));
+        for(uint32_t i = 0; i < 16; ++i)
+        {
+            grown->childIndex[n->keys[i]] = (uint8_t)(i + 1);
+            grown->children[i] = n->children[i];
+        }
+        delete n;
+        nodeRef = grown;
+        add_child(nodeRef, byte, child);
+        return;
+    }
+    case NODE_TYPE_48:
+    {
+        Node48* const n = (Node48*)node;
+        if(n->childCount < 48)
+        {
+            n->children[n->childCount] = child;
+            n->childIndex[byte] = (uint8_t)++n->childCount;
+            return;
+        }
+        Node256* const grown = new Node256;
+        *(Node*)grown = *(Node*)n;
+        grown->type = NODE_TYPE_256;
+        memset(grown->children, 0, sizeof(grown->children));
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            if(n->childIndex[i])
+                grown->children[i] = n->children[n->childIndex[i] - 1];
+        }
+        delete n;
+        nodeRef = grown;
+        add_child(nodeRef, byte, child);
+        return;
+    }
+    default:
+    {
+        Node256* const n = (Node256*)node;
+        n->children[byte] = child;
+        ++n->childCount;
+        return;
+    }
+    }
+}
+
+template<typename CharT, typename ValueT>
+inline void radix_map_template<CharT, ValueT>::place_leaf(Node*& nodeRef, Leaf* leaf, size_t depth)
+{
+    if(leaf->keyLength * sizeof(CharT) == depth)
+        nodeRef->terminal = leaf;
+    else
+        add_child(nodeRef, key_byte(leaf->key, depth), leaf_ref(leaf));
+}
+
+template<typename CharT, typename ValueT>
+inline bool radix_map_template<CharT, ValueT>::insert(const str_view_template<CharT>& key, const ValueT& value)
+{
+    const size_t keyLength = key.length();
+    const size_t keyBytes = keyLength * sizeof(CharT);
+    const CharT* const k = key.data();
+    Node** ref = &m_Root;
+    size_t depth = 0;
+    for(;;)
+    {
+        Node* const node = *ref;
+        if(node == nullptr)
+        {
+            *ref = leaf_ref(new_leaf(key, keyLength, value));
+            break;
+        }
+
+        if(is_leaf(node))
+        {
+            Leaf* const existing = as_leaf(node);
+            if(leaf_matches(existing, k, keyLength))
+            {
+                existing->value = value;
+                return false;
+            }
+            // Replace the leaf with a node that has both leaves under it.
+            Leaf* const leaf = new_leaf(key, keyLength, value);
+            const size_t maxBytes = std::min(existing->keyLength * sizeof(CharT), keyBytes);
+            size_t splitDepth = depth;
+            while(splitDepth < maxBytes && key_byte(existing->key, splitDepth) == key_byte(leaf->key, splitDepth))
+                ++splitDepth;
+            Node* newNode = new_node4(depth, (uint32_t)(splitDepth - depth), existing);
+            place_leaf(newNode, existing, splitDepth);
+            place_leaf(newNode, leaf, splitDepth);
+            *ref = newNode;
+            break;
+        }
+
+        // Check the compressed prefix.
+        const size_t prefixLength = node->prefixLength;
+        size_t matched = 0;
+        while(matched < prefixLength && depth + matched < keyBytes &&
+            prefix_byte(node, depth, matched) == key_byte(k, depth + matched))
+            ++matched;
+        if(matched < prefixLength)
+        {
+            // Split the prefix with a new node.
+            Leaf* const leaf = new_leaf(key, keyLength, value);
+            Node* newNode = new_node4(depth, (uint32_t)matched, node->prefixLeaf);
+            const uint8_t nodeByte = prefix_byte(node, depth, matched);
+            set_prefix(node, depth + matched + 1, (uint32_t)(prefixLength - matched - 1), node->prefixLeaf);
+            add_child(newNode, nodeByte, node);
+            place_leaf(newNode, leaf, depth + matched);
+            *ref = newNode;
+            break;
+        }
+        depth += prefixLength;
+
+        if(depth == keyBytes)
+        {
+            if(node->terminal)
+            {
+                node->terminal->value = value;
+                return false;
+            }
+            node->terminal = new_leaf(key, keyLength, value);
+            break;
+        }
+
+        const uint8_t byte = key_byte(k, depth);
+        Node* const* const child = find_child(node, byte);
+        if(child == nullptr)
+        {
+            add_child(*ref, byte, leaf_ref(new_leaf(key, keyLength, value)));
+            break;
+        }
+        ref = (Node**)child;
+        ++depth;
+    }
+    ++m_Size;
+    return true;
+}
+
+template<typename CharT, typename ValueT>
+inline ValueT* radix_map_template<CharT, ValueT>::find(const str_view_template<CharT>& key)
+{
+    return const_cast<ValueT*>(static_cast<const radix_map_template<CharT, ValueT>*>(this)->find(key));
+}
+
+template<typename CharT, typename ValueT>
+inline const ValueT* radix_map_template<CharT, ValueT>::find(const str_view_template<CharT>& key) const
+{
+    const size_t keyLength = key.length();
+    const size_t keyBytes = keyLength * sizeof(CharT);
+    const CharT* const k = key.data();
+    const Node* node = m_Root;
+    size_t depth = 0;
+    // Prefixes are skipped without checking. The key is compared once with the leaf found.
+    while(node)
+    {
+        if(is_leaf(node))
+        {
+            const Leaf* const leaf = as_leaf(node);
+            return leaf_matches(leaf, k, keyLength) ? &leaf->value : nullptr;
+        }
+        depth += node->prefixLength;
+        if(depth >= keyBytes)
+        {
+            if(depth == keyBytes && node->terminal && leaf_matches(node->terminal, k, keyLength))
+                return &node->terminal->value;
+            return nullptr;
+        }
+        Node* const* const child = find_child(node, key_byte(k, depth));
+        node = child ? *child : nullptr;
+        ++depth;
+    }
+    return nullptr;
+}
+
+template<typename CharT, typename ValueT>
+inline const ValueT* radix_map_template<CharT, ValueT>::longest_prefix(const str_view_template<CharT>& str,
+    str_view_template<CharT>* outKey) const
+{
+    const size_t strLength = str.length();
+    const size_t strBytes = strLength * sizeof(CharT);
+    const CharT* const s = str.data();
+    const Leaf* best = nullptr;
+    const Node* node = m_Root;
+    size_t depth = 0;
+    while(node)
+    {
+        if(is_leaf(node))
+        {
+            const Leaf* const leaf = as_leaf(node);
+            const size_t leafBytes = leaf->keyLength * sizeof(CharT);
+            if(leafBytes <= strBytes && bytes_equal(leaf->key, s, depth, leafBytes - depth))
+                best = leaf;
+            break;
+        }
+        // All keys below this node are longer than the prefix.
+        const size_t prefixLength = node->prefixLength;
+        if(depth + prefixLength > strBytes || !prefix_equal(node, s, depth, prefixLength))
+            break;
+        depth += prefixLength;
+        // Bytes up to depth are matched, so terminal key is a prefix of str.
+        if(node->terminal)
+            best = node->terminal;
+        if(depth == strBytes)
+            break;
+        Node* const* const child = find_child(node, key_byte(s, depth));
+        node = child ? *child : nullptr;
+        ++depth;
+    }
+    if(best == nullptr)
+        return nullptr;
+    if(outKey)
+        *outKey = leaf_key(best);
+    return &best->value;
+}
+
+template<typename CharT, typename ValueT>
+template<typename Func>
+inline void radix_map_template<CharT, ValueT>::for_each_with_prefix(const str_view_template<CharT>& prefix, Func func) const
+{
+    const size_t prefixBytes = prefix.length() * sizeof(CharT);
+    const CharT* const p = prefix.data();
+    const Node* node = m_Root;
+    size_t depth = 0;
+    // Compressed prefixes are checked on the way down, until the whole prefix is consumed.
+    // Then all keys in the subtree start with it.
+    while(node)
+    {
+        if(is_leaf(node))
+        {
+            const Leaf* const leaf = as_leaf(node);
+            const size_t leafBytes = leaf->keyLength * sizeof(CharT);
+            if(leafBytes >= prefixBytes && bytes_equal(leaf->key, p, depth, prefixBytes - depth))
+                visit(node, func);
+            return;
+        }
+        if(depth + node->prefixLength >= prefixBytes)
+        {
+            if(prefix_equal(node, p, depth, prefixBytes - depth))
+                visit(node, func);
+            return;
+        }
+        if(!prefix_equal(node, p, depth, node->prefixLength))
+            return;
+        depth += node->prefixLength;
+        Node* const* const child = find_child(node, key_byte(p, depth));
+        node = child ? *child : nullptr;
+        ++depth;
+    }
+}
+
+template<typename CharT, typename ValueT>
+template<typename Func>
+inline void radix_map_template<CharT, ValueT>::visit(const Node* node, Func& func)
+{
+    if(is_leaf(node))
+    {
+        const Leaf* const leaf = as_leaf(node);
+        func(leaf_key(leaf), (const ValueT&)leaf->value);
+        return;
+    }
+    // Shorter key goes first.
+    if(node->terminal)
+        func(leaf_key(node->terminal), (const ValueT&)node->terminal->value);
+    switch(node->type)
+    {
+    case NODE_TYPE_4:
+        for(uint32_t i = 0; i < node->childCount; ++i)
+            visit(((const Node4*)node)->children[i], func);
+        break;
+    case NODE_TYPE_16:
+        for(uint32_t i = 0; i < node->childCount; ++i)
+            visit(((const Node16*)node)->children[i], func);
+        break;
+    case NODE_TYPE_48:
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            if(((const Node48*)node)->childIndex[i])
+                visit(((const Node48*)node)->children[((const Node48*)node)->childIndex[i] - 1], func);
+        }
+        break;
+    case NODE_TYPE_256:
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            if(((const Node256*)node)->children[i])
+                visit(((const Node256*)node)->children[i], func);
+        }
+        break;
+    }
+}
+
+/*
+Compiled glob (wildcard) pattern. Pattern syntax:
+
+- * matches any sequence of characters, including empty one.
+- ? matches any single character.
+- [abc], [a-z] matches single character from the set. [!a-z] or [^a-z] matches any character not
+  in the set. To include ] in the set, place it first, e.g. []a].
+- \ makes the next character literal, e.g. \* matches *.
+- Any other character matches itself. Case-insensitive mode compares ASCII letters without case.
+
+The pattern is compiled once into segments separated by *. The first and the last segment are
+anchored to the beginning and the end of the string unless the pattern starts or ends with *.
+Middle segments made only of literal characters are searched using the vectorized substring
+search, also in case-insensitive mode, other ones using bit-parallel Shift-And algorithm.
+Matching time is linear in the length of the string if every segment has at most 64 atoms
+(characters, ? or [...]). Longer segments are found by their first 64 atoms, then verified
+at every candidate position, which can take O(length of the string * length of the segment).
+*/
+template<typename CharT>
+class glob_pattern_template
+{
+public:
+    // Initializes to a pattern that doesn't match anything.
+    inline glob_pattern_template();
+    inline glob_pattern_template(const str_view_template<CharT>& pattern, bool case_sensitive = true);
+
+    /*
+    Compiles new pattern.
+    Returns false if the pattern is malformed (contains unterminated [ or ends with \).
+    Such pattern doesn't match anything.
+    */
+    inline bool compile(const str_view_template<CharT>& pattern, bool case_sensitive = true);
+    inline bool valid() const { return m_Valid; }
+
+    // Returns true if whole str matches the pattern.
+    inline bool match(const str_view_template<CharT>& str) const;
+
+    // Returns minimum length of a string that can match the pattern.
+    inline size_t min_length() const { return m_MinLength; }
+    /*
+    Returns true and sets outCh if every matching string must end with character outCh.
+    In case-insensitive mode outCh is lowercase.
+    */
+    inline bool fixed_last_char(CharT& outCh) const;
+
+private:
+    static const size_t SHIFT_AND_MAX_ATOMS = 64;
+    // Shift-And masks are stored for characters below this value, computed on the fly for others.
+    static const uint32_t SHIFT_AND_TABLE_SIZE = 256;
+
+    enum ATOM_TYPE : uint8_t { ATOM_TYPE_LITERAL, ATOM_TYPE_ANY, ATOM_TYPE_CLASS };
+    struct Atom
+    {
+        ATOM_TYPE type;
+        // Literal character (lowercase in case-insensitive mode), or index into m_Classes.
+        uint32_t value;
+    };
+    struct CharClass
+    {
+        bool negated;
+        // Inclusive ranges of characters.
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    };
+    struct Segment
+    {
+        size_t firstAtom;
+        size_t atomCount;
+        // Index into m_Literals if all atoms are literal characters, otherwise SIZE_MAX.
+        // In case-insensitive mode the literals are lowercase.
+        size_t literalOffset;
+        // Index into m_ShiftAndTables.
+        size_t tableOffset;
+    };
+
+    bool m_Valid;
+    bool m_CaseSensitive;
+    bool m_HasStar;
+    bool m_AnchoredBegin;
+    bool m_AnchoredEnd;
+    size_t m_MinLength;
+    std::vector<Atom> m_Atoms;
+    std::vector<CharClass> m_Classes;
+    std::vector<Segment> m_Segments;
+    std::vector<CharT> m_Literals;
+    std::vector<uint64_t> m_ShiftAndTables;
+
+    static inline uint32_t to_code(CharT ch) { return (uint32_t)(typename std::make_unsigned<CharT>::type)ch; }
+    inline bool class_contains(const CharClass& charClass, uint32_t ch) const;
+    inline bool atom_matches(const Atom& atom, CharT ch) const;
+    inline bool segment_matches(const Segment& segment, const CharT* str) const;
+    // Bit i is set if ch matches atom i of the segment.
+    inline uint64_t shift_and_mask(const Segment& segment, CharT ch) const;
+    // Finds first position in str[begin, end) where segment matches, or returns SIZE_MAX.
+    inline size_t find_segment(const Segment& segment, const CharT* str, size_t begin, size_t end) const;
+    inline size_t find_segment_shift_and(const Segment& segment, const CharT* str, size_t begin, size_t end) const;
+    inline void add_segment(size_t firstAtom);
+};
+
+typedef glob_pattern_template<char> glob_pattern;
+typedef glob_pattern_template<wchar_t> wglob_pattern;
+
+template<typename CharT>
+inline glob_pattern_template<CharT>::glob_pattern_template() :
+    m_Valid(false),
+    m_CaseSensitive(true),
+    m_HasStar(false),
+    m_AnchoredBegin(true),
+    m_AnchoredEnd(true),
+    m_MinLength(0)
+{
+}
+
+template<typename CharT>
+inline glob_pattern_template<CharT>::glob_pattern_template(const str_view_template<CharT>& pattern, bool case_sensitive) :
+    m_Valid(false),
+    m_CaseSensitive(true),
+    m_HasStar(false),
+    m_AnchoredBegin(true),
+    m_AnchoredEnd(true),
+    m_MinLength(0)
+{
+    compile(pattern, case_sensitive);
+}
+
+template<typename CharT>
+inline void glob_pattern_template<CharT>::add_segment(size_t firstAtom)
+{
+    Segment segment = { firstAtom, m_Atoms.size() - firstAtom, SIZE_MAX, m_ShiftAndTables.size() };
+    if(segment.atomCount == 0)
+        return;
+
+    bool literal = true;
+    for(size_t i = 0; i < segment.atomCount && literal; ++i)
+        literal = m_Atoms[firstAtom + i].type == ATOM_TYPE_LITERAL;
+    if(literal)
+    {
+        segment.literalOffset = m_Literals.size();
+        for(size_t i = 0; i < segment.atomCount; ++i)
+            m_Literals.push_back((CharT)m_Atoms[firstAtom + i].value);
+    }
+
+    m_ShiftAndTables.resize(m_ShiftAndTables.size() + SHIFT_AND_TABLE_SIZE);
+    uint64_t* const table = &m_ShiftAndTables[segment.tableOffset];
+    for(uint32_t ch = 0; ch < SHIFT_AND_TABLE_SIZE; ++ch)
+    {
+        uint64_t mask = 0;
+        for(size_t i = 0; i < segment.atomCount && i < SHIFT_AND_MAX_ATOMS; ++i)
+        {
+            if(atom_matches(m_Atoms[firstAtom + i], (CharT)ch))
+                mask |= 1ull << i;
+        }
+        table[ch] = mask;
+    }
+    m_Segments.push_back(segment);
+}
+
+template<typename CharT>
+inline bool glob_pattern_template<CharT>::compile(const str_view_template<CharT>& pattern, bool case_sensitive)
+{
+    m_Valid = false;
+    m_CaseSensitive = case_sensitive;
+    m_HasStar = false;
+    m_AnchoredBegin = true;
+    m_AnchoredEnd = true;
+    m_MinLength = 0;
+    m_Atoms.clear();
+    m_Classes.clear();
+    m_Segments.clear();
+    m_Literals.clear();
+    m_ShiftAndTables.clear();
+
+    const size_t patternLen = pattern.length();
+    const CharT* const p = pattern.data();
+    size_t segmentBegin = 0;
+    bool endsWithStar = false;
+    for(size_t i = 0; i < patternLen; ++i)
+    {
+        Atom atom = { ATOM_TYPE_LITERAL, 0 };
+        switch(p[i])
+        {
+        case (CharT)'*':
+            if(i == 0)
+                m_AnchoredBegin = false;
+            m_HasStar = true;
+            endsWithStar = true;
+            add_segment(segmentBegin);
+            segmentBegin = m_Atoms.size();
+            continue;
+        case (CharT)'?':
+            atom.type = ATOM_TYPE_ANY;
+            break;
+        case (CharT)'[':
+        {
+            CharClass charClass = {};
+            size_t j = i + 1;
+            if(j < patternLen && (p[j] == (CharT)'!' || p[j] == (CharT)'^'))
+            {
+                charClass.negated = true;
+                ++j;
+            }
+            for(bool first = true; j < patternLen && (first || p[j] != (CharT)']'); first = false)
+            {
+                uint32_t rangeBegin = to_code(p[j++]);
+                uint32_t rangeEnd = rangeBegin;
+                if(j + 1 < patternLen && p[j] == (CharT)'-' && p[j + 1] != (CharT)']')
+                {
+                    rangeEnd = to_code(p[j + 1]);
+                    j += 2;
+                }
+                if(rangeBegin > rangeEnd)
+                    std::swap(rangeBegin, rangeEnd);
+                charClass.ranges.push_back(std::make_pair(rangeBegin, rangeEnd));
+            }
+            if(j >= patternLen)
+                return false;
+            i = j;
+            atom.type = ATOM_TYPE_CLASS;
+            atom.value = (uint32_t)m_Classes.size();
+            m_Classes.push_back(charClass);
+            break;
+        }
+        case (CharT)'\\':
+            if(++i == patternLen)
+                return false;
+            atom.value = to_code(m_CaseSensitive ? p[i] : str_view_detail::ascii_to_lower(p[i]));
+            break;
+        default:
+            atom.value = to_code(m_CaseSensitive ? p[i] : str_view_detail::ascii_to_lower(p[i]));
+        }
+        m_Atoms.push_back(atom);
+        endsWithStar = false;
+    }
+    m_AnchoredEnd = !endsWithStar;
+    add_segment(segmentBegin);
+    m_MinLength = m_Atoms.size();
+    m_Valid = true;
+    return true;
+}
+
+template<typename CharT>
+inline bool glob_pattern_template<CharT>::class_contains(const CharClass& charClass, uint32_t ch) const
+{
+    bool found = false;
+    for(size_t i = 0; i < charClass.ranges.size() && !found; ++i)
+        found = ch >= charClass.ranges[i].first && ch <= charClass.ranges[i].second;
+    return found != charClass.negated;
+}
+
+template<typename CharT>
+inline bool glob_pattern_template<CharT>::atom_matches(const Atom& atom, CharT ch) const
+{
+    switch(atom.type)
+    {
+    case ATOM_TYPE_LITERAL:
+        return (m_CaseSensitive ? to_code(ch) : to_code(str_view_detail::ascii_to_lower(ch))) == atom.value;
+    case ATOM_TYPE_ANY:
+        return true;
+    default:
+    {
+        const CharClass& charClass = m_Classes[atom.value];
+        if(m_CaseSensitive)
+            return class_contains(charClass, to_code(ch));
+        const bool containsLower = class_contains(charClass, to_code(str_view_detail::ascii_to_lower(ch)));
+        const bool containsUpper = class_contains(charClass, to_code(str_view_detail::ascii_to_upper(ch)));
+        return charClass.negated ? containsLower && containsUpper : containsLower || containsUpper;
+    }
+    }
+}
+
+template<typename CharT>
+inline bool glob_pattern_template<CharT>::segment_matches(const Segment& segment, const CharT* str) const
+{
+    if(segment.literalOffset != SIZE_MAX)
+    {
+        const CharT* const literal = &m_Literals[segment.literalOffset];
+        return m_CaseSensitive ?
+            memcmp(str, literal, segment.atomCount * sizeof(CharT)) == 0 :
+            str_view_detail::compare_folded<ascii_ci_traits<CharT>>(str, literal, segment.atomCount) == 0;
+    }
+    for(size_t i = 0; i < segment.atomCount; ++i)
+    {
+        if(!atom_matches(m_Atoms[segment.firstAtom + i], str[i]))
+            return false;
+    }
+    return true;
+}
+
+template<typename CharT>
+inline uint64_t glob_pattern_template<CharT>::shift_and_mask(const Segment& segment, CharT ch) const
+{
+    const uint32_t code = to_code(ch);
+    if(code < SHIFT_AND_TABLE_SIZE)
+        return m_ShiftAndTables[segment.tableOffset + code];
+    uint64_t mask = 0;
+    for(size_t i = 0; i < segment.atomCount && i < SHIFT_AND_MAX_ATOMS; ++i)
+    {
+        if(atom_matches(m_Atoms[segment.firstAtom + i], ch))
+            mask |= 1ull << i;
+    }
+    return mask;
+}
+
+template<typename CharT>
+inline size_t glob_pattern_template<CharT>::find_segment_shift_and(const Segment& segment,
+    const CharT* str, size_t begin, size_t end) const
+{
+    // Longer segments are searched by their first 64 atoms, then verified.
+    const size_t atomCount = std::min(segment.atomCount, (size_t)SHIFT_AND_MAX_ATOMS);
+    const uint64_t finalBit = 1ull << (atomCount - 1);
+    uint64_t state = 0;
+    for(size_t i = begin; i < end; ++i)
+    {
+        state = ((state << 1) | 1) & shift_and_mask(segment, str[i]);
+        if(state & finalBit)
+        {
+            const size_t pos = i + 1 - atomCount;
+            if(segment.atomCount == atomCount)
+                return pos;
+            if(pos + segment.atomCount <= end && segment_matches(segment, str + pos))
+                return pos;
+        }
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT>
+inline size_t glob_pattern_template<CharT>::find_segment(const Segment& segment,
+    const CharT* str, size_t begin, size_t end) const
+{
+    if(end - begin < segment.atomCount)
+        return SIZE_MAX;
+    if(segment.literalOffset == SIZE_MAX)
+        return find_segment_shift_and(segment, str, begin, end);
+
+    // Vectorized search, limited to verifying as many characters as it scans, plus some slack.
+    // If that's exceeded, the input is pathological and the rest is searched using Shift-And.
+    const CharT* const literal = &m_Literals[segment.literalOffset];
+    size_t budget = end - begin + 256;
+    size_t* const budgetPtr = segment.atomCount <= SHIFT_AND_MAX_ATOMS ? &budget : nullptr;
+    size_t pos;
+    if(m_CaseSensitive)
+        pos = str_view_detail::find_substr(str + begin, end - begin, literal, segment.atomCount, budgetPtr);
+    else
+    {
+        typedef ascii_ci_traits<CharT> FoldT;
+        const size_t middleLen = segment.atomCount > 2 ? segment.atomCount - 2 : 0;
+        pos = str_view_detail::find_folded_first_last<FoldT>(str + begin, end - begin, segment.atomCount,
+            literal[0], literal[segment.atomCount - 1], [&](size_t candidate)
+            {
+                if(budgetPtr)
+                {
+                    if(budget < middleLen)
+                    {
+                        budget = 0;
+                        return true;
+                    }
+                    budget -= middleLen;
+                }
+                return str_view_detail::compare_folded<FoldT>(str + begin + candidate + 1, literal + 1, middleLen) == 0;
+            });
+    }
+    if(pos == SIZE_MAX)
+        return SIZE_MAX;
+    if(budget == 0)
+        return find_segment_shift_and(segment, str, begin + pos, end);
+    return begin + pos;
+}
+
+template<typename CharT>
+inline bool glob_pattern_template<CharT>::match(const str_view_template<CharT>& str) const
+{
+    if(!m_Valid)
+        return false;
+    const size_t strLen = str.length();
+    if(strLen < m_MinLength)
+        return false;
+    const CharT* const s = str.data();
+    if(!m_HasStar)
+        return strLen == m_MinLength && (m_Segments.empty() || segment_matches(m_Segments[0], s));
+
+    size_t begin = 0;
+    size_t end = strLen;
+    size_t firstSegment = 0;
+    size_t lastSegment = m_Segments.size();
+    if(m_AnchoredBegin)
+    {
+        if(!segment_matches(m_Segments[0], s))
+            return false;
+        begin = m_Segments[0].atomCount;
+        ++firstSegment;
+    }
+    if(m_AnchoredEnd)
+    {
+        const Segment& segment = m_Segments.back();
+        if(end - begin < segment.atomCount || !segment_matches(segment, s + (end - segment.atomCount)))
+            return false;
+        end -= segment.atomCount;
+        --lastSegment;
+    }
+    // Taking leftmost match of every middle segment is always correct.
+    for(size_t i = firstSegment; i < lastSegment; ++i)
+    {
+        const size_t pos = find_segment(m_Segments[i], s, begin, end);
+        if(pos == SIZE_MAX)
+            return false;
+        begin = pos + m_Segments[i].atomCount;
+    }
+    return true;
+}
+
+template<typename CharT>
+inline bool glob_pattern_template<CharT>::fixed_last_char(CharT& outCh) const
+{
+    if(!m_Valid || !m_AnchoredEnd || m_Atoms.empty() || m_Atoms.back().type != ATOM_TYPE_LITERAL)
+        return false;
+    outCh = (CharT)m_Atoms.back().value;
+    return true;
+}
+
+/*
+Set of glob patterns, which tests a string against all of them.
+Patterns that require specific last character, like "*.log", are grouped by that character,
+so only the patterns from one group and the ones without such requirement are checked.
+There is no combined automaton: every such candidate pattern is matched separately, so the time
+grows with the number of patterns that end with the same character or don't have a fixed one, like "log.*".
+*/
+template<typename CharT>
+class glob_pattern_set_template
+{
+public:
+    /*
+    Adds new pattern and returns its index, or SIZE_MAX if the pattern is malformed.
+    Indices are assigned sequentially starting from 0.
+    */
+    inline size_t add(const str_view_template<CharT>& pattern, bool case_sensitive = true);
+    inline size_t size() const { return m_Patterns.size(); }
+    inline const glob_pattern_template<CharT>& pattern(size_t index) const { return m_Patterns[index]; }
+
+    // Returns index of the first pattern that matches str, or SIZE_MAX if none does.
+    inline size_t match_first(const str_view_template<CharT>& str) const;
+    // Fills outIndices with indices of all the patterns that match str, in ascending order.
+    // Returns true if any matched.
+    inline bool match_all(const str_view_template<CharT>& str, std::vector<size_t>& outIndices) const;
+
+private:
+    static const uint32_t GROUP_COUNT = 256;
+
+    std::vector<glob_pattern_template<CharT>> m_Patterns;
+    // Indices of patterns without fixed last character.
+    std::vector<size_t> m_Ungrouped;
+    // Indices of patterns with fixed last character, by its lowest 8 bits.
+    std::vector<size_t> m_Groups[GROUP_COUNT];
+
+    static inline uint32_t group_of(CharT ch) { return (uint32_t)(typename std::make_unsigned<CharT>::type)ch % GROUP_COUNT; }
+    // Calls func(index) for candidate patterns in ascending order, until it returns false.
+    template<typename Func>
+    inline void for_each_candidate(const str_view_template<CharT>& str, Func func) const;
+};
+
+typedef glob_pattern_set_template<char> glob_pattern_set;
+typedef glob_pattern_set_template<wchar_t> wglob_pattern_set;
+
+template<typename CharT>
+inline size_t glob_pattern_set_template<CharT>::add(const str_view_template<CharT>& pattern, bool case_sensitive)
+{
+    glob_pattern_template<CharT> compiled;
+    if(!compiled.compile(pattern, case_sensitive))
+        return SIZE_MAX;
+    const size_t index = m_Patterns.size();
+    CharT lastCh;
+    if(compiled.fixed_last_char(lastCh))
+    {
+        m_Groups[group_of(lastCh)].push_back(index);
+        if(!case_sensitive && str_view_detail::ascii_to_upper(lastCh) != lastCh)
+            m_Groups[group_of(str_view_detail::ascii_to_upper(lastCh))].push_back(index);
+    }
+    else
+        m_Ungrouped.push_back(index);
+    m_Patterns.push_back(std::move(compiled));
+    return index;
+}
+
+template<typename CharT>
+template<typename Func>
+inline void glob_pattern_set_template<CharT>::for_each_candidate(const str_view_template<CharT>& str, Func func) const
+{
+    static const std::vector<size_t> emptyGroup;
+    const std::vector<size_t>& group = str.empty() ? emptyGroup : m_Groups[group_of(str.back())];
+    // Merge two sorted lists of indices.
+    size_t groupIndex = 0;
+    size_t ungroupedIndex = 0;
+    while(groupIndex < group.size() || ungroupedIndex < m_Ungrouped.size())
+    {
+        size_t index;
+        if(ungroupedIndex == m_Ungrouped.size() ||
+            (groupIndex < group.size() && group[groupIndex] < m_Ungrouped[ungroupedIndex]))
+            index = group[groupIndex++];
+        else
+            index = m_Ungrouped[ungroupedIndex++];
+        if(!func(index))
+            return;
+    }
+}
+
+template<typename CharT>
+inline size_t glob_pattern_set_template<CharT>::match_first(const str_view_template<CharT>& str) const
+{
+    size_t result = SIZE_MAX;
+    for_each_candidate(str, [&](size_t index) {
+        if(m_Patterns[index].match(str))
+        {
+            result = index;
+            return false;
+        }
+        return true;
+    });
+    return result;
+}
+
+template<typename CharT>
+inline bool glob_pattern_set_template<CharT>::match_all(const str_view_template<CharT>& str, std::vector<size_t>& outIndices) const
+{
+    outIndices.clear();
+    for_each_candidate(str, [&](size_t index) {
+        if(m_Patterns[index].match(str))
+            outIndices.push_back(index);
+        return true;
+    });
+    return !outIndices.empty();
+}
+
+/*
+String made of multiple pieces that don't need to be contiguous in memory, e.g. chunks of
+a ring buffer, viewed as a single sequence of characters. Pieces are referenced, not copied,
+so the memory they point to must remain valid while this object is in use.
+Searching finds also matches that cross piece boundaries.
+*/
+template<typename CharT>
+class segmented_str_view_template
+{
+public:
+    typedef std::basic_string<CharT, std::char_traits<CharT>, std::allocator<CharT>> StringT;
+
+    /*
+    Initializes to empty string.
+    */
+    inline segmented_str_view_template();
+    /*
+    Initializes with given pieces, in order.
+    */
+    inline segmented_str_view_template(const str_view_template<CharT>* pieces, size_t piece_count);
+
+    /*
+    Appends a piece to the end of the string. Empty pieces are ignored.
+    The stored piece remembers if it's null-terminated, so its c_str() doesn't need a copy.
+    */
+    inline void append(const str_view_template<CharT>& piece);
+    inline void clear();
+
+    inline size_t piece_count() const { return m_Pieces.size(); }
+    inline const str_view_template<CharT>& piece(size_t index) const { return m_Pieces[index]; }
+    /*
+    Returns total length of all the pieces.
+    */
+    inline size_t length() const { return m_Length; }
+    inline size_t size() const { return m_Length; }
+    inline bool empty() const { return m_Length == 0; }
+    /*
+    Returns character at given position, finding its piece with binary search.
+    */
+    inline CharT operator[](size_t index) const;
+
+    /*
+    Compares characters, like str_view_template::compare.
+    */
+    inline int compare(const str_view_template<CharT>& rhs, bool case_sensitive = true) const;
+    inline int compare(const segmented_str_view_template<CharT>& rhs, bool case_sensitive = true) const;
+    inline bool operator==(const str_view_template<CharT>& rhs) const { return compare(rhs) == 0; }
+    inline bool operator!=(const str_view_template<CharT>& rhs) const { return compare(rhs) != 0; }
+
+    inline bool starts_with(const str_view_template<CharT>& prefix, bool case_sensitive = true) const;
+
+    /*
+    Finds the first occurrence, like str_view_template::find.
+    Returns position in the whole string or SIZE_MAX if not found.
+    */
+    inline size_t find(CharT ch, size_t pos = 0) const;
+    inline size_t find(const str_view_template<CharT>& substr, size_t pos = 0) const;
+
+    /*
+    Returns part of the string as a segmented view, referencing the same memory.
+    */
+    inline segmented_str_view_template<CharT> substr(size_t offset = 0, size_t length = SIZE_MAX) const;
+    /*
+    Returns part of the string as a single view. If it lies inside one piece, the view points
+    directly to it. Otherwise the characters are copied to buffer and the view points to it.
+    */
+    inline str_view_template<CharT> substr(size_t offset, size_t length, StringT& buffer) const;
+
+    inline void to_string(StringT& dst) const;
+    inline StringT to_string() const { StringT result; to_string(result); return result; }
+
+private:
+    std::vector<str_view_template<CharT>> m_Pieces;
+    // Position of the first character of each piece in the whole string.
+    std::vector<size_t> m_PieceOffsets;
+    size_t m_Length;
+
+    // Returns index of the piece that contains character at pos, which must be < length().
+    inline size_t piece_index(size_t pos) const;
+    // Returns true if characters starting at given piece and offset are equal to str. They must all fit in the string.
+    inline bool equal_at(size_t pieceIndex, size_t offsetInPiece, const CharT* str, size_t strLen) const;
+    static inline int compare_pieces(const str_view_template<CharT>* lhs, size_t lhsCount,
+        const str_view_template<CharT>* rhs, size_t rhsCount, bool case_sensitive);
+};
+
+typedef segmented_str_view_template<char> segmented_str_view;
+typedef segmented_str_view_template<wchar_t> segmented_wstr_view;
+
+template<typename CharT>
+inline segmented_str_view_template<CharT>::segmented_str_view_template() :
+    m_Length(0)
+{
+}
+
+template<typename CharT>
+inline segmented_str_view_template<CharT>::segmented_str_view_template(const str_view_template<CharT>* pieces, size_t piece_count) :
+    m_Length(0)
+{
+    for(size_t i = 0; i < piece_count; ++i)
+        append(pieces[i]);
+}
+
+template<typename CharT>
+inline void segmented_str_view_template<CharT>::append(const str_view_template<CharT>& piece)
+{
+    const size_t pieceLen = piece.length();
+    if(pieceLen == 0)
+        return;
+    // substr keeps null termination, but not the copy made by c_str() of the piece.
+    m_Pieces.push_back(piece.substr(0, pieceLen));
+    m_PieceOffsets.push_back(m_Length);
+    m_Length += pieceLen;
+}
+
+template<typename CharT>
+inline void segmented_str_view_template<CharT>::clear()
+{
+    m_Pieces.clear();
+    m_PieceOffsets.clear();
+    m_Length = 0;
+}
+
+template<typename CharT>
+inline size_t segmented_str_view_template<CharT>::piece_index(size_t pos) const
+{
+    assert(pos < m_Length);
+    return std::upper_bound(m_PieceOffsets.begin(), m_PieceOffsets.end(), pos) - m_PieceOffsets.begin() - 1;
+}
+
+template<typename CharT>
+inline CharT segmented_str_view_template<CharT>::operator[](size_t index) const
+{
+    const size_t pieceIndex = piece_index(index);
+    return m_Pieces[pieceIndex].data()[index - m_PieceOffsets[pieceIndex]];
+}
+
+template<typename CharT>
+inline int segmented_str_view_template<CharT>::compare_pieces(const str_view_template<CharT>* lhs, size_t lhsCount,
+    const str_view_template<CharT>* rhs, size_t rhsCount, bool case_sensitive)
+{
+    size_t lhsIndex = 0, rhsIndex = 0, lhsOffset = 0, rhsOffset = 0;
+    for(;;)
+    {
+        while(lhsIndex < lhsCount && lhsOffset == lhs[lhsIndex].length())
+        {
+            ++lhsIndex;
+            lhsOffset = 0;
+        }
+        while(rhsIndex < rhsCount && rhsOffset == rhs[rhsIndex].length())
+        {
+            ++rhsIndex;
+            rhsOffset = 0;
+        }
+        if(lhsIndex == lhsCount)
+            return rhsIndex == rhsCount ? 0 : -1;
+        if(rhsIndex == rhsCount)
+            return 1;
+        // Compare the longest span that is contiguous on both sides.
+        const size_t count = std::min(lhs[lhsIndex].length() - lhsOffset, rhs[rhsIndex].length() - rhsOffset);
+        const int result = str_view_template<CharT>(lhs[lhsIndex].data() + lhsOffset, count).compare(
+            str_view_template<CharT>(rhs[rhsIndex].data() + rhsOffset, count), case_sensitive);
+        if(result != 0)
+            return result;
+        lhsOffset += count;
+        rhsOffset += count;
+    }
+}
+
+template<typename CharT>
+inline int segmented_str_view_template<CharT>::compare(const str_view_template<CharT>& rhs, bool case_sensitive) const
+{
+    return compare_pieces(m_Pieces.data(), m_Pieces.size(), &rhs, 1, case_sensitive);
+}
+
+template<typename CharT>
+inline int segmented_str_view_template<CharT>::compare(const segmented_str_view_template<CharT>& rhs, bool case_sensitive) const
+{
+    return compare_pieces(m_Pieces.data(), m_Pieces.size(), rhs.m_Pieces.data(), rhs.m_Pieces.size(), case_sensitive);
+}
+
+template<typename CharT>
+inline bool segmented_str_view_template<CharT>::starts_with(const str_view_template<CharT>& prefix, bool case_sensitive) const
+{
+    const size_t prefixLen = prefix.length();
+    if(prefixLen > m_Length)
+        return false;
+    for(size_t pieceIndex = 0, done = 0; done < prefixLen; ++pieceIndex)
+    {
+        const size_t count = std::min(m_Pieces[pieceIndex].length(), prefixLen - done);
+        if(str_view_template<CharT>(m_Pieces[pieceIndex].data(), count).compare(
+            str_view_template<CharT>(prefix.data() + done, count), case_sensitive) != 0)
+        {
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+template<typename CharT>
+inline bool segmented_str_view_template<CharT>::equal_at(size_t pieceIndex, size_t offsetInPiece, const CharT* str, size_t strLen) const
+{
+    for(; strLen > 0; ++pieceIndex, offsetInPiece = 0)
+    {
+        assert(pieceIndex < m_Pieces.size());
+        const size_t count = std::min(m_Pieces[pieceIndex].length() - offsetInPiece, strLen);
+        if(memcmp(m_Pieces[pieceIndex].data() + offsetInPiece, str, count * sizeof(CharT)) != 0)
+            return false;
+        str += count;
+        strLen -= count;
+    }
+    return true;
+}
+
+template<typename CharT>
+inline size_t segmented_str_view_template<CharT>::find(CharT ch, size_t pos) const
+{
+    if(pos >= m_Length)
+        return SIZE_MAX;
+    for(size_t pieceIndex = piece_index(pos); pieceIndex < m_Pieces.size(); ++pieceIndex)
+    {
+        const size_t pieceBegin = m_PieceOffsets[pieceIndex];
+        const size_t index = m_Pieces[pieceIndex].find(ch, pos > pieceBegin ? pos - pieceBegin : 0);
+        if(index != SIZE_MAX)
+            return pieceBegin + index;
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT>
+inline size_t segmented_str_view_template<CharT>::find(const str_view_template<CharT>& substr, size_t pos) const
+{
+    const size_t subLen = substr.length();
+    if(subLen == 0)
+        return pos;
+    if(subLen > m_Length || pos > m_Length - subLen)
+        return SIZE_MAX;
+    const size_t lastStart = m_Length - subLen;
+    for(size_t pieceIndex = piece_index(pos); pieceIndex < m_Pieces.size(); ++pieceIndex)
+    {
+        const str_view_template<CharT>& piece = m_Pieces[pieceIndex];
+        const size_t pieceBegin = m_PieceOffsets[pieceIndex];
+        const size_t pieceLen = piece.length();
+        const size_t from = pos > pieceBegin ? pos - pieceBegin : 0;
+        // Matches inside the piece come before the ones that cross its end.
+        if(pieceLen >= subLen && from <= pieceLen - subLen)
+        {
+            const size_t index = piece.find(substr, from);
+            if(index != SIZE_MAX)
+                return pieceBegin + index;
+        }
+        // Matches that start in this piece and continue into the next ones.
+        const size_t crossFrom = std::max(from, pieceLen >= subLen ? pieceLen - subLen + 1 : 0);
+        for(size_t index = piece.find(substr.data()[0], crossFrom);
+            index != SIZE_MAX && pieceBegin + index <= lastStart;
+            index = piece.find(substr.data()[0], index + 1))
+        {
+            if(equal_at(pieceIndex, index, substr.data(), subLen))
+                return pieceBegin + index;
+        }
+        if(pieceBegin + pieceLen > lastStart)
+            break;
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT>
+inline segmented_str_view_template<CharT> segmented_str_view_template<CharT>::substr(size_t offset, size_t length) const
+{
+    assert(offset <= m_Length);
+    length = std::min(length, m_Length - offset);
+    segmented_str_view_template<CharT> result;
+    if(length == 0)
+        return result;
+    for(size_t pieceIndex = piece_index(offset); length > 0; ++pieceIndex)
+    {
+        const size_t offsetInPiece = offset - m_PieceOffsets[pieceIndex];
+        const size_t count = std::min(m_Pieces[pieceIndex].length() - offsetInPiece, length);
+        result.append(m_Pieces[pieceIndex].substr(offsetInPiece, count));
+        offset += count;
+        length -= count;
+    }
+    return result;
+}
+
+template<typename CharT>
+inline str_view_template<CharT> segmented_str_view_template<CharT>::substr(size_t offset, size_t length, StringT& buffer) const
+{
+    assert(offset <= m_Length);
+    length = std::min(length, m_Length - offset);
+    if(length == 0)
+        return str_view_template<CharT>();
+    const size_t pieceIndex = piece_index(offset);
+    const size_t offsetInPiece = offset - m_PieceOffsets[pieceIndex];
+    if(offsetInPiece + length <= m_Pieces[pieceIndex].length())
+        return m_Pieces[pieceIndex].substr(offsetInPiece, length);
+    buffer.clear();
+    buffer.reserve(length);
+    buffer.append(m_Pieces[pieceIndex].data() + offsetInPiece, m_Pieces[pieceIndex].length() - offsetInPiece);
+    for(size_t i = pieceIndex + 1; buffer.length() < length; ++i)
+        buffer.append(m_Pieces[i].data(), std::min(m_Pieces[i].length(), length - buffer.length()));
+    return str_view_template<CharT>(buffer);
+}
+
+template<typename CharT>
+inline void segmented_str_view_template<CharT>::to_string(StringT& dst) const
+{
+    dst.clear();
+    dst.reserve(m_Length);
+    for(const str_view_template<CharT>& piece : m_Pieces)
+        dst.append(piece.data(), piece.length());
+}
+
+/*
+Parser of delimited text records, like CSV or TSV, that returns fields as views of the input
+data without copying.
+
+Syntax follows RFC 4180: records end with "\n" or "\r\n", fields are separated by the delimiter.
+A field enclosed in quotes can contain delimiters, new lines, and quotes written twice. Quotes
+have special meaning only at the beginning of a field.
+
+Delimiters, new lines and quotes are found 64 characters at a time with SIMD comparisons turned
+into bit masks. Ranges inside quotes are calculated from the mask of quotes with prefix XOR,
+so delimiters inside quoted fields cost nothing extra. Quotes that would open a quoted range
+in the middle of an unquoted field are removed from the mask first, as ordinary characters.
+*/
+template<typename CharT>
+class csv_reader_template
+{
+public:
+    typedef std::basic_string<CharT, std::char_traits<CharT>, std::allocator<CharT>> StringT;
+
+    /*
+    data - the text to parse. It must remain valid while this object and the returned views are in use.
+    delimiter - e.g. ',' for CSV, '\t' for TSV.
+    */
+    inline csv_reader_template(const str_view_template<CharT>& data, CharT delimiter = (CharT)',', CharT quote = (CharT)'"');
+
+    /*
+    Returns true if there are no more records.
+    */
+    inline bool at_end() const { return m_Pos >= m_Length; }
+    /*
+    Returns true if a malformed quoted field was found so far: not terminated, or with a single
+    quote inside. Such fields are still returned, with the offending quotes removed.
+    */
+    inline bool malformed() const { return m_Malformed; }
+
+    /*
+    Parses the next record. Returns false if there are no more records.
+    fields - receives views of the fields of the record. Unquoted fields and quoted fields
+    without escaped quotes point to the input data.
+    scratch - quoted fields with escaped quotes are decoded to this buffer and their views point
+    to it. It is cleared first, so the views remain valid until the next call with the same buffer.
+    */
+    inline bool next_row(std::vector<str_view_template<CharT>>& fields, StringT& scratch);
+
+    /*
+    Bulk mode. Parses up to max_rows next records, appending field i of each record to columns[i],
+    for i in [0, column_count). Missing fields are appended as empty views, extra fields are ignored.
+    scratch - receives decoded quoted fields with escaped quotes, like in next_row. It is cleared first.
+    Returns number of parsed records.
+    */
+    inline size_t read_columns(std::vector<str_view_template<CharT>>* columns, size_t column_count,
+        StringT& scratch, size_t max_rows = SIZE_MAX);
+
+private:
+    static const size_t BLOCK_SIZE = 64;
+
+    struct FieldRef
+    {
+        size_t begin; // Index in the data, or in the scratch buffer if decoded.
+        size_t length;
+        bool decoded;
+    };
+    struct DecodedFieldRef
+    {
+        size_t column;
+        size_t row;
+        size_t begin;
+        size_t length;
+    };
+
+    const CharT* m_Data;
+    size_t m_Length;
+    CharT m_Delimiter;
+    CharT m_Quote;
+    bool m_Malformed;
+    // Beginning of the next field.
+    size_t m_Pos;
+    // Beginning of the block described by m_Structurals, and of the next one to classify.
+    size_t m_BlockBegin;
+    size_t m_NextBlockBegin;
+    // Delimiters and new lines outside of quotes, not yet consumed, in the current block.
+    uint64_t m_Structurals;
+    // All ones if the previous block ended inside quotes.
+    uint64_t m_InQuotesCarry;
+    // 1 if a quote at the first character of the next block can open a quoted range.
+    uint64_t m_OpenQuoteCarry;
+    std::vector<FieldRef> m_RowFields;
+    std::vector<DecodedFieldRef> m_DecodedFields;
+
+    // Returns position of the next delimiter or new line outside of quotes, or m_Length if there is none.
+    inline size_t next_structural();
+    // Parses the next record into m_RowFields.
+    inline void parse_row(StringT& scratch);
+    inline FieldRef make_field(size_t begin, size_t end, StringT& scratch);
+};
+
+typedef csv_reader_template<char> csv_reader;
+typedef csv_reader_template<wchar_t> wcsv_reader;
+
+template<typename CharT>
+inline csv_reader_template<CharT>::csv_reader_template(const str_view_template<CharT>& data, CharT delimiter, CharT quote) :
+    m_Data(data.data()),
+    m_Length(data.length()),
+    m_Delimiter(delimiter),
+    m_Quote(quote),
+    m_Malformed(false),
+    m_Pos(0),
+    m_BlockBegin(0),
+    m_NextBlockBegin(0),
+    m_Structurals(0),
+    m_InQuotesCarry(0),
+    m_OpenQuoteCarry(1)
+{
+    assert(delimiter != (CharT)0 && quote != (CharT)0 && delimiter != quote);
+}
+
+template<typename CharT>
+inline size_t csv_reader_template<CharT>::next_structural()
+{
+    for(;;)
+    {
+        if(m_Structurals != 0)
+        {
+            const uint32_t index = str_view_detail::ctz64(m_Structurals);
+            m_Structurals &= m_Structurals - 1;
+            return m_BlockBegin + index;
+        }
+        if(m_NextBlockBegin >= m_Length)
+            return m_Length;
+
+        m_BlockBegin = m_NextBlockBegin;
+        m_NextBlockBegin += BLOCK_SIZE;
+        uint64_t structurals, quotes;
+        const size_t remaining = m_Length - m_BlockBegin;
+        if(remaining >= BLOCK_SIZE)
+            str_view_detail::csv_classify64(m_Data + m_BlockBegin, m_Delimiter, m_Quote, structurals, quotes);
+        else
+        {
+            // Padding with zeros, which is neither a delimiter nor a quote.
+            CharT tail[BLOCK_SIZE] = {};
+            memcpy(tail, m_Data + m_BlockBegin, remaining * sizeof(CharT));
+            str_view_detail::csv_classify64(tail, m_Delimiter, m_Quote, structurals, quotes);
+            structurals &= (1ull << remaining) - 1;
+        }
+        uint64_t inQuotes;
+        for(;;)
+        {
+            inQuotes = str_view_detail::prefix_xor64(quotes) ^ m_InQuotesCarry;
+            // Quotes that open a quoted range, but neither begin a field nor follow a closing quote, as
+            // escaped quotes do. Only the first one is certain, as it changes ranges after it, so it is
+            // removed and the ranges are calculated again.
+            const uint64_t openQuoteAllowed = (((structurals | quotes) & ~inQuotes) << 1) | m_OpenQuoteCarry;
+            const uint64_t strayQuotes = quotes & inQuotes & ~openQuoteAllowed;
+            if(strayQuotes == 0)
+                break;
+            quotes ^= strayQuotes & (0 - strayQuotes);
+        }
+        m_InQuotesCarry = (inQuotes >> 63) ? ~0ull : 0;
+        m_Structurals = structurals & ~inQuotes;
+        m_OpenQuoteCarry = (m_Structurals | (quotes & ~inQuotes)) >> 63;
+    }
+}
+
+template<typename CharT>
+inline typename csv_reader_template<CharT>::FieldRef csv_reader_template<CharT>::make_field(size_t begin, size_t end, StringT& scratch)
+{
+    FieldRef result = { begin, end - begin, false };
+    if(begin == end || m_Data[begin] != m_Quote)
+        return result;
+
+    // Quoted field.
+    const size_t contentBegin = begin + 1;
+    size_t contentEnd = end;
+    if(end - begin >= 2 && m_Data[end - 1] == m_Quote)
+        --contentEnd;
+    else
+        m_Malformed = true;
+    const CharT* const content = m_Data + contentBegin;
+    const size_t contentLen = contentEnd - contentBegin;
+    size_t quotePos = str_view_detail::find_char(content, contentLen, m_Quote);
+    if(quotePos == SIZE_MAX)
+    {
+        result.begin = contentBegin;
+        result.length = contentLen;
+        return result;
+    }
+
+    // Decode escaped quotes.
+    result.begin = scratch.length();
+    result.decoded = true;
+    scratch.append(content, quotePos);
+    while(quotePos < contentLen)
+    {
+        size_t i = quotePos + 1;
+        if(i < contentLen && content[i] == m_Quote)
+        {
+            scratch.push_back(m_Quote);
+            ++i;
+        }
+        else
+            m_Malformed = true;
+        const size_t nextQuote = i < contentLen ? str_view_detail::find_char(content + i, contentLen - i, m_Quote) : SIZE_MAX;
+        quotePos = nextQuote != SIZE_MAX ? i + nextQuote : contentLen;
+        scratch.append(content + i, quotePos - i);
+    }
+    result.length = scratch.length() - result.begin;
+    return result;
+}
+
+template<typename CharT>
+inline void csv_reader_template<CharT>::parse_row(StringT& scratch)
+{
+    m_RowFields.clear();
+    for(;;)
+    {
+        const size_t begin = m_Pos;
+        const size_t end = next_structural();
+        const bool endOfRecord = end == m_Length || m_Data[end] == (CharT)'\n';
+        size_t fieldEnd = end;
+        if(endOfRecord && fieldEnd > begin && m_Data[fieldEnd - 1] == (CharT)'\r')
+            --fieldEnd;
+        m_RowFields.push_back(make_field(begin, fieldEnd, scratch));
+        m_Pos = std::min(end + 1, m_Length);
+        if(endOfRecord)
+            break;
+    }
+}
+
+template<typename CharT>
+inline bool csv_reader_template<CharT>::next_row(std::vector<str_view_template<CharT>>& fields, StringT& scratch)
+{
+    if(at_end())
+        return false;
+    scratch.clear();
+    parse_row(scratch);
+    fields.resize(m_RowFields.size());
+    for(size_t i = 0; i < m_RowFields.size(); ++i)
+    {
+        const FieldRef& field = m_RowFields[i];
+        fields[i] = str_view_template<CharT>((field.decoded ? scratch.data() : m_Data) + field.begin, field.length);
+    }
+    return true;
+}
+
+template<typename CharT>
+inline size_t csv_reader_template<CharT>::read_columns(std::vector<str_view_template<CharT>>* columns, size_t column_count,
+    StringT& scratch, size_t max_rows)
+{
+    scratch.clear();
+    // Views of decoded fields are created at the end, as scratch can be reallocated in the meantime.
+    m_DecodedFields.clear();
+    size_t rowCount = 0;
+    for(; rowCount < max_rows && !at_end(); ++rowCount)
+    {
+        parse_row(scratch);
+        for(size_t column = 0; column < column_count; ++column)
+        {
+            if(column >= m_RowFields.size())
+                columns[column].push_back(str_view_template<CharT>());
+            else if(m_RowFields[column].decoded)
+            {
+                const DecodedFieldRef decodedField = { column, columns[column].size(), m_RowFields[column].begin, m_RowFields[column].length };
+                m_DecodedFields.push_back(decodedField);
+                columns[column].push_back(str_view_template<CharT>());
+            }
+            else
+                columns[column].push_back(str_view_template<CharT>(m_Data + m_RowFields[column].begin, m_RowFields[column].length));
+        }
+    }
+    for(const DecodedFieldRef& decodedField : m_DecodedFields)
+        columns[decodedField.column][decodedField.row] = str_view_template<CharT>(scratch.data() + decodedField.begin, decodedField.length);
+    return rowCount;
+}
+
+/*
+Hexadecimal and base64 encoding of binary data into text and back.
+
+Output is written to a buffer provided by the caller, which must have space for the number of
+characters or bytes returned by the corresponding *_length function. No null terminator is written.
+Decoding functions return number of bytes written or SIZE_MAX if the input is invalid. Then, if
+out_error_pos is not null, it receives position of the first invalid character, or length of the
+input if it ends prematurely.
+All of them process 16 bytes at a time with SSE2, when available.
+*/
+
+inline size_t hex_encoded_length(size_t byte_count) { return byte_count * 2; }
+template<typename CharT>
+inline size_t hex_decoded_length(const str_view_template<CharT>& src) { return src.length() / 2; }
+
+/*
+Writes 2 hexadecimal digits for every byte, high nibble first. Returns number of characters written.
+*/
+template<typename CharT>
+inline size_t hex_encode(const void* data, size_t byte_count, CharT* dst, bool uppercase = false)
+{
+    const unsigned char* const src = (const unsigned char*)data;
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zeroChar = _mm_set1_epi8('0');
+    // Distance between '9' + 1 and the first letter.
+    const __m128i letterOffset = _mm_set1_epi8(uppercase ? 'A' - '9' - 1 : 'a' - '9' - 1);
+    for(; i + 16 <= byte_count; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask);
+        const __m128i lowNibbles = _mm_and_si128(bytes, lowMask);
+        const __m128i nibbles[] = { _mm_unpacklo_epi8(highNibbles, lowNibbles), _mm_unpackhi_epi8(highNibbles, lowNibbles) };
+        for(size_t half = 0; half < 2; ++half)
+        {
+            const __m128i chars = _mm_add_epi8(_mm_add_epi8(nibbles[half], zeroChar),
+                _mm_and_si128(_mm_cmpgt_epi8(nibbles[half], nine), letterOffset));
+            str_view_detail::sse2_chars<sizeof(CharT)>::store16_bytes(dst + i * 2 + half * 16, chars);
+        }
+    }
+#endif
+    const char* const digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    for(; i < byte_count; ++i)
+    {
+        dst[i * 2] = (CharT)digits[src[i] >> 4];
+        dst[i * 2 + 1] = (CharT)digits[src[i] & 0x0F];
+    }
+    return byte_count * 2;
+}
+
+/*
+Decodes pairs of hexadecimal digits, case-insensitive, to bytes.
+*/
+template<typename CharT>
+inline size_t hex_decode(const str_view_template<CharT>& src, void* dst, size_t* out_error_pos = nullptr)
+{
+    const CharT* const str = src.data();
+    const size_t len = src.length();
+    unsigned char* const out = (unsigned char*)dst;
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    for(; i + 32 <= len; i += 32)
+    {
+        __m128i values[2];
+        bool valid = true;
+        for(size_t half = 0; half < 2 && valid; ++half)
+        {
+            const __m128i chars = str_view_detail::sse2_chars<sizeof(CharT)>::load16_bytes(str + i + half * 16);
+            const __m128i isDigit = str_view_detail::sse2_in_range(chars, '0', '9');
+            // Setting bit 0x20 turns 'A'-'F' into 'a'-'f' and no other characters into that range.
+            const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+            const __m128i isLetter = str_view_detail::sse2_in_range(lower, 'a', 'f');
+            valid = _mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) == 0xFFFF;
+            values[half] = _mm_or_si128(
+                _mm_and_si128(isDigit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+        }
+        // Let the scalar code find the invalid character.
+        if(!valid)
+            break;
+        // In each 16-bit lane, the low byte holds the high nibble.
+        const __m128i bytes0 = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(values[0], 4), _mm_set1_epi16(0x00F0)), _mm_srli_epi16(values[0], 8));
+        const __m128i bytes1 = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(values[1], 4), _mm_set1_epi16(0x00F0)), _mm_srli_epi16(values[1], 8));
+        _mm_storeu_si128((__m128i*)(out + i / 2), _mm_packus_epi16(bytes0, bytes1));
+    }
+#endif
+    for(; i < len; i += 2)
+    {
+        const int high = str_view_detail::hex_digit_value(str[i]);
+        const int low = i + 1 < len ? str_view_detail::hex_digit_value(str[i + 1]) : -1;
+        if(high < 0 || low < 0)
+        {
+            if(out_error_pos)
+                *out_error_pos = high < 0 ? i : i + 1;
+            return SIZE_MAX;
+        }
+        out[i / 2] = (unsigned char)((high << 4) | low);
+    }
+    return len / 2;
+}
+
+/*
+padding - whether to append '=' characters so that the length is a multiple of 4.
+*/
+inline size_t base64_encoded_length(size_t byte_count, bool padding = true)
+{
+    return padding ? (byte_count + 2) / 3 * 4 : byte_count / 3 * 4 + (byte_count % 3 ? byte_count % 3 + 1 : 0);
+}
+
+/*
+Returns exact number of bytes encoded in src, if it is valid base64, with or without padding.
+*/
+template<typename CharT>
+inline size_t base64_decoded_length(const str_view_template<CharT>& src)
+{
+    size_t len = src.length();
+    if(len % 4 == 0 && len > 0 && src.data()[len - 1] == (CharT)'=')
+        len -= src.data()[len - 2] == (CharT)'=' ? 2 : 1;
+    return len / 4 * 3 + (len % 4 == 0 ? 0 : len % 4 - 1);
+}
+
+/*
+url_safe - use '-' and '_' instead of '+' and '/', as defined in RFC 4648.
+Returns number of characters written.
+*/
+template<typename CharT>
+inline size_t base64_encode(const void* data, size_t byte_count, CharT* dst, bool url_safe = false, bool padding = true)
+{
+    const unsigned char* const src = (const unsigned char*)data;
+    CharT* out = dst;
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    const char char62 = url_safe ? '-' : '+';
+    const char char63 = url_safe ? '_' : '/';
+    const __m128i offset62 = _mm_set1_epi8((char)(char62 - ('0' + 10)));
+    const __m128i offset63 = _mm_set1_epi8((char)(char63 - char62 - 1));
+    // Each iteration reads 16 bytes and encodes the first 12 of them.
+    for(; i + 16 <= byte_count; i += 12, out += 16)
+    {
+        // Move 3-byte group k to the lowest bytes of 32-bit lane k, by shifting the vector left by k bytes.
+        const __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i x = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(bytes, _mm_set_epi32(0, 0, 0, -1)), _mm_and_si128(_mm_slli_si128(bytes, 1), _mm_set_epi32(0, 0, -1, 0))),
+            _mm_or_si128(_mm_and_si128(_mm_slli_si128(bytes, 2), _mm_set_epi32(0, -1, 0, 0)), _mm_and_si128(_mm_slli_si128(bytes, 3), _mm_set_epi32(-1, 0, 0, 0))));
+        // Split the 3 bytes of every lane into 4 6-bit values, one per byte.
+        __m128i indices = _mm_and_si128(_mm_srli_epi32(x, 2), _mm_set1_epi32(0x3F));
+        indices = _mm_or_si128(indices, _mm_and_si128(_mm_slli_epi32(x, 12), _mm_set1_epi32(0x3000)));
+        indices = _mm_or_si128(indices, _mm_and_si128(_mm_srli_epi32(x, 4), _mm_set1_epi32(0x0F00)));
+        indices = _mm_or_si128(indices, _mm_and_si128(_mm_slli_epi32(x, 10), _mm_set1_epi32(0x3C0000)));
+        indices = _mm_or_si128(indices, _mm_and_si128(_mm_srli_epi32(x, 6), _mm_set1_epi32(0x030000)));
+        indices = _mm_or_si128(indices, _mm_and_si128(_mm_slli_epi32(x, 8), _mm_set1_epi32(0x3F000000)));
+        // Translate to the alphabet by adding offsets of the ranges each index is in.
+        __m128i chars = _mm_add_epi8(indices, _mm_set1_epi8('A'));
+        chars = _mm_add_epi8(chars, _mm_and_si128(_mm_cmpgt_epi8(indices, _mm_set1_epi8(25)), _mm_set1_epi8('a' - 26 - 'A')));
+        chars = _mm_add_epi8(chars, _mm_and_si128(_mm_cmpgt_epi8(indices, _mm_set1_epi8(51)), _mm_set1_epi8('0' - 52 - ('a' - 26))));
+        chars = _mm_add_epi8(chars, _mm_and_si128(_mm_cmpgt_epi8(indices, _mm_set1_epi8(61)), offset62));
+        chars = _mm_add_epi8(chars, _mm_and_si128(_mm_cmpgt_epi8(indices, _mm_set1_epi8(62)), offset63));
+        str_view_detail::sse2_chars<sizeof(CharT)>::store16_bytes(out, chars);
+    }
+#endif
+    const char* const alphabet = str_view_detail::base64_alphabet(url_safe);
+    for(; i + 3 <= byte_count; i += 3, out += 4)
+    {
+        const uint32_t group = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1] << 8) | src[i + 2];
+        out[0] = (CharT)alphabet[group >> 18];
+        out[1] = (CharT)alphabet[(group >> 12) & 0x3F];
+        out[2] = (CharT)alphabet[(group >> 6) & 0x3F];
+        out[3] = (CharT)alphabet[group & 0x3F];
+    }
+    if(i < byte_count)
+    {
+        const uint32_t group = ((uint32_t)src[i] << 16) | (i + 1 < byte_count ? (uint32_t)src[i + 1] << 8 : 0);
+        *out++ = (CharT)alphabet[group >> 18];
+        *out++ = (CharT)alphabet[(group >> 12) & 0x3F];
+        if(i + 1 < byte_count)
+            *out++ = (CharT)alphabet[(group >> 6) & 0x3F];
+        else if(padding)
+            *out++ = (CharT)'=';
+        if(padding)
+            *out++ = (CharT)'=';
+    }
+    return out - dst;
+}
+
+/*
+Decodes base64 with or without padding. Padding, if present, must make the length a multiple of 4.
+url_safe - use '-' and '_' instead of '+' and '/', as defined in RFC 4648.
+*/
+template<typename CharT>
+inline size_t base64_decode(const str_view_template<CharT>& src, void* dst, bool url_safe = false, size_t* out_error_pos = nullptr)
+{
+    const CharT* const str = src.data();
+    const size_t len = src.length();
+    size_t dataLen = len;
+    if(len % 4 == 0 && len > 0 && str[len - 1] == (CharT)'=')
+        dataLen -= str[len - 2] == (CharT)'=' ? 2 : 1;
+    unsigned char* const outBegin = (unsigned char*)dst;
+    unsigned char* out = outBegin;
+    size_t i = 0;
+#if STR_VIEW_SSE2
+    const __m128i char62 = _mm_set1_epi8(url_safe ? '-' : '+');
+    const __m128i char63 = _mm_set1_epi8(url_safe ? '_' : '/');
+    for(; i + 16 <= dataLen; i += 16, out += 12)
+    {
+        const __m128i chars = str_view_detail::sse2_chars<sizeof(CharT)>::load16_bytes(str + i);
+        const __m128i isUpper = str_view_detail::sse2_in_range(chars, 'A', 'Z');
+        const __m128i isLower = str_view_detail::sse2_in_range(chars, 'a', 'z');
+        const __m128i isDigit = str_view_detail::sse2_in_range(chars, '0', '9');
+        const __m128i is62 = _mm_cmpeq_epi8(chars, char62);
+        const __m128i is63 = _mm_cmpeq_epi8(chars, char63);
+        const __m128i valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(isUpper, isLower), isDigit), _mm_or_si128(is62, is63));
+        // Let the scalar code find the invalid character.
+        if(_mm_movemask_epi8(valid) != 0xFFFF)
+            break;
+        __m128i x = _mm_and_si128(isUpper, _mm_sub_epi8(chars, _mm_set1_epi8('A')));
+        x = _mm_or_si128(x, _mm_and_si128(isLower, _mm_sub_epi8(chars, _mm_set1_epi8('a' - 26))));
+        x = _mm_or_si128(x, _mm_and_si128(isDigit, _mm_add_epi8(chars, _mm_set1_epi8(52 - '0'))));
+        x = _mm_or_si128(x, _mm_and_si128(is62, _mm_set1_epi8(62)));
+        x = _mm_or_si128(x, _mm_and_si128(is63, _mm_set1_epi8(63)));
+        // Every 32-bit lane has 4 6-bit values, one per byte. Combine them into 3 bytes in output order.
+        __m128i bytes = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(x, 2), _mm_set1_epi32(0xFC)), _mm_and_si128(_mm_srli_epi32(x, 12), _mm_set1_epi32(0x03)));
+        bytes = _mm_or_si128(bytes, _mm_and_si128(_mm_slli_epi32(x, 4), _mm_set1_epi32(0xF000)));
+        bytes = _mm_or_si128(bytes, _mm_and_si128(_mm_srli_epi32(x, 10), _mm_set1_epi32(0x0F00)));
+        bytes = _mm_or_si128(bytes, _mm_and_si128(_mm_slli_epi32(x, 6), _mm_set1_epi32(0xC00000)));
+        bytes = _mm_or_si128(bytes, _mm_and_si128(_mm_srli_epi32(x, 8), _mm_set1_epi32(0x3F0000)));
+        uint32_t groups[4];
+        _mm_storeu_si128((__m128i*)groups, bytes);
+        for(size_t k = 0; k < 4; ++k)
+            memcpy(out + k * 3, &groups[k], 3);
+    }
+#endif
+    uint32_t group = 0;
+    size_t groupLen = 0;
+    for(; i < dataLen; ++i)
+    {
+        const int value = str_view_detail::base64_char_value(str[i], url_safe);
+        if(value < 0)
+        {
+            if(out_error_pos)
+                *out_error_pos = i;
+            return SIZE_MAX;
+        }
+        group = (group << 6) | (uint32_t)value;
+        if(++groupLen == 4)
+        {
+            *out++ = (unsigned char)(group >> 16);
+            *out++ = (unsigned char)(group >> 8);
+            *out++ = (unsigned char)group;
+            group = 0;
+            groupLen = 0;
+        }
+    }
+    if(groupLen == 1)
+    {
+        if(out_error_pos)
+            *out_error_pos = dataLen;
+        return SIZE_MAX;
+    }
+    if(groupLen == 2)
+        *out++ = (unsigned char)(group >> 4);
+    else if(groupLen == 3)
+    {
+        *out++ = (unsigned char)(group >> 10);
+        *out++ = (unsigned char)(group >> 2);
+    }
+    return out - outBegin;
+}
+
+/*
+Read-only table of strings stored in a single flat image: an offset index followed by characters
+of all the strings, each followed by null. The image can be saved to a file and later attached
+from memory, e.g. from a memory-mapped file, so a large set of strings is available at startup
+without allocating or copying each of them. Returned views point into the image and know they
+are null-terminated, so their c_str() doesn't allocate.
+
+Optionally, the image also stores order of the strings sorted by their characters, which allows
+binary search with lower_bound() and find(). Strings are compared like with operator<, but
+without stopping at '\0'.
+
+The image uses native byte order and sizeof(CharT), so it is not portable between platforms that
+differ in these.
+*/
+template<typename CharT>
+class string_table_template
+{
+public:
+    inline string_table_template();
+
+    /*
+    Builds the table from given strings, which keep their order, so string i is available under index i.
+    Strings are copied, so they don't need to remain alive after the call. Duplicates are allowed.
+    If sorted_index is true, sorted order is also computed and stored in the image.
+    Previous contents are discarded. Returns false if there are too many strings.
+    */
+    inline bool build(const str_view_template<CharT>* strings, size_t count, bool sorted_index = false);
+    /*
+    Starts using an existing image, e.g. from a memory-mapped file, without copying it.
+    The memory must be aligned to 8 bytes and remain alive and unchanged as long as this object uses it.
+    Returns false if the image is invalid.
+    */
+    inline bool attach(const void* image, size_t imageSize);
+
+    /*
+    Returns the image that can be saved to a file.
+    It is valid until the object is destroyed or modified.
+    */
+    inline const void* image() const { return m_Image; }
+    inline size_t image_size() const { return m_ImageSize; }
+
+    // Returns the number of strings.
+    inline size_t size() const { return m_Count; }
+    inline bool empty() const { return m_Count == 0; }
+    // Returns the string stored under given index, as a null-terminated view into the image.
+    inline str_view_template<CharT> operator[](size_t index) const;
+
+    inline bool has_sorted_index() const { return m_Sorted != nullptr; }
+    /*
+    Returns index of the string that is at given position in sorted order.
+    Equal strings are ordered by their indices.
+    Requires has_sorted_index() == true.
+    */
+    inline size_t sorted_at(size_t position) const { assert(m_Sorted && position < m_Count); return m_Sorted[position]; }
+    /*
+    Returns the first position in sorted order whose string is not less than key, or size() if there is none.
+    Requires has_sorted_index() == true.
+    */
+    inline size_t lower_bound(const str_view_template<CharT>& key) const;
+    /*
+    Returns the lowest index of a string equal to key, or SIZE_MAX if there is none.
+    Requires has_sorted_index() == true.
+    */
+    inline size_t find(const str_view_template<CharT>& key) const;
+    inline bool contains(const str_view_template<CharT>& key) const { return find(key) != SIZE_MAX; }
+
+private:
+    static const uint32_t IMAGE_MAGIC = 0x54535653; // "SVST"
+    static const uint32_t IMAGE_VERSION = 1;
+    static const uint32_t FLAG_SORTED_INDEX = 0x1;
+
+    struct ImageHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t charSize;
+        uint32_t count;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t charCount;
+    };
+
+    // Owned image, if the table was built rather than attached.
+    std::vector<uint64_t> m_Storage;
+    const void* m_Image;
+    size_t m_ImageSize;
+    uint32_t m_Count;
+    // count + 1 elements. String i spans characters [m_Offsets[i], m_Offsets[i + 1] - 1), followed by null.
+    const uint64_t* m_Offsets;
+    // count elements, or null if there is no sorted index.
+    const uint32_t* m_Sorted;
+    const CharT* m_Chars;
+
+    string_table_template(const string_table_template<CharT>&) = delete;
+    string_table_template<CharT>& operator=(const string_table_template<CharT>&) = delete;
+
+    static size_t align8(size_t size) { return (size + 7) & ~(size_t)7; }
+    static inline int compare_chars(const CharT* lhs, size_t lhsLen, const CharT* rhs, size_t rhsLen)
+    {
+        const size_t minLen = std::min(lhsLen, rhsLen);
+        const int result = minLen ? std::char_traits<CharT>::compare(lhs, rhs, minLen) : 0;
+        if(result != 0)
+            return result;
+        return lhsLen < rhsLen ? -1 : lhsLen > rhsLen ? 1 : 0;
+    }
+    inline void reset();
+    inline bool setup_pointers(uint32_t count, bool sortedIndex, uint64_t charCount);
+};
+
+typedef string_table_template<char> string_table;
+typedef string_table_template<wchar_t> wstring_table;
+
+template<typename CharT>
+inline string_table_template<CharT>::string_table_template() :
+    m_Image(nullptr),
+    m_ImageSize(0),
+    m_Count(0),
+    m_Offsets(nullptr),
+    m_Sorted(nullptr),
+    m_Chars(nullptr)
+{
+}
+
+template<typename CharT>
+inline void string_table_template<CharT>::reset()
+{
+    m_Storage.clear();
+    m_Image = nullptr;
+    m_ImageSize = 0;
+    m_Count = 0;
+    m_Offsets = nullptr;
+    m_Sorted = nullptr;
+    m_Chars = nullptr;
+}
+
+template<typename CharT>
+inline bool string_table_template<CharT>::setup_pointers(uint32_t count, bool sortedIndex, uint64_t charCount)
+{
+    const size_t offsetsOffset = sizeof(ImageHeader);
+    const size_t sortedOffset = offsetsOffset + ((size_t)count + 1) * sizeof(uint64_t);
+    const size_t charsOffset = sortedOffset + (sortedIndex ? align8((size_t)count * sizeof(uint32_t)) : 0);
+    if(charsOffset > m_ImageSize || (m_ImageSize - charsOffset) / sizeof(CharT) < charCount)
+        return false;
+    const char* const bytes = (const char*)m_Image;
+    m_Count = count;
+    m_Offsets = (const uint64_t*)(bytes + offsetsOffset);
+    m_Sorted = sortedIndex ? (const uint32_t*)(bytes + sortedOffset) : nullptr;
+    m_Chars = (const CharT*)(bytes + charsOffset);
+    return true;
+}
+
+template<typename CharT>
+inline bool string_table_template<CharT>::build(const str_view_template<CharT>* strings, size_t count, bool sorted_index)
+{
+    reset();
+    if(count >= UINT32_MAX)
+        return false;
+    const uint32_t n = (uint32_t)count;
+    uint64_t charCount = 0;
+    for(uint32_t i = 0; i < n; ++i)
+        charCount += strings[i].length() + 1;
+    const size_t imageSize = sizeof(ImageHeader) + ((size_t)n + 1) * sizeof(uint64_t) +
+        (sorted_index ? align8((size_t)n * sizeof(uint32_t)) : 0) + align8((size_t)charCount * sizeof(CharT));
+    m_Storage.resize(imageSize / sizeof(uint64_t));
+    m_Image = m_Storage.data();
+    m_ImageSize = imageSize;
+
+    ImageHeader* const header = (ImageHeader*)m_Storage.data();
+    header->magic = IMAGE_MAGIC;
+    header->version = IMAGE_VERSION;
+    header->charSize = (uint32_t)sizeof(CharT);
+    header->count = n;
+    header->flags = sorted_index ? FLAG_SORTED_INDEX : 0;
+    header->reserved = 0;
+    header->charCount = charCount;
+    setup_pointers(n, sorted_index, charCount);
+
+    uint64_t* const offsets = (uint64_t*)m_Offsets;
+    CharT* const chars = (CharT*)m_Chars;
+    uint64_t charIndex = 0;
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        offsets[i] = charIndex;
+        if(!strings[i].empty())
+            charIndex += strings[i].copy_to(chars + charIndex);
+        chars[charIndex++] = (CharT)0;
+    }
+    offsets[n] = charIndex;
+
+    if(sorted_index)
+    {
+        uint32_t* const sorted = (uint32_t*)m_Sorted;
+        for(uint32_t i = 0; i < n; ++i)
+            sorted[i] = i;
+        // Sorting the copies in the image, which have known lengths, is faster than through the views.
+        std::stable_sort(sorted, sorted + n, [&](uint32_t lhs, uint32_t rhs) {
+            return compare_chars(chars + offsets[lhs], (size_t)(offsets[lhs + 1] - offsets[lhs] - 1),
+                chars + offsets[rhs], (size_t)(offsets[rhs + 1] - offsets[rhs] - 1)) < 0; });
+    }
+    return true;
+}
+
+template<typename CharT>
+inline bool string_table_template<CharT>::attach(const void* image, size_t imageSize)
+{
+    reset();
+    if(image == nullptr || ((uintptr_t)image & 7) != 0 || imageSize < sizeof(ImageHeader))
+        return false;
+    const ImageHeader* const header = (const ImageHeader*)image;
+    if(header->magic != IMAGE_MAGIC || header->version != IMAGE_VERSION ||
+        header->charSize != sizeof(CharT) || header->count == UINT32_MAX ||
+        (header->flags & ~FLAG_SORTED_INDEX) != 0)
+        return false;
+    m_Image = image;
+    m_ImageSize = imageSize;
+    if(!setup_pointers(header->count, (header->flags & FLAG_SORTED_INDEX) != 0, header->charCount) ||
+        m_Offsets[0] != 0 || m_Offsets[m_Count] != header->charCount)
+    {
+        reset();
+        return false;
+    }
+    // Every string must be inside the characters and followed by null, and the sorted index must
+    // contain valid indices, as other methods don't check it. Order of the sorted index is not checked.
+    for(uint32_t i = 0; i < m_Count; ++i)
+    {
+        const uint64_t end = m_Offsets[i + 1];
+        if(end <= m_Offsets[i] || end > header->charCount || m_Chars[end - 1] != (CharT)0 ||
+            (m_Sorted != nullptr && m_Sorted[i] >= m_Count))
+        {
+            reset();
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename CharT>
+inline str_view_template<CharT> string_table_template<CharT>::operator[](size_t index) const
+{
+    assert(index < m_Count);
+    const uint64_t offset = m_Offsets[index];
+    return str_view_template<CharT>(m_Chars + offset, (size_t)(m_Offsets[index + 1] - offset - 1),
+        typename str_view_template<CharT>::StillNullTerminated());
+}
+
+template<typename CharT>
+inline size_t string_table_template<CharT>::lower_bound(const str_view_template<CharT>& key) const
+{
+    assert(m_Sorted != nullptr);
+    const size_t keyLen = key.length();
+    const CharT* const keyChars = keyLen ? key.data() : nullptr;
+    size_t first = 0, count = m_Count;
+    while(count > 0)
+    {
+        const size_t step = count / 2;
+        const uint32_t index = m_Sorted[first + step];
+        const uint64_t offset = m_Offsets[index];
+        if(compare_chars(m_Chars + offset, (size_t)(m_Offsets[index + 1] - offset - 1), keyChars, keyLen) < 0)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    return first;
+}
+
+template<typename CharT>
+inline size_t string_table_template<CharT>::find(const str_view_template<CharT>& key) const
+{
+    const size_t position = lower_bound(key);
+    if(position == m_Count)
+        return SIZE_MAX;
+    const uint32_t index = m_Sorted[position];
+    const uint64_t offset = m_Offsets[index];
+    const size_t keyLen = key.length();
+    if(m_Offsets[index + 1] - offset - 1 != keyLen ||
+        (keyLen && memcmp(m_Chars + offset, key.data(), keyLen * sizeof(CharT)) != 0))
+        return SIZE_MAX;
+    return index;
+}
+
+/*
+Escaping and unescaping of C string literals, JSON strings and percent-encoded text, e.g. in URLs.
+
+Most strings contain nothing to escape or unescape, so each function first scans the input, 16
+characters at a time with SSE2 when available. If nothing needs to change, it returns the input
+view itself, which stays null-terminated if it was, and doesn't touch the buffer. Otherwise, the
+result is written to the buffer provided by the caller, which can be reused between calls to avoid
+allocations, and the returned view points to it and is null-terminated.
+
+Escape sequences that stand for code points are encoded as UTF-8 for char and as UTF-16 or UTF-32
+for wchar_t, depending on its size. Percent-encoding always encodes UTF-8 bytes, so for wchar_t
+they are decoded to and encoded from code points.
+
+Unescape functions return false if the input contains an invalid escape sequence. Then dst is not
+modified and, if out_error_pos is not null, it receives position of the first character of the sequence.
+*/
+
+/*
+Decodes escape sequences of C string literals: \n \t \r \a \b \f \v \\ \' \" \?, 1 to 3 octal digits
+and \x followed by up to 2 * sizeof(CharT) hexadecimal digits - giving value of a single character,
+\u followed by 4 and \U followed by 8 hexadecimal digits - giving a code point.
+*/
+template<typename CharT>
+inline bool unescape_c(const str_view_template<CharT>& src, str_view_template<CharT>& dst,
+    std::basic_string<CharT>& buffer, size_t* out_error_pos = nullptr)
+{
+    const size_t len = src.length();
+    const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_BACKSLASH>(src.data(), len) : 0;
+    if(first == len)
+    {
+        dst = src;
+        return true;
+    }
+    const size_t errorPos = str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_BACKSLASH>(
+        src.data(), len, first, buffer, str_view_detail::unescape_c_sequence<CharT>);
+    if(errorPos != SIZE_MAX)
+    {
+        if(out_error_pos)
+            *out_error_pos = errorPos;
+        return false;
+    }
+    dst = str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+    return true;
+}
+
+/*
+Decodes escape sequences of JSON strings: \" \\ \/ \b \f \n \r \t and \u followed by 4 hexadecimal
+digits, where surrogate pairs must be escaped as two consecutive sequences.
+Quotes around the string are not expected, and characters that JSON requires to be escaped are not validated.
+*/
+template<typename CharT>
+inline bool unescape_json(const str_view_template<CharT>& src, str_view_template<CharT>& dst,
+    std::basic_string<CharT>& buffer, size_t* out_error_pos = nullptr)
+{
+    const size_t len = src.length();
+    const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_BACKSLASH>(src.data(), len) : 0;
+    if(first == len)
+    {
+        dst = src;
+        return true;
+    }
+    const size_t errorPos = str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_BACKSLASH>(
+        src.data(), len, first, buffer, str_view_detail::unescape_json_sequence<CharT>);
+    if(errorPos != SIZE_MAX)
+    {
+        if(out_error_pos)
+            *out_error_pos = errorPos;
+        return false;
+    }
+    dst = str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+    return true;
+}
+
+/*
+Decodes percent-encoded bytes: % followed by 2 hexadecimal digits.
+If plus_as_space is true, also decodes + as space, like in HTML form data.
+For wchar_t, bytes that are not ASCII must form valid UTF-8 sequences.
+*/
+template<typename CharT>
+inline bool unescape_percent(const str_view_template<CharT>& src, str_view_template<CharT>& dst,
+    std::basic_string<CharT>& buffer, bool plus_as_space = false, size_t* out_error_pos = nullptr)
+{
+    const size_t len = src.length();
+    size_t errorPos = SIZE_MAX;
+    if(plus_as_space)
+    {
+        const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_PERCENT_PLUS>(src.data(), len) : 0;
+        if(first == len)
+        {
+            dst = src;
+            return true;
+        }
+        errorPos = str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_PERCENT_PLUS>(
+            src.data(), len, first, buffer, str_view_detail::unescape_percent_sequence<CharT>);
+    }
+    else
+    {
+        const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_PERCENT>(src.data(), len) : 0;
+        if(first == len)
+        {
+            dst = src;
+            return true;
+        }
+        errorPos = str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_PERCENT>(
+            src.data(), len, first, buffer, str_view_detail::unescape_percent_sequence<CharT>);
+    }
+    if(errorPos != SIZE_MAX)
+    {
+        if(out_error_pos)
+            *out_error_pos = errorPos;
+        return false;
+    }
+    dst = str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+    return true;
+}
+
+/*
+Escapes the string for a C string literal: backslash, double quote, and control characters,
+using named sequences like \n where they exist and 3 octal digits otherwise.
+Characters above 127 are not escaped.
+*/
+template<typename CharT>
+inline str_view_template<CharT> escape_c(const str_view_template<CharT>& src, std::basic_string<CharT>& buffer)
+{
+    const size_t len = src.length();
+    const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_C>(src.data(), len) : 0;
+    if(first == len)
+        return src;
+    str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_C>(src.data(), len, first, buffer, str_view_detail::escape_c_char<CharT>);
+    return str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+Escapes the string for a JSON string: backslash, double quote, and control characters,
+using named sequences like \n where they exist and \u00XX otherwise.
+Characters above 127 are not escaped.
+*/
+template<typename CharT>
+inline str_view_template<CharT> escape_json(const str_view_template<CharT>& src, std::basic_string<CharT>& buffer)
+{
+    const size_t len = src.length();
+    const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_JSON>(src.data(), len) : 0;
+    if(first == len)
+        return src;
+    str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_JSON>(src.data(), len, first, buffer, str_view_detail::escape_json_char<CharT>);
+    return str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+Percent-encodes all characters except unreserved ones: letters, digits, - . _ ~
+Wide characters are encoded as UTF-8, with invalid ones replaced by U+FFFD.
+*/
+template<typename CharT>
+inline str_view_template<CharT> escape_percent(const str_view_template<CharT>& src, std::basic_string<CharT>& buffer)
+{
+    const size_t len = src.length();
+    const size_t first = len ? str_view_detail::find_escape_scan<str_view_detail::ESCAPE_SCAN_URL>(src.data(), len) : 0;
+    if(first == len)
+        return src;
+    str_view_detail::process_escape_scan<str_view_detail::ESCAPE_SCAN_URL>(src.data(), len, first, buffer, str_view_detail::escape_percent_char<CharT>);
+    return str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+Replaces occurrences of many patterns at once, e.g. tokens of a template or secrets to redact.
+It is built once from pairs of patterns and replacements, then finds the patterns in a forward pass
+over the input using Aho-Corasick automaton.
+
+Matches don't overlap. When multiple patterns match, the one that starts first wins,
+and among them the longest one. To know that a match is the longest, the automaton may read past
+its end while a longer pattern could still start at the same position. After a match is found,
+the search continues from its end, so these characters are read again. Their number is less than
+the length of the longest pattern, so the time is O(n + matchCount * maxPatternLength).
+E.g. patterns "a" and "aaaab" make every character of "aaaa..." read 5 times.
+The result is computed in two passes: the first one counts
+its length, so the output is allocated exactly once, and the second one writes it.
+Patterns and replacements are copied, so they don't need to remain alive after build().
+*/
+template<typename CharT>
+class multi_replacer_template
+{
+public:
+    inline multi_replacer_template();
+
+    /*
+    Builds the replacer from count patterns and their replacements. Previous contents are discarded.
+    If the same pattern is given multiple times, the first one is used.
+    Returns false if any pattern is empty.
+    */
+    inline bool build(const str_view_template<CharT>* patterns, const str_view_template<CharT>* replacements, size_t count);
+
+    // Returns the number of patterns.
+    inline size_t size() const { return m_PatternLengths.size(); }
+    inline bool empty() const { return m_PatternLengths.empty(); }
+
+    // Returns number of replacements that would be made in src.
+    inline size_t count(const str_view_template<CharT>& src) const;
+    // Returns length of the result of replacing src, not including null terminator.
+    inline size_t replaced_length(const str_view_template<CharT>& src) const;
+
+    /*
+    Writes the result of replacing src to dst, followed by null terminator.
+    dst must have room for replaced_length(src) + 1 characters and must not overlap src.
+    Returns view of dst.
+    */
+    inline str_view_template<CharT> replace_into(const str_view_template<CharT>& src, CharT* dst) const;
+    /*
+    Returns the result of replacing src. If no pattern occurs in src, returns src itself,
+    otherwise the result is stored in buffer, which is resized once.
+    */
+    inline str_view_template<CharT> replace(const str_view_template<CharT>& src, std::basic_string<CharT>& buffer) const;
+    /*
+    Streams the result of replacing src to sink, called as sink(const CharT* ptr, size_t len)
+    for every piece of the result, in order. Pieces point into src or into this object.
+    */
+    template<typename SinkT>
+    inline void replace_to(const str_view_template<CharT>& src, SinkT sink) const;
+
+private:
+    static const uint32_t ROOT = 0;
+    static const uint32_t NO_PATTERN = UINT32_MAX;
+    static const size_t ROOT_TABLE_SIZE = 256;
+
+    // Per state: range of its edges [m_EdgeBegin[s], m_EdgeBegin[s + 1]) in m_EdgeChars, m_EdgeTargets, sorted by character.
+    std::vector<uint32_t> m_EdgeBegin;
+    std::vector<CharT> m_EdgeChars;
+    std::vector<uint32_t> m_EdgeTargets;
+    // Per state: failure link - the state of its longest proper suffix that is also in the trie.
+    std::vector<uint32_t> m_Fail;
+    std::vector<uint32_t> m_Depth;
+    // Per state: index of the longest pattern that is a suffix of the state, or NO_PATTERN.
+    std::vector<uint32_t> m_Output;
+    // Transitions of the root for characters below ROOT_TABLE_SIZE, ROOT if there is no edge.
+    uint32_t m_RootTable[ROOT_TABLE_SIZE];
+    // If all patterns start with the same character, it's searched with find_char from the root.
+    bool m_SingleFirstChar;
+    CharT m_FirstChar;
+    std::vector<size_t> m_PatternLengths;
+    // Replacement i spans characters [m_ReplacementOffsets[i], m_ReplacementOffsets[i + 1]) of m_ReplacementChars.
+    std::vector<size_t> m_ReplacementOffsets;
+    std::basic_string<CharT> m_ReplacementChars;
+
+    inline uint32_t next_state(uint32_t state, CharT ch) const;
+    // Returns position of the first character in str[pos, len) that begins any pattern, or len if none.
+    inline size_t skip_to_pattern_start(const CharT* str, size_t len, size_t pos) const;
+    // Calls func(pos, patternIndex) for every replaced match, in order.
+    template<typename FuncT>
+    inline void for_each_match(const CharT* str, size_t len, FuncT func) const;
+    inline const CharT* replacement(size_t index) const { return m_ReplacementChars.data() + m_ReplacementOffsets[index]; }
+    inline size_t replacement_length(size_t index) const { return m_ReplacementOffsets[index + 1] - m_ReplacementOffsets[index]; }
+};
+
+typedef multi_replacer_template<char> multi_replacer;
+typedef multi_replacer_template<wchar_t> wmulti_replacer;
+
+template<typename CharT>
+inline multi_replacer_template<CharT>::multi_replacer_template()
+{
+    build(nullptr, nullptr, 0);
+}
+
+template<typename CharT>
+inline bool multi_replacer_template<CharT>::build(const str_view_template<CharT>* patterns,
+    const str_view_template<CharT>* replacements, size_t count)
+{
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    m_PatternLengths.clear();
+    m_ReplacementOffsets.assign(1, 0);
+    m_ReplacementChars.clear();
+
+    // Trie with edges kept sorted in temporary per-state lists.
+    std::vector<std::vector<std::pair<CharT, uint32_t>>> edges(1);
+    std::vector<uint32_t> terminal(1, (uint32_t)NO_PATTERN);
+    std::vector<uint32_t> depth(1, 0);
+    bool success = true;
+    for(size_t patternIndex = 0; patternIndex < count; ++patternIndex)
+    {
+        const str_view_template<CharT>& pattern = patterns[patternIndex];
+        const size_t patternLen = pattern.length();
+        if(patternLen == 0)
+        {
+            success = false;
+            break;
+        }
+        uint32_t state = ROOT;
+        for(size_t i = 0; i < patternLen; ++i)
+        {
+            const CharT ch = pattern.data()[i];
+            std::vector<std::pair<CharT, uint32_t>>& stateEdges = edges[state];
+            const auto it = std::lower_bound(stateEdges.begin(), stateEdges.end(), ch,
+                [](const std::pair<CharT, uint32_t>& edge, CharT c) { return edge.first < c; });
+            if(it != stateEdges.end() && it->first == ch)
+                state = it->second;
+            else
+            {
+                const uint32_t newState = (uint32_t)edges.size();
+                stateEdges.insert(it, std::make_pair(ch, newState));
+                edges.emplace_back();
+                terminal.push_back((uint32_t)NO_PATTERN);
+                depth.push_back(depth[state] + 1);
+                state = newState;
+            }
+        }
+        if(terminal[state] == NO_PATTERN)
+            terminal[state] = (uint32_t)patternIndex;
+        m_PatternLengths.push_back(patternLen);
+        const str_view_template<CharT>& repl = replacements[patternIndex];
+        m_ReplacementChars.append(repl.data(), repl.length());
+        m_ReplacementOffsets.push_back(m_ReplacementChars.length());
+    }
+    if(!success)
+    {
+        build(nullptr, nullptr, 0);
+        return false;
+    }
+
+    const uint32_t stateCount = (uint32_t)edges.size();
+    m_EdgeBegin.resize(stateCount + 1);
+    m_EdgeChars.clear();
+    m_EdgeTargets.clear();
+    for(uint32_t state = 0; state < stateCount; ++state)
+    {
+        m_EdgeBegin[state] = (uint32_t)m_EdgeChars.size();
+        for(const auto& edge : edges[state])
+        {
+            m_EdgeChars.push_back(edge.first);
+            m_EdgeTargets.push_back(edge.second);
+        }
+    }
+    m_EdgeBegin[stateCount] = (uint32_t)m_EdgeChars.size();
+    m_Depth = std::move(depth);
+
+    for(size_t i = 0; i < ROOT_TABLE_SIZE; ++i)
+        m_RootTable[i] = ROOT;
+    for(const auto& edge : edges[ROOT])
+    {
+        if((size_t)(UCharT)edge.first < ROOT_TABLE_SIZE)
+            m_RootTable[(UCharT)edge.first] = edge.second;
+    }
+    m_SingleFirstChar = edges[ROOT].size() == 1;
+    m_FirstChar = m_SingleFirstChar ? edges[ROOT][0].first : (CharT)0;
+
+    // Failure links and outputs in breadth-first order, so they are known for all shallower states.
+    m_Fail.assign(stateCount, (uint32_t)ROOT);
+    m_Output.assign(stateCount, (uint32_t)NO_PATTERN);
+    std::vector<uint32_t> queue;
+    queue.reserve(stateCount);
+    queue.push_back((uint32_t)ROOT);
+    for(size_t queueIndex = 0; queueIndex < queue.size(); ++queueIndex)
+    {
+        const uint32_t state = queue[queueIndex];
+        for(const auto& edge : edges[state])
+        {
+            const uint32_t target = edge.second;
+            m_Fail[target] = state == ROOT ? ROOT : next_state(m_Fail[state], edge.first);
+            m_Output[target] = terminal[target] != NO_PATTERN ? terminal[target] : m_Output[m_Fail[target]];
+            queue.push_back(target);
+        }
+    }
+    return true;
+}
+
+template<typename CharT>
+inline uint32_t multi_replacer_template<CharT>::next_state(uint32_t state, CharT ch) const
+{
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    for(;;)
+    {
+        if(state == ROOT && (size_t)(UCharT)ch < ROOT_TABLE_SIZE)
+            return m_RootTable[(UCharT)ch];
+        const CharT* const begin = m_EdgeChars.data() + m_EdgeBegin[state];
+        const CharT* const end = m_EdgeChars.data() + m_EdgeBegin[state + 1];
+        const CharT* const it = std::lower_bound(begin, end, ch);
+        if(it != end && *it == ch)
+            return m_EdgeTargets[it - m_EdgeChars.data()];
+        if(state == ROOT)
+            return ROOT;
+        state = m_Fail[state];
+    }
+}
+
+template<typename CharT>
+inline size_t multi_replacer_template<CharT>::skip_to_pattern_start(const CharT* str, size_t len, size_t pos) const
+{
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    if(m_SingleFirstChar)
+    {
+        if(pos >= len)
+            return len;
+        const size_t index = str_view_detail::find_char(str + pos, len - pos, m_FirstChar);
+        return index != SIZE_MAX ? pos + index : len;
+    }
+    for(; pos < len; ++pos)
+    {
+        const UCharT ch = (UCharT)str[pos];
+        if((size_t)ch >= ROOT_TABLE_SIZE || m_RootTable[ch] != ROOT)
+            break;
+    }
+    return pos;
+}
+
+template<typename CharT>
+template<typename FuncT>
+inline void multi_replacer_template<CharT>::for_each_match(const CharT* str, size_t len, FuncT func) const
+{
+    if(m_PatternLengths.empty())
+        return;
+    // Leftmost-longest match found so far, which may still be extended by a longer one starting at the same place.
+    size_t bestPos = SIZE_MAX, bestPattern = 0;
+    uint32_t state = ROOT;
+    size_t i = 0;
+    while(i < len || bestPos != SIZE_MAX)
+    {
+        if(state == ROOT && bestPos == SIZE_MAX)
+        {
+            i = skip_to_pattern_start(str, len, i);
+            if(i == len)
+                break;
+        }
+        if(i < len)
+        {
+            state = next_state(state, str[i]);
+            // Earliest position where a match may still start. If it's past the best match, that one is final.
+            const size_t liveStart = i + 1 - m_Depth[state];
+            if(bestPos == SIZE_MAX || liveStart <= bestPos)
+            {
+                const uint32_t pattern = m_Output[state];
+                if(pattern != NO_PATTERN)
+                {
+                    const size_t pos = i + 1 - m_PatternLengths[pattern];
+                    if(bestPos == SIZE_MAX || pos <= bestPos)
+                    {
+                        bestPos = pos;
+                        bestPattern = pattern;
+                    }
+                }
+                ++i;
+                continue;
+            }
+        }
+        func(bestPos, bestPattern);
+        // Continue after the match from the root, so matches don't overlap. Characters already read
+    // past its end are read again, which is bounded by the length of the longest pattern.
+        i = bestPos + m_PatternLengths[bestPattern];
+        bestPos = SIZE_MAX;
+        state = ROOT;
+    }
+}
+
+template<typename CharT>
+inline size_t multi_replacer_template<CharT>::count(const str_view_template<CharT>& src) const
+{
+    size_t result = 0;
+    for_each_match(src.data(), src.length(), [&](size_t, size_t) { ++result; });
+    return result;
+}
+
+template<typename CharT>
+inline size_t multi_replacer_template<CharT>::replaced_length(const str_view_template<CharT>& src) const
+{
+    size_t result = src.length();
+    for_each_match(src.data(), src.length(), [&](size_t, size_t pattern)
+    {
+        result = result - m_PatternLengths[pattern] + replacement_length(pattern);
+    });
+    return result;
+}
+
+template<typename CharT>
+template<typename SinkT>
+inline void multi_replacer_template<CharT>::replace_to(const str_view_template<CharT>& src, SinkT sink) const
+{
+    const CharT* const str = src.data();
+    const size_t len = src.length();
+    size_t copiedEnd = 0;
+    for_each_match(str, len, [&](size_t pos, size_t pattern)
+    {
+        if(pos > copiedEnd)
+            sink(str + copiedEnd, pos - copiedEnd);
+        if(replacement_length(pattern))
+            sink(replacement(pattern), replacement_length(pattern));
+        copiedEnd = pos + m_PatternLengths[pattern];
+    });
+    if(len > copiedEnd)
+        sink(str + copiedEnd, len - copiedEnd);
+}
+
+template<typename CharT>
+inline str_view_template<CharT> multi_replacer_template<CharT>::replace_into(const str_view_template<CharT>& src, CharT* dst) const
+{
+    CharT* out = dst;
+    replace_to(src, [&](const CharT* ptr, size_t count)
+    {
+        memcpy(out, ptr, count * sizeof(CharT));
+        out += count;
+    });
+    *out = (CharT)0;
+    return str_view_template<CharT>(dst, (size_t)(out - dst), typename str_view_template<CharT>::StillNullTerminated());
+}
+
+template<typename CharT>
+inline str_view_template<CharT> multi_replacer_template<CharT>::replace(const str_view_template<CharT>& src, std::basic_string<CharT>& buffer) const
+{
+    size_t matchCount = 0;
+    size_t resultLen = src.length();
+    for_each_match(src.data(), src.length(), [&](size_t, size_t pattern)
+    {
+        ++matchCount;
+        resultLen = resultLen - m_PatternLengths[pattern] + replacement_length(pattern);
+    });
+    if(matchCount == 0)
+        return src;
+    buffer.resize(resultLen);
+    // Writing the terminator at buffer[resultLen] is allowed, as it's the null character.
+    return replace_into(src, &buffer[0]);
+}
+
+/*
+Number of characters sufficient for any number written by format_integer or format_float,
+including null terminator.
+*/
+const size_t format_buffer_size = 32;
+
+/*
+Writes decimal representation of integer value to dst, followed by null terminator, without allocating memory.
+dst must have room for format_buffer_size characters.
+Returns view of dst, which has known length and is null-terminated.
+*/
+template<typename CharT, typename IntT>
+inline str_view_template<CharT> format_integer(IntT value, CharT* dst)
+{
+    static_assert(std::is_integral<IntT>::value, "format_integer requires integer type.");
+    size_t len = 0;
+    uint64_t magnitude = (uint64_t)value;
+    if(std::is_signed<IntT>::value && value < (IntT)0)
+    {
+        dst[len++] = (CharT)'-';
+        magnitude = 0 - magnitude;
+    }
+    len += str_view_detail::write_decimal(magnitude, dst + len);
+    dst[len] = (CharT)0;
+    return str_view_template<CharT>(dst, len, typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+Writes the shortest representation of float or double value that parses back to the same value,
+like std::to_chars, followed by null terminator, without allocating memory. Decimal separator is
+always '.', regardless of locale. Infinity and NaN are written as "inf", "-inf", "nan".
+dst must have room for format_buffer_size characters.
+Returns view of dst, which has known length and is null-terminated.
+
+If STR_VIEW_CPP17 is enabled and the standard library has std::to_chars for floating-point types,
+it is used. Otherwise the value is printed with increasing precision until it round-trips.
+*/
+template<typename CharT, typename FloatT>
+inline str_view_template<CharT> format_float(FloatT value, CharT* dst)
+{
+    static_assert(std::is_same<FloatT, float>::value || std::is_same<FloatT, double>::value,
+        "format_float requires float or double.");
+    char narrow[format_buffer_size];
+    const size_t len = str_view_detail::write_float(value, narrow);
+    for(size_t i = 0; i <= len; ++i)
+        dst[i] = (CharT)narrow[i];
+    return str_view_template<CharT>(dst, len, typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+Fixed-capacity buffer for formatting a number without allocating memory, using format_integer
+or format_float, depending on the type of the value.
+Returned view points into this object, so it is valid until the object is destroyed
+or formats another number.
+*/
+template<typename CharT>
+class format_buffer_template
+{
+public:
+    template<typename T>
+    inline str_view_template<CharT> format(T value) { return format(value, typename std::is_floating_point<T>::type()); }
+
+private:
+    CharT m_Chars[format_buffer_size];
+
+    template<typename T>
+    inline str_view_template<CharT> format(T value, std::true_type) { return format_float(value, m_Chars); }
+    template<typename T>
+    inline str_view_template<CharT> format(T value, std::false_type) { return format_integer(value, m_Chars); }
+};
+
+typedef format_buffer_template<char> format_buffer;
+typedef format_buffer_template<wchar_t> wformat_buffer;
+
+/*
+Precompiled case-insensitive search for the same substring in many strings.
+The needle is folded once with TraitsT, simple_ci_traits by default, and searched strings are folded
+on the fly, 16 bytes at a time, like in str_view_template::find() with case_sensitive = false,
+so no copies are made.
+*/
+template<typename CharT, typename TraitsT = simple_ci_traits<CharT>>
+class ci_searcher_template
+{
+public:
+    // The needle is copied, so it doesn't need to remain alive.
+    inline explicit ci_searcher_template(const str_view_template<CharT>& needle = str_view_template<CharT>());
+
+    // Returns the needle after folding.
+    inline str_view_template<CharT> folded_needle() const { return str_view_template<CharT>(m_Folded); }
+
+    /*
+    Finds the first occurrence of the needle in str, starting at pos.
+    Returns its position, or SIZE_MAX if not found. If the needle is empty, returns pos.
+    */
+    inline size_t find(const str_view_template<CharT>& str, size_t pos = 0) const;
+    /*
+    Finds the last occurrence of the needle in str that starts at or before pos.
+    Returns its position, or SIZE_MAX if not found. If the needle is empty, returns pos.
+    */
+    inline size_t rfind(const str_view_template<CharT>& str, size_t pos = SIZE_MAX) const;
+    inline bool contains(const str_view_template<CharT>& str) const { return find(str) != SIZE_MAX; }
+    // Returns number of non-overlapping occurrences of the needle in str. If the needle is empty, returns 0.
+    inline size_t count(const str_view_template<CharT>& str) const;
+
+private:
+    std::basic_string<CharT> m_Folded;
+
+    inline bool verify(const CharT* candidate) const
+    {
+        const size_t needleLen = m_Folded.length();
+        return needleLen <= 2 || str_view_detail::equal_to_folded<TraitsT>(candidate + 1, m_Folded.data() + 1, needleLen - 2);
+    }
+};
+
+typedef ci_searcher_template<char> ci_searcher;
+typedef ci_searcher_template<wchar_t> wci_searcher;
+
+template<typename CharT, typename TraitsT>
+inline ci_searcher_template<CharT, TraitsT>::ci_searcher_template(const str_view_template<CharT>& needle) :
+    m_Folded(needle.data(), needle.length())
+{
+    for(size_t i = 0; i < m_Folded.length(); ++i)
+        m_Folded[i] = TraitsT::fold(m_Folded[i]);
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t ci_searcher_template<CharT, TraitsT>::find(const str_view_template<CharT>& str, size_t pos) const
+{
+    const size_t needleLen = m_Folded.length();
+    if(needleLen == 0)
+        return pos;
+    const size_t strLen = str.length();
+    if(strLen < needleLen || pos > strLen - needleLen)
+        return SIZE_MAX;
+    const CharT* const hay = str.data() + pos;
+    const size_t index = str_view_detail::find_folded_first_last<TraitsT>(hay, strLen - pos, needleLen,
+        m_Folded.front(), m_Folded.back(), [&](size_t candidate) { return verify(hay + candidate); });
+    return index != SIZE_MAX ? pos + index : SIZE_MAX;
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t ci_searcher_template<CharT, TraitsT>::rfind(const str_view_template<CharT>& str, size_t pos) const
+{
+    const size_t needleLen = m_Folded.length();
+    if(needleLen == 0)
+        return pos;
+    const size_t strLen = str.length();
+    if(strLen < needleLen)
+        return SIZE_MAX;
+    const CharT* const hay = str.data();
+    return str_view_detail::rfind_folded_first_last<TraitsT>(hay, std::min(pos, strLen - needleLen) + needleLen, needleLen,
+        m_Folded.front(), m_Folded.back(), [&](size_t candidate) { return verify(hay + candidate); });
+}
+
+template<typename CharT, typename TraitsT>
+inline size_t ci_searcher_template<CharT, TraitsT>::count(const str_view_template<CharT>& str) const
+{
+    const size_t needleLen = m_Folded.length();
+    if(needleLen == 0)
+        return 0;
+    size_t result = 0;
+    for(size_t pos = find(str); pos != SIZE_MAX; pos = find(str, pos + needleLen))
+        ++result;
+    return result;
+}
+
+/*
+Inverted index of trigrams - sequences of 3 consecutive characters - of a collection of strings,
+e.g. millions of log lines pointing into a memory-mapped file, for substring queries.
+A query looks up posting lists of its trigrams, intersects them to get candidate strings,
+and confirms only these with find(), instead of searching all the strings.
+
+Posting lists store sorted string indices as differences encoded with variable number of bytes.
+Trigrams of wchar_t strings are hashed to 32 bits, so collisions only add candidates.
+The strings are not copied - they must remain alive and unchanged as long as the index is used.
+*/
+template<typename CharT>
+class trigram_index_template
+{
+public:
+    /*
+    Builds the index of count strings. Previous contents are discarded.
+    Strings are processed in batches by multiple threads. thread_count - 0 means
+    std::thread::hardware_concurrency().
+    Returns false if there are too many strings.
+    */
+    inline bool build(const str_view_template<CharT>* strings, size_t count, uint32_t thread_count = 0);
+
+    // Returns the number of indexed strings.
+    inline size_t size() const { return m_Strings.size(); }
+    inline bool empty() const { return m_Strings.empty(); }
+    inline const str_view_template<CharT>& operator[](size_t index) const { return m_Strings[index]; }
+    // Returns the number of distinct trigrams.
+    inline size_t trigram_count() const { return m_Keys.size(); }
+    // Returns the size of all posting lists in bytes.
+    inline size_t posting_bytes() const { return m_Postings.size(); }
+
+    /*
+    Returns index of the first string that contains query, or SIZE_MAX if none does.
+    Queries shorter than 3 characters have no trigrams, so they search all the strings.
+    */
+    inline size_t find_first(const str_view_template<CharT>& query) const;
+    // Fills outIndices with indices of all the strings that contain query, in ascending order.
+    // Returns true if any does.
+    inline bool find_all(const str_view_template<CharT>& query, std::vector<size_t>& outIndices) const;
+    inline bool contains(const str_view_template<CharT>& query) const { return find_first(query) != SIZE_MAX; }
+
+private:
+    static const size_t BATCH_SIZE = 512;
+    // Number of bits of key sorted in one pass of radix sort.
+    static const uint32_t RADIX_BITS = 12;
+    static const uint32_t KEY_BITS = sizeof(CharT) == 1 ? 24 : 32;
+    // Number of key ranges into which posting lists are merged in parallel.
+    static const uint32_t PARTITION_BITS = 8;
+
+    std::vector<str_view_template<CharT>> m_Strings;
+    // Sorted trigram keys. Posting list of m_Keys[i] spans bytes [m_Offsets[i], m_Offsets[i + 1]) of m_Postings.
+    std::vector<uint32_t> m_Keys;
+    std::vector<uint64_t> m_Offsets;
+    std::vector<uint8_t> m_Postings;
+
+    static inline uint32_t trigram_key(const CharT* str);
+    static inline void append_varint(std::vector<uint8_t>& dst, uint32_t value);
+    static inline uint32_t read_varint(const uint8_t*& src);
+    /*
+    Fills outCandidates with indices of strings that contain all trigrams of query.
+    Returns false if query has no trigrams, so all strings are candidates.
+    */
+    inline bool find_candidates(const str_view_template<CharT>& query, std::vector<uint32_t>& outCandidates) const;
+};
+
+typedef trigram_index_template<char> trigram_index;
+typedef trigram_index_template<wchar_t> wtrigram_index;
+
+template<typename CharT>
+inline uint32_t trigram_index_template<CharT>::trigram_key(const CharT* str)
+{
+    typedef typename std::make_unsigned<CharT>::type UCharT;
+    if(sizeof(CharT) == 1)
+        return ((uint32_t)(UCharT)str[0] << 16) | ((uint32_t)(UCharT)str[1] << 8) | (uint32_t)(UCharT)str[2];
+    uint32_t key = (uint32_t)(UCharT)str[0] * 0x9E3779B1u;
+    key = (key ^ (uint32_t)(UCharT)str[1]) * 0x85EBCA77u;
+    key = (key ^ (uint32_t)(UCharT)str[2]) * 0xC2B2AE3Du;
+    return key ^ (key >> 16);
+}
+
+template<typename CharT>
+inline void trigram_index_template<CharT>::append_varint(std::vector<uint8_t>& dst, uint32_t value)
+{
+    while(value >= 0x80)
+    {
+        dst.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    dst.push_back((uint8_t)value);
+}
+
+template<typename CharT>
+inline uint32_t trigram_index_template<CharT>::read_varint(const uint8_t*& src)
+{
+    uint32_t value = 0;
+    for(uint32_t shift = 0; ; shift += 7)
+    {
+        const uint8_t byte = *src++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if(byte < 0x80)
+            return value;
+    }
+}
+
+template<typename CharT>
+inline bool trigram_index_template<CharT>::build(const str_view_template<CharT>* strings, size_t count, uint32_t thread_count)
+{
+    m_Strings.clear();
+    m_Keys.clear();
+    m_Offsets.assign(1, 0);
+    m_Postings.clear();
+    if(count >= UINT32_MAX)
+        return false;
+    m_Strings.reserve(count);
+    for(size_t i = 0; i < count; ++i)
+        m_Strings.push_back(str_view_template<CharT>(strings[i].data(), strings[i].length()));
+
+    // Each batch of strings is indexed separately, with the first string index of every posting list stored whole.
+    struct Batch
+    {
+        std::vector<uint32_t> keys;
+        // Posting list of keys[i] spans bytes [ends[i - 1], ends[i]), from 0 for the first one.
+        std::vector<size_t> ends;
+        std::vector<uint32_t> lastStrings;
+        std::vector<uint8_t> postings;
+    };
+    const size_t batchCount = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+    std::vector<Batch> batches(batchCount);
+    str_view_detail::parallel_for_chunks(batchCount, thread_count, [&](size_t batchIndex)
+    {
+        // Pairs of (key << 32 | string index).
+        std::vector<uint64_t> pairs, sorted;
+        const size_t end = std::min(count, (batchIndex + 1) * BATCH_SIZE);
+        size_t pairCount = 0;
+        for(size_t stringIndex = batchIndex * BATCH_SIZE; stringIndex < end; ++stringIndex)
+            pairCount += std::max(m_Strings[stringIndex].length(), (size_t)2) - 2;
+        pairs.reserve(pairCount);
+        for(size_t stringIndex = batchIndex * BATCH_SIZE; stringIndex < end; ++stringIndex)
+        {
+            const CharT* const str = m_Strings[stringIndex].data();
+            const size_t len = m_Strings[stringIndex].length();
+            for(size_t i = 0; i + 3 <= len; ++i)
+                pairs.push_back((uint64_t)trigram_key(str + i) << 32 | stringIndex);
+        }
+        // Pairs are added in order of string index, so stable radix sort by key alone sorts them fully.
+        sorted.resize(pairs.size());
+        std::vector<size_t> starts(((size_t)1 << RADIX_BITS) + 1);
+        for(uint32_t shift = 32; shift < 32 + KEY_BITS; shift += RADIX_BITS)
+        {
+            const uint64_t digitMask = ((uint64_t)1 << RADIX_BITS) - 1;
+            std::fill(starts.begin(), starts.end(), 0);
+            for(uint64_t pair : pairs)
+                ++starts[((pair >> shift) & digitMask) + 1];
+            for(size_t i = 1; i < starts.size(); ++i)
+                starts[i] += starts[i - 1];
+            for(uint64_t pair : pairs)
+                sorted[starts[(pair >> shift) & digitMask]++] = pair;
+            pairs.swap(sorted);
+        }
+        Batch& batch = batches[batchIndex];
+        for(size_t i = 0; i < pairs.size(); ++i)
+        {
+            const uint32_t key = (uint32_t)(pairs[i] >> 32);
+            const uint32_t stringIndex = (uint32_t)pairs[i];
+            if(batch.keys.empty() || batch.keys.back() != key)
+            {
+                batch.keys.push_back(key);
+                batch.ends.push_back(0);
+                batch.lastStrings.push_back(stringIndex);
+                append_varint(batch.postings, stringIndex);
+            }
+            else if(stringIndex != batch.lastStrings.back())
+            {
+                append_varint(batch.postings, stringIndex - batch.lastStrings.back());
+                batch.lastStrings.back() = stringIndex;
+            }
+            batch.ends.back() = batch.postings.size();
+        }
+    });
+
+    /*
+    Posting lists are merged in parallel for ranges of keys. Batches cover increasing string indices,
+    so a posting list is made by concatenating parts from consecutive batches, re-encoding only
+    the first string index of each part as a difference.
+    */
+    struct Partition
+    {
+        std::vector<uint32_t> keys;
+        std::vector<uint64_t> ends;
+        std::vector<uint8_t> postings;
+    };
+    const uint32_t partitionShift = KEY_BITS - PARTITION_BITS;
+    std::vector<Partition> partitions((size_t)1 << PARTITION_BITS);
+    str_view_detail::parallel_for_chunks(partitions.size(), thread_count, [&](size_t partitionIndex)
+    {
+        Partition& partition = partitions[partitionIndex];
+        const uint64_t rangeBegin = (uint64_t)partitionIndex << partitionShift;
+        const uint64_t rangeEnd = (uint64_t)(partitionIndex + 1) << partitionShift;
+        // Min-heap of (key << 32 | batch index) of the next posting list in each batch, so parts come in order of batches.
+        std::vector<size_t> cursors(batchCount), ends(batchCount);
+        std::vector<uint64_t> heap;
+        for(size_t batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+        {
+            const std::vector<uint32_t>& keys = batches[batchIndex].keys;
+            cursors[batchIndex] = std::lower_bound(keys.begin(), keys.end(), rangeBegin,
+                [](uint32_t key, uint64_t value) { return key < value; }) - keys.begin();
+            ends[batchIndex] = std::lower_bound(keys.begin(), keys.end(), rangeEnd,
+                [](uint32_t key, uint64_t value) { return key < value; }) - keys.begin();
+            if(cursors[batchIndex] != ends[batchIndex])
+                heap.push_back((uint64_t)keys[cursors[batchIndex]] << 32 | batchIndex);
+        }
+        std::make_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+        uint32_t prevString = 0;
+        while(!heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+            const uint32_t key = (uint32_t)(heap.back() >> 32);
+            const size_t batchIndex = (size_t)(uint32_t)heap.back();
+            heap.pop_back();
+            if(partition.keys.empty() || partition.keys.back() != key)
+            {
+                partition.keys.push_back(key);
+                partition.ends.push_back(partition.postings.size());
+                prevString = 0;
+            }
+            const Batch& batch = batches[batchIndex];
+            const size_t listIndex = cursors[batchIndex]++;
+            const uint8_t* src = batch.postings.data() + (listIndex ? batch.ends[listIndex - 1] : 0);
+            const uint8_t* const srcEnd = batch.postings.data() + batch.ends[listIndex];
+            append_varint(partition.postings, read_varint(src) - prevString);
+            partition.postings.insert(partition.postings.end(), src, srcEnd);
+            prevString = batch.lastStrings[listIndex];
+            partition.ends.back() = partition.postings.size();
+            if(cursors[batchIndex] != ends[batchIndex])
+            {
+                heap.push_back((uint64_t)batch.keys[cursors[batchIndex]] << 32 | batchIndex);
+                std::push_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+            }
+        }
+    });
+    batches.clear();
+
+    for(const Partition& partition : partitions)
+    {
+        const uint64_t base = m_Postings.size();
+        m_Keys.insert(m_Keys.end(), partition.keys.begin(), partition.keys.end());
+        for(uint64_t end : partition.ends)
+            m_Offsets.push_back(base + end);
+        m_Postings.insert(m_Postings.end(), partition.postings.begin(), partition.postings.end());
+    }
+    return true;
+}
+
+template<typename CharT>
+inline bool trigram_index_template<CharT>::find_candidates(const str_view_template<CharT>& query, std::vector<uint32_t>& outCandidates) const
+{
+    outCandidates.clear();
+    const size_t queryLen = query.length();
+    if(queryLen < 3)
+        return false;
+    std::vector<uint32_t> queryKeys;
+    for(size_t i = 0; i + 3 <= queryLen; ++i)
+        queryKeys.push_back(trigram_key(query.data() + i));
+    std::sort(queryKeys.begin(), queryKeys.end());
+    queryKeys.erase(std::unique(queryKeys.begin(), queryKeys.end()), queryKeys.end());
+
+    // Posting lists as indices into m_Keys, from the shortest one.
+    std::vector<size_t> lists;
+    for(uint32_t key : queryKeys)
+    {
+        const auto it = std::lower_bound(m_Keys.begin(), m_Keys.end(), key);
+        if(it == m_Keys.end() || *it != key)
+            return true;
+        lists.push_back((size_t)(it - m_Keys.begin()));
+    }
+    std::sort(lists.begin(), lists.end(), [this](size_t lhs, size_t rhs)
+    {
+        return m_Offsets[lhs + 1] - m_Offsets[lhs] < m_Offsets[rhs + 1] - m_Offsets[rhs];
+    });
+
+    const uint8_t* src = m_Postings.data() + m_Offsets[lists[0]];
+    const uint8_t* end = m_Postings.data() + m_Offsets[lists[0] + 1];
+    for(uint32_t stringIndex = 0; src < end; )
+    {
+        stringIndex += read_varint(src);
+        outCandidates.push_back(stringIndex);
+    }
+    for(size_t listIndex = 1; listIndex < lists.size() && !outCandidates.empty(); ++listIndex)
+    {
+        src = m_Postings.data() + m_Offsets[lists[listIndex]];
+        end = m_Postings.data() + m_Offsets[lists[listIndex] + 1];
+        size_t readIndex = 0, writeIndex = 0;
+        for(uint32_t stringIndex = 0; src < end && readIndex < outCandidates.size(); )
+        {
+            stringIndex += read_varint(src);
+            while(readIndex < outCandidates.size() && outCandidates[readIndex] < stringIndex)
+                ++readIndex;
+            if(readIndex < outCandidates.size() && outCandidates[readIndex] == stringIndex)
+                outCandidates[writeIndex++] = outCandidates[readIndex++];
+        }
+        outCandidates.resize(writeIndex);
+    }
+    return true;
+}
+
+template<typename CharT>
+inline size_t trigram_index_template<CharT>::find_first(const str_view_template<CharT>& query) const
+{
+    std::vector<uint32_t> candidates;
+    if(!find_candidates(query, candidates))
+    {
+        for(size_t i = 0; i < m_Strings.size(); ++i)
+        {
+            if(m_Strings[i].find(query) != SIZE_MAX)
+                return i;
+        }
+        return SIZE_MAX;
+    }
+    for(uint32_t candidate : candidates)
+    {
+        if(m_Strings[candidate].find(query) != SIZE_MAX)
+            return candidate;
+    }
+    return SIZE_MAX;
+}
+
+template<typename CharT>
+inline bool trigram_index_template<CharT>::find_all(const str_view_template<CharT>& query, std::vector<size_t>& outIndices) const
+{
+    outIndices.clear();
+    std::vector<uint32_t> candidates;
+    if(!find_candidates(query, candidates))
+    {
+        for(size_t i = 0; i < m_Strings.size(); ++i)
+        {
+            if(m_Strings[i].find(query) != SIZE_MAX)
+                outIndices.push_back(i);
+        }
+    }
+    else
+    {
+        for(uint32_t candidate : candidates)
+        {
+            if(m_Strings[candidate].find(query) != SIZE_MAX)
+                outIndices.push_back(candidate);
+        }
+    }
+    return !outIndices.empty();
+}
+
+/*
+Suffix array of a text with array of longest common prefixes (LCP), for many substring queries
+over the same long text, e.g. to find duplicates and repetitions. Suffix array lists starting
+positions of all suffixes of the text in lexicographic order, so occurrences of a substring are
+adjacent and found by binary search in O(m log n) time, where m is length of the substring.
+
+Built in O(n) time with SA-IS algorithm. IndexT is uint32_t or uint64_t - type of stored positions.
+It decides the maximum length of the text and memory use: 2 * sizeof(IndexT) bytes per character.
+The text is not copied - it must remain alive and unchanged as long as the array is used.
+*/
+template<typename CharT, typename IndexT = uint32_t>
+class suffix_array_template
+{
+    static_assert(std::is_same<IndexT, uint32_t>::value || std::is_same<IndexT, uint64_t>::value,
+        "IndexT must be uint32_t or uint64_t.");
+public:
+    /*
+    Builds suffix array and LCP array of text. Previous contents are discarded.
+    Steps that allow it run on multiple threads: naming of LMS substrings and computing LCP.
+    thread_count - 0 means std::thread::hardware_concurrency().
+    Returns false if text is too long for IndexT.
+    */
+    inline bool build(const str_view_template<CharT>& text, uint32_t thread_count = 0);
+
+    // Returns the number of suffixes, which is length of the text.
+    inline size_t size() const { return m_Suffixes.size(); }
+    inline bool empty() const { return m_Suffixes.empty(); }
+    inline const str_view_template<CharT>& text() const { return m_Text; }
+    // Returns starting positions of all suffixes of the text in lexicographic order.
+    inline const IndexT* suffixes() const { return m_Suffixes.data(); }
+    // Returns array where element i is length of common prefix of suffixes i - 1 and i. Element 0 is 0.
+    inline const IndexT* lcp() const { return m_Lcp.data(); }
+
+    // Returns the number of occurrences of substr in the text, including overlapping ones.
+    inline size_t count(const str_view_template<CharT>& substr) const;
+    /*
+    Fills outPositions with positions of all occurrences of substr in the text. Returns true if there are any.
+    sorted - true returns them in ascending order, which sorts the k found positions in O(k log k) time.
+    false returns them in lexicographic order of their suffixes, as they are stored, in O(k) time.
+    */
+    inline bool find_all(const str_view_template<CharT>& substr, std::vector<size_t>& outPositions, bool sorted = true) const;
+    inline bool contains(const str_view_template<CharT>& substr) const { return count(substr) > 0; }
+    /*
+    Returns the longest substring that occurs in the text at least twice, possibly overlapping,
+    the first one in lexicographic order if there are many. Returns empty view if no character repeats.
+    */
+    inline str_view_template<CharT> longest_repeated_substring() const;
+
+private:
+    static const IndexT NONE = (IndexT)~(IndexT)0;
+
+    str_view_template<CharT> m_Text;
+    std::vector<IndexT> m_Suffixes;
+    std::vector<IndexT> m_Lcp;
+
+    // Finds range [outBegin, outEnd) of m_Suffixes that start with substr.
+    inline void equal_range(const str_view_template<CharT>& substr, size_t& outBegin, size_t& outEnd) const;
+    /*
+    Fills outSuffixes[0, len) with suffix array of str, made of symbols in range [0, maxSymbol].
+    Sorts LMS substrings by induction, names them, sorts their sequence recursively if names
+    are not unique, and induces order of all suffixes from sorted LMS suffixes.
+    */
+    template<typename SymbolT>
+    static inline void induced_sort(const SymbolT* str, IndexT len, IndexT maxSymbol, IndexT* outSuffixes, uint32_t threadCount);
+    inline void build_lcp(uint32_t threadCount);
+};
+
+typedef suffix_array_template<char> suffix_array;
+typedef suffix_array_template<wchar_t> wsuffix_array;
+
+template<typename CharT, typename IndexT>
+template<typename SymbolT>
+inline void suffix_array_template<CharT, IndexT>::induced_sort(const SymbolT* str, IndexT len, IndexT maxSymbol, IndexT* outSuffixes, uint32_t threadCount)
+{
+    if(len <= 2)
+    {
+        if(len == 1)
+            outSuffixes[0] = 0;
+        else if(len == 2)
+        {
+            outSuffixes[0] = str[0] < str[1] ? 0 : 1;
+            outSuffixes[1] = 1 - outSuffixes[0];
+        }
+        return;
+    }
+
+    // Suffix i is S-type if it is smaller than suffix i + 1, L-type if larger. The last one is L-type.
+    std::vector<bool> isS(len);
+    for(IndexT i = len - 1; i-- > 0; )
+        isS[i] = str[i] == str[i + 1] ? isS[i + 1] : str[i] < str[i + 1];
+    // Bucket of every symbol holds L-type suffixes starting with it, followed by S-type ones.
+    std::vector<IndexT> lStarts(maxSymbol + 1), sStarts(maxSymbol + 1);
+    for(IndexT i = 0; i < len; ++i)
+    {
+        if(isS[i])
+            ++lStarts[str[i] + 1];
+        else
+            ++sStarts[str[i]];
+    }
+    for(IndexT symbol = 0; symbol <= maxSymbol; ++symbol)
+    {
+        sStarts[symbol] += lStarts[symbol];
+        if(symbol < maxSymbol)
+            lStarts[symbol + 1] += sStarts[symbol];
+    }
+
+    // Places lmsSuffixes in their buckets in given order, then induces L-type and S-type suffixes from them.
+    std::vector<IndexT> bucketPos;
+    const auto induce = [&](const std::vector<IndexT>& lmsSuffixes)
+    {
+        std::fill(outSuffixes, outSuffixes + len, (IndexT)NONE);
+        bucketPos = sStarts;
+        for(IndexT pos : lmsSuffixes)
+            outSuffixes[bucketPos[str[pos]]++] = pos;
+        bucketPos = lStarts;
+        outSuffixes[bucketPos[str[len - 1]]++] = len - 1;
+        for(IndexT i = 0; i < len; ++i)
+        {
+            const IndexT pos = outSuffixes[i];
+            if(pos != NONE && pos > 0 && !isS[pos - 1])
+                outSuffixes[bucketPos[str[pos - 1]]++] = pos - 1;
+        }
+        bucketPos = lStarts;
+        for(IndexT i = len; i-- > 0; )
+        {
+            const IndexT pos = outSuffixes[i];
+            if(pos != NONE && pos > 0 && isS[pos - 1])
+                outSuffixes[--bucketPos[str[pos - 1] + 1]] = pos - 1;
+        }
+    };
+
+    // LMS (leftmost S-type) suffixes are S-type ones preceded by L-type ones.
+    std::vector<IndexT> lmsSuffixes;
+    std::vector<IndexT> lmsIndices(len, (IndexT)NONE);
+    for(IndexT i = 1; i < len; ++i)
+    {
+        if(isS[i] && !isS[i - 1])
+        {
+            lmsIndices[i] = (IndexT)lmsSuffixes.size();
+            lmsSuffixes.push_back(i);
+        }
+    }
+    const IndexT lmsCount = (IndexT)lmsSuffixes.size();
+    induce(lmsSuffixes);
+    if(lmsCount == 0)
+        return;
+
+    // Induced order sorts LMS substrings - from one LMS position to the next one.
+    std::vector<IndexT> sortedLms;
+    sortedLms.reserve(lmsCount);
+    for(IndexT i = 0; i < len; ++i)
+    {
+        if(lmsIndices[outSuffixes[i]] != NONE)
+            sortedLms.push_back(outSuffixes[i]);
+    }
+    // Neighbors are compared in parallel, then equal LMS substrings get equal names.
+    std::vector<uint8_t> differs(lmsCount);
+    const size_t chunkLen = str_view_detail::PARALLEL_CHUNK_LENGTH;
+    str_view_detail::parallel_for_chunks((lmsCount + chunkLen - 1) / chunkLen, threadCount, [&](size_t chunkIndex)
+    {
+        const IndexT chunkEnd = (IndexT)std::min<size_t>(lmsCount, (chunkIndex + 1) * chunkLen);
+        for(IndexT i = (IndexT)std::max<size_t>(chunkIndex * chunkLen, 1); i < chunkEnd; ++i)
+        {
+            IndexT lhs = sortedLms[i - 1], rhs = sortedLms[i];
+            const IndexT lhsEnd = lmsIndices[lhs] + 1 < lmsCount ? lmsSuffixes[lmsIndices[lhs] + 1] : len;
+            const IndexT rhsEnd = lmsIndices[rhs] + 1 < lmsCount ? lmsSuffixes[lmsIndices[rhs] + 1] : len;
+            bool same = lhsEnd - lhs == rhsEnd - rhs;
+            if(same)
+            {
+                while(lhs < lhsEnd && str[lhs] == str[rhs])
+                {
+                    ++lhs;
+                    ++rhs;
+                }
+                same = lhs < len && rhs < len && str[lhs] == str[rhs];
+            }
+            differs[i] = same ? 0 : 1;
+        }
+    });
+    std::vector<IndexT> lmsNames(lmsCount);
+    IndexT maxName = 0;
+    for(IndexT i = 0; i < lmsCount; ++i)
+    {
+        maxName += differs[i];
+        lmsNames[lmsIndices[sortedLms[i]]] = maxName;
+    }
+    std::vector<uint8_t>().swap(differs);
+    std::vector<IndexT>().swap(lmsIndices);
+
+    // Order of LMS suffixes is the suffix array of their names, known directly if names are unique.
+    if(maxName + 1 == lmsCount)
+    {
+        for(IndexT i = 0; i < lmsCount; ++i)
+            sortedLms[lmsNames[i]] = lmsSuffixes[i];
+    }
+    else
+    {
+        induced_sort(lmsNames.data(), lmsCount, maxName, sortedLms.data(), threadCount);
+        for(IndexT i = 0; i < lmsCount; ++i)
+            sortedLms[i] = lmsSuffixes[sortedLms[i]];
+    }
+    induce(sortedLms);
+}
+
+template<typename CharT, typename IndexT>
+inline void suffix_array_template<CharT, IndexT>::build_lcp(uint32_t threadCount)
+{
+    /*
+    Kasai's algorithm with permuted LCP: for suffixes in text order, each LCP is at least the previous
+    one minus 1, so it continues from there. Chunks of the text start from 0 instead, so they run in parallel.
+    */
+    const size_t len = m_Suffixes.size();
+    const CharT* const text = m_Text.data();
+    const size_t chunkLen = str_view_detail::PARALLEL_CHUNK_LENGTH;
+    const size_t chunkCount = (len + chunkLen - 1) / chunkLen;
+    // First holds position of the preceding suffix in the suffix array, then LCP with it.
+    std::vector<IndexT> permutedLcp(len);
+    str_view_detail::parallel_for_chunks(chunkCount, threadCount, [&](size_t chunkIndex)
+    {
+        const size_t chunkEnd = std::min(len, (chunkIndex + 1) * chunkLen);
+        for(size_t i = chunkIndex * chunkLen; i < chunkEnd; ++i)
+            permutedLcp[m_Suffixes[i]] = i > 0 ? m_Suffixes[i - 1] : NONE;
+    });
+    str_view_detail::parallel_for_chunks(chunkCount, threadCount, [&](size_t chunkIndex)
+    {
+        const size_t chunkEnd = std::min(len, (chunkIndex + 1) * chunkLen);
+        size_t prefixLen = 0;
+        for(size_t pos = chunkIndex * chunkLen; pos < chunkEnd; ++pos)
+        {
+            const IndexT prevPos = permutedLcp[pos];
+            if(prevPos == NONE)
+            {
+                permutedLcp[pos] = 0;
+                prefixLen = 0;
+                continue;
+            }
+            const size_t maxLen = len - std::max(pos, (size_t)prevPos);
+            if(prefixLen < maxLen)
+                prefixLen += str_view_detail::mismatch(text + pos + prefixLen, text + prevPos + prefixLen, maxLen - prefixLen);
+            permutedLcp[pos] = (IndexT)prefixLen;
+            if(prefixLen > 0)
+                --prefixLen;
+        }
+    });
+    m_Lcp.resize(len);
+    str_view_detail::parallel_for_chunks(chunkCount, threadCount, [&](size_t chunkIndex)
+    {
+        const size_t chunkEnd = std::min(len, (chunkIndex + 1) * chunkLen);
+        for(size_t i = chunkIndex * chunkLen; i < chunkEnd; ++i)
+            m_Lcp[i] = permutedLcp[m_Suffixes[i]];
+    });
+}
+
+template<typename CharT, typename IndexT>
+inline bool suffix_array_template<CharT, IndexT>::build(const str_view_template<CharT>& text, uint32_t thread_count)
+{
+    m_Text = str_view_template<CharT>(text.data(), text.length());
+    m_Suffixes.clear();
+    m_Lcp.clear();
+    const size_t len = text.length();
+    if(len >= (size_t)NONE)
+        return false;
+    if(len == 0)
+        return true;
+
+    m_Suffixes.resize(len);
+    if(sizeof(CharT) == 1)
+        induced_sort((const unsigned char*)text.data(), (IndexT)len, (IndexT)0xFF, m_Suffixes.data(), thread_count);
+    else
+    {
+        // Characters are replaced with their ranks among distinct characters of the text, so there are few buckets.
+        typedef typename std::make_unsigned<CharT>::type UCharT;
+        const UCharT* const chars = (const UCharT*)text.data();
+        std::vector<UCharT> alphabet(chars, chars + len);
+        std::sort(alphabet.begin(), alphabet.end());
+        alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+        std::vector<IndexT> ranks(len);
+        const size_t chunkLen = str_view_detail::PARALLEL_CHUNK_LENGTH;
+        str_view_detail::parallel_for_chunks((len + chunkLen - 1) / chunkLen, thread_count, [&](size_t chunkIndex)
+        {
+            const size_t chunkEnd = std::min(len, (chunkIndex + 1) * chunkLen);
+            for(size_t i = chunkIndex * chunkLen; i < chunkEnd; ++i)
+                ranks[i] = (IndexT)(std::lower_bound(alphabet.begin(), alphabet.end(), chars[i]) - alphabet.begin());
+        });
+        induced_sort(ranks.data(), (IndexT)len, (IndexT)(alphabet.size() - 1), m_Suffixes.data(), thread_count);
+    }
+    build_lcp(thread_count);
+    return true;
+}
+
+template<typename CharT, typename IndexT>
+inline void suffix_array_template<CharT, IndexT>::equal_range(const str_view_template<CharT>& substr, size_t& outBegin, size_t& outEnd) const
+{
+    const CharT* const text = m_Text.data();
+    const size_t len = m_Text.length();
+    const size_t substrLen = substr.length();
+    // Compares only the beginning of the suffix, so all suffixes that start with substr are equal to it.
+    const auto comparePrefix = [&](IndexT pos) -> int
+    {
+        return str_view_detail::compare_chars(text + pos, std::min(substrLen, len - (size_t)pos), substr.data(), substrLen);
+    };
+    const IndexT* const begin = m_Suffixes.data();
+    const IndexT* const end = begin + m_Suffixes.size();
+    const IndexT* const first = std::partition_point(begin, end, [&](IndexT pos) { return comparePrefix(pos) < 0; });
+    const IndexT* const last = std::partition_point(first, end, [&](IndexT pos) { return comparePrefix(pos) == 0; });
+    outBegin = first - begin;
+    outEnd = last - begin;
+}
+
+template<typename CharT, typename IndexT>
+inline size_t suffix_array_template<CharT, IndexT>::count(const str_view_template<CharT>& substr) const
+{
+    size_t begin, end;
+    equal_range(substr, begin, end);
+    return end - begin;
+}
+
+template<typename CharT, typename IndexT>
+inline bool suffix_array_template<CharT, IndexT>::find_all(const str_view_template<CharT>& substr, std::vector<size_t>& outPositions, bool sorted) const
+{
+    size_t begin, end;
+    equal_range(substr, begin, end);
+    outPositions.assign(m_Suffixes.begin() + begin, m_Suffixes.begin() + end);
+    if(sorted)
+        std::sort(outPositions.begin(), outPositions.end());
+    return !outPositions.empty();
+}
+
+template<typename CharT, typename IndexT>
+inline str_view_template<CharT> suffix_array_template<CharT, IndexT>::longest_repeated_substring() const
+{
+    const auto longest = std::max_element(m_Lcp.begin(), m_Lcp.end());
+    if(longest == m_Lcp.end() || *longest == 0)
+        return str_view_template<CharT>();
+    return m_Text.substr(m_Suffixes[longest - m_Lcp.begin()], *longest);
+}
+
+/*
+Index of line beginnings in a text, for converting offsets, e.g. returned by find(), to line and column
+positions for diagnostics without scanning the text from the beginning each time, and for accessing lines
+by number. Lines are separated by '\n', optionally preceded by '\r'. Lines and columns are counted from 0.
+
+The text is not copied - it must remain alive as long as the index is used. When more text is appended
+to its buffer, extend() indexes only the new part.
+*/
+template<typename CharT>
+class line_index_template
+{
+public:
+    inline line_index_template() : m_LineStarts(1, 0) { }
+    inline explicit line_index_template(const str_view_template<CharT>& text) : m_LineStarts(1, 0) { extend(text); }
+
+    // Indexes text. Previous contents are discarded.
+    inline void build(const str_view_template<CharT>& text);
+    /*
+    Indexes text that starts with the previously indexed text - the same buffer after appending to it,
+    possibly reallocated. Only characters after the previous length are scanned.
+    */
+    inline void extend(const str_view_template<CharT>& text);
+
+    inline const str_view_template<CharT>& text() const { return m_Text; }
+    /*
+    Returns number of lines, including the one after the last '\n', which may be empty, so that every
+    offset up to the length of the text belongs to a line. Unlike count_lines(), "a\n" has 2 lines.
+    */
+    inline size_t line_count() const { return m_LineStarts.size(); }
+    // Returns offset of the first character of line.
+    inline size_t line_start(size_t line) const { assert(line < m_LineStarts.size()); return m_LineStarts[line]; }
+    // Returns the line, without ending "\n" or "\r\n". O(1).
+    inline str_view_template<CharT> line(size_t line) const;
+
+    // Returns number of the line that contains character at offset, or that ends at it. O(log n).
+    inline size_t line_of(size_t offset) const;
+    // Converts offset to line number and column - number of characters from the line start. O(log n).
+    inline void position(size_t offset, size_t& outLine, size_t& outColumn) const;
+
+private:
+    str_view_template<CharT> m_Text;
+    // Offsets of beginnings of all lines, starting with 0.
+    std::vector<size_t> m_LineStarts;
+};
+
+typedef line_index_template<char> line_index;
+typedef line_index_template<wchar_t> wline_index;
+
+template<typename CharT>
+inline void line_index_template<CharT>::build(const str_view_template<CharT>& text)
+{
+    m_Text = str_view_template<CharT>();
+    m_LineStarts.assign(1, 0);
+    extend(text);
+}
+
+template<typename CharT>
+inline void line_index_template<CharT>::extend(const str_view_template<CharT>& text)
+{
+    const size_t oldLen = m_Text.length();
+    const size_t newLen = text.length();
+    assert(newLen >= oldLen);
+    m_Text = str_view_template<CharT>(text.data(), newLen);
+    str_view_detail::append_line_starts(m_Text.data() + oldLen, newLen - oldLen, oldLen, m_LineStarts);
+}
+
+template<typename CharT>
+inline str_view_template<CharT> line_index_template<CharT>::line(size_t line) const
+{
+    assert(line < m_LineStarts.size());
+    const size_t begin = m_LineStarts[line];
+    size_t end = line + 1 < m_LineStarts.size() ? m_LineStarts[line + 1] - 1 : m_Text.length();
+    if(end > begin && m_Text.data()[end - 1] == (CharT)'\r' && line + 1 < m_LineStarts.size())
+        --end;
+    return m_Text.substr(begin, end - begin);
+}
+
+template<typename CharT>
+inline size_t line_index_template<CharT>::line_of(size_t offset) const
+{
+    assert(offset <= m_Text.length());
+    return (size_t)(std::upper_bound(m_LineStarts.begin(), m_LineStarts.end(), offset) - m_LineStarts.begin()) - 1;
+}
+
+template<typename CharT>
+inline void line_index_template<CharT>::position(size_t offset, size_t& outLine, size_t& outColumn) const
+{
+    outLine = line_of(offset);
+    outColumn = offset - m_LineStarts[outLine];
+}
+
+/*
+Components of a URI, or a relative reference, split according to RFC 3986:
+
+    scheme ":" "//" authority path "?" query "#" fragment
+    authority = userinfo "@" host ":" port
+
+Components are views of the parsed string, without the delimiters, still percent-encoded, so parsing
+doesn't allocate memory or copy characters. The component that ends the string, e.g. the fragment,
+stays null-terminated if the string was. Components decoded with unescape_percent() are copied only
+if they contain percent-encoded characters.
+*/
+template<typename CharT>
+class uri_template
+{
+public:
+    inline uri_template() : m_HasAuthority(false), m_HasUserInfo(false), m_HasPort(false), m_HasQuery(false), m_HasFragment(false) { }
+    inline explicit uri_template(const str_view_template<CharT>& str) : uri_template() { parse(str); }
+
+    /*
+    Splits str into components. Previous ones are discarded. str must remain alive while they are used.
+    Returns false if the syntax is invalid: scheme with characters other than letters, digits, '+', '-', '.',
+    or not starting with a letter, port with characters other than digits, host starting with '[' not
+    followed by ']' and port. Components are still split then, as far as possible.
+    Characters inside components are not validated.
+    */
+    inline bool parse(const str_view_template<CharT>& str);
+
+    // Scheme, e.g. "https". Empty if the string is a relative reference.
+    inline const str_view_template<CharT>& scheme() const { return m_Scheme; }
+    inline bool has_scheme() const { return !m_Scheme.empty(); }
+    // Authority, e.g. "user@example.com:8080". Present if "//" follows the scheme, even if empty.
+    inline const str_view_template<CharT>& authority() const { return m_Authority; }
+    inline bool has_authority() const { return m_HasAuthority; }
+    // User information before the last '@' of the authority.
+    inline const str_view_template<CharT>& userinfo() const { return m_UserInfo; }
+    inline bool has_userinfo() const { return m_HasUserInfo; }
+    // Host name or IP address. IPv6 address is enclosed in brackets, like "[::1]".
+    inline const str_view_template<CharT>& host() const { return m_Host; }
+    // Port digits after ':' following the host.
+    inline const str_view_template<CharT>& port() const { return m_Port; }
+    inline bool has_port() const { return m_HasPort; }
+    // Returns port as a number, or SIZE_MAX if it's missing, empty, or not in range 0..65535.
+    inline size_t port_number() const;
+    inline const str_view_template<CharT>& path() const { return m_Path; }
+    // Query after '?', e.g. "a=1&b=2". See query_param_reader_template.
+    inline const str_view_template<CharT>& query() const { return m_Query; }
+    inline bool has_query() const { return m_HasQuery; }
+    // Fragment after '#'.
+    inline const str_view_template<CharT>& fragment() const { return m_Fragment; }
+    inline bool has_fragment() const { return m_HasFragment; }
+
+private:
+    str_view_template<CharT> m_Scheme;
+    str_view_template<CharT> m_Authority;
+    str_view_template<CharT> m_UserInfo;
+    str_view_template<CharT> m_Host;
+    str_view_template<CharT> m_Port;
+    str_view_template<CharT> m_Path;
+    str_view_template<CharT> m_Query;
+    str_view_template<CharT> m_Fragment;
+    bool m_HasAuthority;
+    bool m_HasUserInfo;
+    bool m_HasPort;
+    bool m_HasQuery;
+    bool m_HasFragment;
+};
+
+typedef uri_template<char> uri;
+typedef uri_template<wchar_t> wuri;
+
+template<typename CharT>
+inline bool uri_template<CharT>::parse(const str_view_template<CharT>& str)
+{
+    *this = uri_template<CharT>();
+    const CharT* const chars = str.data();
+    const size_t len = str.length();
+    bool valid = true;
+    size_t pos = 0;
+
+    // Scheme ends with ':' that comes before any of "/?#".
+    size_t end = 0;
+    while(end < len && chars[end] != (CharT)':' && chars[end] != (CharT)'/' && chars[end] != (CharT)'?' && chars[end] != (CharT)'#')
+        ++end;
+    if(end < len && chars[end] == (CharT)':')
+    {
+        const auto isAlpha = [](CharT ch) { return (ch >= (CharT)'a' && ch <= (CharT)'z') || (ch >= (CharT)'A' && ch <= (CharT)'Z'); };
+        m_Scheme = str.substr(0, end);
+        valid = end > 0 && isAlpha(chars[0]);
+        for(size_t i = 1; i < end; ++i)
+        {
+            if(!isAlpha(chars[i]) && !(chars[i] >= (CharT)'0' && chars[i] <= (CharT)'9') &&
+                chars[i] != (CharT)'+' && chars[i] != (CharT)'-' && chars[i] != (CharT)'.')
+                valid = false;
+        }
+        pos = end + 1;
+    }
+
+    if(len - pos >= 2 && chars[pos] == (CharT)'/' && chars[pos + 1] == (CharT)'/')
+    {
+        const size_t authorityBegin = pos + 2;
+        end = authorityBegin;
+        while(end < len && chars[end] != (CharT)'/' && chars[end] != (CharT)'?' && chars[end] != (CharT)'#')
+            ++end;
+        m_HasAuthority = true;
+        m_Authority = str.substr(authorityBegin, end - authorityBegin);
+        size_t hostBegin = authorityBegin;
+        for(size_t i = end; i > authorityBegin; --i)
+        {
+            if(chars[i - 1] == (CharT)'@')
+            {
+                m_HasUserInfo = true;
+                m_UserInfo = str.substr(authorityBegin, i - 1 - authorityBegin);
+                hostBegin = i;
+                break;
+            }
+        }
+        size_t hostEnd = hostBegin;
+        if(hostBegin < end && chars[hostBegin] == (CharT)'[')
+        {
+            while(hostEnd < end && chars[hostEnd] != (CharT)']')
+                ++hostEnd;
+            if(hostEnd < end)
+                ++hostEnd;
+            else
+                valid = false;
+        }
+        else
+        {
+            while(hostEnd < end && chars[hostEnd] != (CharT)':')
+                ++hostEnd;
+        }
+        m_Host = str.substr(hostBegin, hostEnd - hostBegin);
+        if(hostEnd < end)
+        {
+            if(chars[hostEnd] == (CharT)':')
+            {
+                m_HasPort = true;
+                m_Port = str.substr(hostEnd + 1, end - hostEnd - 1);
+                for(size_t i = hostEnd + 1; i < end; ++i)
+                {
+                    if(chars[i] < (CharT)'0' || chars[i] > (CharT)'9')
+                        valid = false;
+                }
+            }
+            else
+                valid = false;
+        }
+        pos = end;
+    }
+
+    end = pos;
+    while(end < len && chars[end] != (CharT)'?' && chars[end] != (CharT)'#')
+        ++end;
+    m_Path = str.substr(pos, end - pos);
+    pos = end;
+    if(pos < len && chars[pos] == (CharT)'?')
+    {
+        end = pos + 1;
+        while(end < len && chars[end] != (CharT)'#')
+            ++end;
+        m_HasQuery = true;
+        m_Query = str.substr(pos + 1, end - pos - 1);
+        pos = end;
+    }
+    if(pos < len)
+    {
+        m_HasFragment = true;
+        m_Fragment = str.substr(pos + 1);
+    }
+    return valid;
+}
+
+template<typename CharT>
+inline size_t uri_template<CharT>::port_number() const
+{
+    const size_t len = m_Port.length();
+    if(len == 0 || len > 5)
+        return SIZE_MAX;
+    size_t result = 0;
+    for(size_t i = 0; i < len; ++i)
+    {
+        const CharT ch = m_Port.data()[i];
+        if(ch < (CharT)'0' || ch > (CharT)'9')
+            return SIZE_MAX;
+        result = result * 10 + (size_t)(ch - (CharT)'0');
+    }
+    return result <= 65535 ? result : SIZE_MAX;
+}
+
+/*
+Reads parameters of a query one at a time, e.g. "a=1&b=2" returned by uri_template::query().
+Parameters are separated by '&'. Names and values are views of the query, still encoded - decode them
+with unescape_percent() and plus_as_space = true, which copies only those that need it.
+*/
+template<typename CharT>
+class query_param_reader_template
+{
+public:
+    inline explicit query_param_reader_template(const str_view_template<CharT>& query) : m_Query(query), m_Pos(0) { }
+
+    // Returns true if there are no more parameters. Skips trailing '&' like next() does.
+    inline bool at_end() const;
+    /*
+    Reads the next parameter. Returns false if there are no more parameters.
+    Value is the part after the first '=', empty if there is none. Empty parameters, like in "a=1&&b=2", are skipped.
+    */
+    inline bool next(str_view_template<CharT>& name, str_view_template<CharT>& value);
+
+private:
+    str_view_template<CharT> m_Query;
+    size_t m_Pos;
+};
+
+typedef query_param_reader_template<char> query_param_reader;
+typedef query_param_reader_template<wchar_t> wquery_param_reader;
+
+template<typename CharT>
+inline bool query_param_reader_template<CharT>::at_end() const
+{
+    const size_t len = m_Query.length();
+    size_t pos = m_Pos;
+    while(pos < len && m_Query.data()[pos] == (CharT)'&')
+        ++pos;
+    return pos >= len;
+}
+
+template<typename CharT>
+inline bool query_param_reader_template<CharT>::next(str_view_template<CharT>& name, str_view_template<CharT>& value)
+{
+    const CharT* const chars = m_Query.data();
+    const size_t len = m_Query.length();
+    while(m_Pos < len && chars[m_Pos] == (CharT)'&')
+        ++m_Pos;
+    if(m_Pos >= len)
+        return false;
+    size_t end = m_Pos;
+    size_t equalsPos = SIZE_MAX;
+    for(; end < len && chars[end] != (CharT)'&'; ++end)
+    {
+        if(chars[end] == (CharT)'=' && equalsPos == SIZE_MAX)
+            equalsPos = end;
+    }
+    if(equalsPos == SIZE_MAX)
+    {
+        name = m_Query.substr(m_Pos, end - m_Pos);
+        value = str_view_template<CharT>();
+    }
+    else
+    {
+        name = m_Query.substr(m_Pos, equalsPos - m_Pos);
+        value = m_Query.substr(equalsPos + 1, end - equalsPos - 1);
     }
+    m_Pos = end;
+    return true;
 }
 
+/*
+Functions that operate on file system paths lexically, without accessing the file system.
+
+Results are views of the path, so the ones that end it, like the file name or the extension, remain
+null-terminated if the path was, and their c_str() can be passed to system functions without copying.
+Separator is '/', and also '\\' with drive letters like "C:" if STR_VIEW_WINDOWS_PATHS is enabled.
+*/
+
+// Returns the last component of the path, e.g. "b.txt" for "/a/b.txt". Empty if the path ends with a separator.
 template<typename CharT>
-inline void str_view_template<CharT>::remove_suffix(size_t n)
+inline str_view_template<CharT> path_filename(const str_view_template<CharT>& path)
 {
-    if(n == 0)
-        return;
-    if(m_Length != SIZE_MAX)
+    const size_t len = path.length();
+    return path.substr(str_view_detail::path_filename_begin(path.data(), len));
+}
+
+/*
+Returns extension of the file name including the dot, e.g. ".txt" for "/a/b.txt", or empty view if it has none.
+File names that start with the only dot, like ".bashrc", and "." and ".." have no extension.
+*/
+template<typename CharT>
+inline str_view_template<CharT> path_extension(const str_view_template<CharT>& path)
+{
+    const size_t len = path.length();
+    return path.substr(str_view_detail::path_extension_begin(path.data(), len));
+}
+
+// Returns the file name without extension, e.g. "b" for "/a/b.txt".
+template<typename CharT>
+inline str_view_template<CharT> path_stem(const str_view_template<CharT>& path)
+{
+    const size_t len = path.length();
+    const size_t nameBegin = str_view_detail::path_filename_begin(path.data(), len);
+    return path.substr(nameBegin, str_view_detail::path_extension_begin(path.data(), len) - nameBegin);
+}
+
+/*
+Returns the path without the file name and separators before it, e.g. "/a" for "/a/b.txt",
+keeping the root, e.g. "/" for "/a". Empty if the path is only a file name.
+*/
+template<typename CharT>
+inline str_view_template<CharT> path_parent(const str_view_template<CharT>& path)
+{
+    const CharT* const chars = path.data();
+    const size_t len = path.length();
+    const size_t driveLen = str_view_detail::path_drive_length(chars, len);
+    const size_t rootLen = driveLen < len && str_view_detail::is_path_separator(chars[driveLen]) ? driveLen + 1 : driveLen;
+    size_t end = str_view_detail::path_filename_begin(chars, len);
+    while(end > rootLen && str_view_detail::is_path_separator(chars[end - 1]))
+        --end;
+    return path.substr(0, end);
+}
+
+// Returns true if the path starts with a separator, after the drive letter if there is one.
+template<typename CharT>
+inline bool path_is_absolute(const str_view_template<CharT>& path)
+{
+    const size_t len = path.length();
+    const size_t driveLen = str_view_detail::path_drive_length(path.data(), len);
+    return driveLen < len && str_view_detail::is_path_separator(path.data()[driveLen]);
+}
+
+/*
+Reads components of a path one at a time: the drive letter first, if there is one, then names between
+separators, including "." and "..". Separators are skipped, so the root of an absolute path is not
+returned - see path_is_absolute(). The last component remains null-terminated if the path was.
+*/
+template<typename CharT>
+class path_component_reader_template
+{
+public:
+    inline explicit path_component_reader_template(const str_view_template<CharT>& path) : m_Path(path), m_Pos(0) { }
+
+    // Returns true if there are no more components.
+    inline bool at_end() const;
+    // Reads the next component. Returns false if there are no more components.
+    inline bool next(str_view_template<CharT>& component);
+
+private:
+    str_view_template<CharT> m_Path;
+    size_t m_Pos;
+};
+
+typedef path_component_reader_template<char> path_component_reader;
+typedef path_component_reader_template<wchar_t> wpath_component_reader;
+
+template<typename CharT>
+inline bool path_component_reader_template<CharT>::at_end() const
+{
+    const size_t len = m_Path.length();
+    if(m_Pos == 0 && str_view_detail::path_drive_length(m_Path.data(), len) > 0)
+        return false;
+    size_t pos = m_Pos;
+    while(pos < len && str_view_detail::is_path_separator(m_Path.data()[pos]))
+        ++pos;
+    return pos >= len;
+}
+
+template<typename CharT>
+inline bool path_component_reader_template<CharT>::next(str_view_template<CharT>& component)
+{
+    const CharT* const chars = m_Path.data();
+    const size_t len = m_Path.length();
+    if(m_Pos == 0)
     {
-        assert(n <= m_Length);
-        if(n < m_Length)
+        const size_t driveLen = str_view_detail::path_drive_length(chars, len);
+        if(driveLen > 0)
         {
-            // No longer null terminated.
-            if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
-                delete[] m_NullTerminatedPtr;
-            m_NullTerminatedPtr = nullptr;
-            m_Length -= n;
+            component = m_Path.substr(0, driveLen);
+            m_Pos = driveLen;
+            return true;
         }
-        else
+    }
+    while(m_Pos < len && str_view_detail::is_path_separator(chars[m_Pos]))
+        ++m_Pos;
+    if(m_Pos >= len)
+        return false;
+    const size_t begin = m_Pos;
+    while(m_Pos < len && !str_view_detail::is_path_separator(chars[m_Pos]))
+        ++m_Pos;
+    component = m_Path.substr(begin, m_Pos - begin);
+    return true;
+}
+
+/*
+Normalizes the path lexically, like os.path.normpath in Python: removes repeated separators, "."
+components, ".." components together with names before them, and separators at the end.
+".." at the beginning of a relative path is kept, and of an absolute path is removed. Empty result becomes ".".
+If STR_VIEW_WINDOWS_PATHS is enabled, separators are changed to '\\'.
+
+The result is built in buffer, which can be reused between calls to avoid allocations. If it is equal
+to the path, returns the path itself, which stays null-terminated if it was. Otherwise, returns view of
+the buffer, which is null-terminated.
+*/
+template<typename CharT>
+inline str_view_template<CharT> normalize_path(const str_view_template<CharT>& path, std::basic_string<CharT>& buffer)
+{
+#if STR_VIEW_WINDOWS_PATHS
+    const CharT separator = (CharT)'\\';
+#else
+    const CharT separator = (CharT)'/';
+#endif
+    const CharT* const chars = path.data();
+    const size_t len = path.length();
+    const size_t driveLen = str_view_detail::path_drive_length(chars, len);
+    buffer.assign(chars, driveLen);
+    if(path_is_absolute(path))
+        buffer += separator;
+    const size_t rootLen = buffer.length();
+    const bool absolute = rootLen > driveLen;
+
+    // Number of names at the end of the buffer that ".." can remove.
+    size_t removableCount = 0;
+    path_component_reader_template<CharT> reader(path.substr(driveLen));
+    str_view_template<CharT> component;
+    while(reader.next(component))
+    {
+        const size_t componentLen = component.length();
+        const CharT* const componentChars = component.data();
+        if(componentLen == 1 && componentChars[0] == (CharT)'.')
+            continue;
+        if(componentLen == 2 && componentChars[0] == (CharT)'.' && componentChars[1] == (CharT)'.')
         {
-            // String becomes empty.
-            if(m_NullTerminatedPtr && m_NullTerminatedPtr != m_Begin)
-                delete[] m_NullTerminatedPtr;
-            m_NullTerminatedPtr = nullptr;
-            m_Length = 0;
-            m_Begin = nullptr;
+            if(removableCount > 0)
+            {
+                size_t newLen = buffer.length();
+                while(newLen > rootLen && buffer[newLen - 1] != separator)
+                    --newLen;
+                buffer.resize(newLen > rootLen ? newLen - 1 : rootLen);
+                --removableCount;
+                continue;
+            }
+            if(absolute)
+                continue;
         }
+        else
+            ++removableCount;
+        if(buffer.length() > rootLen)
+            buffer += separator;
+        buffer.append(componentChars, componentLen);
     }
-    else
+    if(buffer.empty())
+        buffer += (CharT)'.';
+
+    if(buffer.length() == len && memcmp(buffer.data(), chars, len * sizeof(CharT)) == 0)
+        return path;
+    return str_view_template<CharT>(buffer.c_str(), buffer.length(), typename str_view_template<CharT>::StillNullTerminated());
+}
+
+/*
+String of up to Capacity characters stored inside the object, without allocating memory, always followed
+by a null terminator, e.g. to build a short key or identifier that must outlive the current scope.
+
+It converts implicitly to str_view_template that has known length and is null-terminated, so its length()
+and c_str() cost nothing. The view points into this object, so it is valid until the object is destroyed
+or modified.
+
+Operations that add characters don't change the string and return false if the result wouldn't fit.
+*/
+template<typename CharT, size_t Capacity>
+class fixed_str_template
+{
+    static_assert(Capacity > 0, "Capacity must be greater than 0.");
+public:
+    inline fixed_str_template() : m_Length(0) { m_Chars[0] = (CharT)0; }
+    // Initializes with str, which must fit - otherwise the string stays empty.
+    inline fixed_str_template(const str_view_template<CharT>& str) : m_Length(0) { m_Chars[0] = (CharT)0; append(str); }
+
+    static inline size_t capacity() { return Capacity; }
+    inline size_t length() const { return m_Length; }
+    inline size_t size() const { return m_Length; }
+    inline bool empty() const { return m_Length == 0; }
+    inline const CharT* data() const { return m_Chars; }
+    inline const CharT* c_str() const { return m_Chars; }
+    inline CharT operator[](size_t index) const { assert(index < m_Length); return m_Chars[index]; }
+
+    inline str_view_template<CharT> view() const
     {
-        assert(m_NullTerminatedPtr == m_Begin);
-        // No longer null terminated.
-        m_Length = length() - n;
-        m_NullTerminatedPtr = nullptr;
+        return str_view_template<CharT>(m_Chars, m_Length, typename str_view_template<CharT>::StillNullTerminated());
+    }
+    inline operator str_view_template<CharT>() const { return view(); }
+
+    inline bool operator==(const str_view_template<CharT>& rhs) const { return view() == rhs; }
+    inline bool operator!=(const str_view_template<CharT>& rhs) const { return view() != rhs; }
+    inline bool operator<(const str_view_template<CharT>& rhs) const { return view() < rhs; }
+
+    inline void clear() { truncate(0); }
+    // Shortens the string to new_length characters. Does nothing if it is not longer.
+    inline void truncate(size_t new_length);
+
+    inline bool append(const str_view_template<CharT>& str);
+    inline bool append(CharT ch) { return append(str_view_template<CharT>(&ch, 1)); }
+    // Appends count copies of ch.
+    inline bool append(size_t count, CharT ch);
+    // Appends integer or floating-point number, formatted like format_integer() or format_float().
+    template<typename T>
+    inline bool append_number(T value);
+    /*
+    Appends text formatted like printf, using vsnprintf for char and vswprintf for wchar_t.
+    Formatting of numbers depends on the current locale.
+    */
+    inline bool append_format(const CharT* format, ...);
+    inline bool assign(const str_view_template<CharT>& str) { clear(); return append(str); }
+
+    inline fixed_str_template<CharT, Capacity>& operator+=(const str_view_template<CharT>& str) { append(str); return *this; }
+    inline fixed_str_template<CharT, Capacity>& operator+=(CharT ch) { append(ch); return *this; }
+
+private:
+    size_t m_Length;
+    CharT m_Chars[Capacity + 1];
+
+    template<typename T>
+    inline bool append_number(T value, std::true_type) { CharT buf[format_buffer_size]; return append(format_float(value, buf)); }
+    template<typename T>
+    inline bool append_number(T value, std::false_type) { CharT buf[format_buffer_size]; return append(format_integer(value, buf)); }
+};
+
+template<size_t Capacity>
+using fixed_str = fixed_str_template<char, Capacity>;
+template<size_t Capacity>
+using wfixed_str = fixed_str_template<wchar_t, Capacity>;
+
+template<typename CharT, size_t Capacity>
+inline void fixed_str_template<CharT, Capacity>::truncate(size_t new_length)
+{
+    // Comparison with Capacity is redundant, but tells the compiler that the index is in bounds.
+    if(new_length < m_Length && new_length <= Capacity)
+    {
+        m_Length = new_length;
+        m_Chars[m_Length] = (CharT)0;
+    }
+}
+
+template<typename CharT, size_t Capacity>
+inline bool fixed_str_template<CharT, Capacity>::append(const str_view_template<CharT>& str)
+{
+    const size_t strLen = str.length();
+    if(strLen > Capacity - m_Length)
+        return false;
+    if(strLen > 0)
+        memcpy(m_Chars + m_Length, str.data(), strLen * sizeof(CharT));
+    m_Length += strLen;
+    m_Chars[m_Length] = (CharT)0;
+    return true;
+}
+
+template<typename CharT, size_t Capacity>
+inline bool fixed_str_template<CharT, Capacity>::append(size_t count, CharT ch)
+{
+    if(count > Capacity - m_Length)
+        return false;
+    std::fill(m_Chars + m_Length, m_Chars + m_Length + count, ch);
+    m_Length += count;
+    m_Chars[m_Length] = (CharT)0;
+    return true;
+}
+
+template<typename CharT, size_t Capacity>
+template<typename T>
+inline bool fixed_str_template<CharT, Capacity>::append_number(T value)
+{
+    static_assert(std::is_arithmetic<T>::value, "append_number requires integer or floating-point type.");
+    return append_number(value, typename std::is_floating_point<T>::type());
+}
+
+template<typename CharT, size_t Capacity>
+inline bool fixed_str_template<CharT, Capacity>::append_format(const CharT* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int result = str_view_detail::vformat(m_Chars + m_Length, Capacity + 1 - m_Length, format, args);
+    va_end(args);
+    if(result < 0 || (size_t)result > Capacity - m_Length)
+    {
+        m_Chars[m_Length] = (CharT)0;
+        return false;
     }
+    m_Length += (size_t)result;
+    return true;
 }
 
+/*
+Array of pointers to null-terminated strings made from many views at once, followed by a null pointer,
+like argv, e.g. to pass them to execve or other C functions that take const char**.
+
+Calling c_str() on each view allocates memory separately for each one that is not null-terminated.
+Instead, views that are null-terminated, or empty, are passed by their original pointers, and the
+remaining ones are copied together into one memory block owned by this object, which is reused by
+following calls to build().
+*/
 template<typename CharT>
-inline void swap(str_view_template<CharT>& lhs, str_view_template<CharT>& rhs)
+class c_str_array_template
 {
-    lhs.swap(rhs);
+public:
+    inline c_str_array_template() : m_Pointers(1, nullptr), m_CopiedLength(0) { }
+
+    /*
+    Makes array of count + 1 pointers: strings[i] as null-terminated strings, followed by null pointer.
+    Returned array is valid until this object is destroyed or build() is called again. Strings that were
+    null-terminated are not copied, so they must also remain alive.
+    */
+    inline const CharT* const* build(const str_view_template<CharT>* strings, size_t count);
+    // Makes the array from a container of views stored contiguously, like std::vector<str_view>.
+    template<typename ContainerT>
+    inline const CharT* const* build(const ContainerT& strings) { return build(strings.data(), strings.size()); }
+
+    // Returns the array made by the last call to build().
+    inline const CharT* const* data() const { return m_Pointers.data(); }
+    // Returns the number of strings, not including the null pointer at the end.
+    inline size_t size() const { return m_Pointers.size() - 1; }
+    inline const CharT* operator[](size_t index) const { return m_Pointers[index]; }
+    // Returns the number of characters, including null terminators, copied by the last call to build().
+    inline size_t copied_length() const { return m_CopiedLength; }
+
+private:
+    std::vector<const CharT*> m_Pointers;
+    std::vector<CharT> m_Copies;
+    size_t m_CopiedLength;
+};
+
+typedef c_str_array_template<char> c_str_array;
+typedef c_str_array_template<wchar_t> wc_str_array;
+
+template<typename CharT>
+inline const CharT* const* c_str_array_template<CharT>::build(const str_view_template<CharT>* strings, size_t count)
+{
+    // Lengths of null-terminated strings are not needed, so they are not calculated if still unknown.
+    size_t copiedLength = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(!strings[i].is_null_terminated() && !strings[i].empty())
+            copiedLength += strings[i].length() + 1;
+    }
+    if(m_Copies.size() < copiedLength)
+        m_Copies.resize(copiedLength);
+    m_CopiedLength = copiedLength;
+
+    m_Pointers.resize(count + 1);
+    CharT* dst = m_Copies.data();
+    for(size_t i = 0; i < count; ++i)
+    {
+        const str_view_template<CharT>& str = strings[i];
+        if(str.is_null_terminated() || str.empty())
+            m_Pointers[i] = str.c_str();
+        else
+        {
+            const size_t len = str.length();
+            memcpy(dst, str.data(), len * sizeof(CharT));
+            dst[len] = (CharT)0;
+            m_Pointers[i] = dst;
+            dst += len + 1;
+        }
+    }
+    m_Pointers[count] = nullptr;
+    return m_Pointers.data();
 }